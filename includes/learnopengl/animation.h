@@ -8,6 +8,7 @@
 #include <functional>
 #include <learnopengl/animdata.h>
 #include <learnopengl/model_animation.h>
+#include <raytracing/skeletal_animation.h>
 
 struct AssimpNodeData
 {
@@ -60,6 +61,16 @@ public:
 	{ 
 		return m_BoneInfoMap;
 	}
+	inline const std::vector<Bone>& GetBones() const { return m_Bones; }
+
+	// flattens the hierarchy and resolves bones and tracks by name once, see AnimationClip
+	AnimationClip Compile() const
+	{
+		AnimationClip clip;
+		clip.SetTiming(m_Duration, (float)m_TicksPerSecond);
+		CompileNode(clip, m_RootNode, -1);
+		return clip;
+	}
 
 private:
 	void ReadMissingBones(const aiAnimation* animation, Model& model)
@@ -87,6 +98,47 @@ private:
 		m_BoneInfoMap = boneInfoMap;
 	}
 
+	void CompileNode(AnimationClip& clip, const AssimpNodeData& node, int parent) const
+	{
+		int boneId = -1;
+		glm::mat4 offset(1.0f);
+		auto boneInfo = m_BoneInfoMap.find(node.name);
+		if (boneInfo != m_BoneInfoMap.end())
+		{
+			boneId = boneInfo->second.id;
+			offset = boneInfo->second.offset;
+		}
+		int index = clip.AddNode(parent, node.transformation, boneId, offset, node.name);
+
+		auto bone = std::find_if(m_Bones.begin(), m_Bones.end(),
+			[&](const Bone& bone) { return bone.GetBoneName() == node.name; });
+		if (bone != m_Bones.end())
+		{
+			std::vector<float> positionTimes, rotationTimes, scaleTimes;
+			std::vector<glm::vec3> positions, scales;
+			std::vector<glm::quat> rotations;
+			for (const KeyPosition& key : bone->GetPositionKeys())
+			{
+				positionTimes.push_back(key.timeStamp);
+				positions.push_back(key.position);
+			}
+			for (const KeyRotation& key : bone->GetRotationKeys())
+			{
+				rotationTimes.push_back(key.timeStamp);
+				rotations.push_back(key.orientation);
+			}
+			for (const KeyScale& key : bone->GetScaleKeys())
+			{
+				scaleTimes.push_back(key.timeStamp);
+				scales.push_back(key.scale);
+			}
+			clip.SetTrack(index, positionTimes, positions, rotationTimes, rotations, scaleTimes, scales);
+		}
+
+		for (const AssimpNodeData& child : node.children)
+			CompileNode(clip, child, index);
+	}
+
 	void ReadHeirarchyData(AssimpNodeData& dest, const aiNode* src)
 	{
 		assert(src);
@@ -13,23 +13,23 @@ class Animator
 public:
 	Animator(Animation* animation)
 	{
-		m_CurrentTime = 0.0;
-		m_CurrentAnimation = animation;
-
 		m_FinalBoneMatrices.reserve(100);
 
 		for (int i = 0; i < 100; i++)
 			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+
+		PlayAnimation(animation);
 	}
 
+	// evaluates the compiled clip, CalculateBoneTransform walks the node tree instead
 	void UpdateAnimation(float dt)
 	{
 		m_DeltaTime = dt;
 		if (m_CurrentAnimation)
 		{
-			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
-			m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+			m_Clip.Advance(m_State, dt);
+			m_CurrentTime = m_State.time;
+			m_Clip.Evaluate(m_State, m_FinalBoneMatrices.data(), (int)m_FinalBoneMatrices.size());
 		}
 	}
 
@@ -37,6 +37,11 @@ public:
 	{
 		m_CurrentAnimation = pAnimation;
 		m_CurrentTime = 0.0f;
+		if (m_CurrentAnimation)
+		{
+			m_Clip = m_CurrentAnimation->Compile();
+			m_State = m_Clip.CreateState();
+		}
 	}
 
 	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
@@ -54,11 +59,12 @@ public:
 
 		glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-		auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+		const auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
+		auto boneInfo = boneInfoMap.find(nodeName);
+		if (boneInfo != boneInfoMap.end())
 		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
+			int index = boneInfo->second.id;
+			glm::mat4 offset = boneInfo->second.offset;
 			m_FinalBoneMatrices[index] = globalTransformation * offset;
 		}
 
@@ -66,7 +72,7 @@ public:
 			CalculateBoneTransform(&node->children[i], globalTransformation);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() const
 	{
 		return m_FinalBoneMatrices;
 	}
@@ -74,6 +80,8 @@ public:
 private:
 	std::vector<glm::mat4> m_FinalBoneMatrices;
 	Animation* m_CurrentAnimation;
+	AnimationClip m_Clip;
+	AnimationState m_State;
 	float m_CurrentTime;
 	float m_DeltaTime;
 
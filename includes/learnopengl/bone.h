@@ -5,6 +5,7 @@
 #include <vector>
 #include <assimp/scene.h>
 #include <list>
+#include <algorithm>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
@@ -82,42 +83,40 @@ public:
 	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
 	std::string GetBoneName() const { return m_Name; }
 	int GetBoneID() { return m_ID; }
+	const std::vector<KeyPosition>& GetPositionKeys() const { return m_Positions; }
+	const std::vector<KeyRotation>& GetRotationKeys() const { return m_Rotations; }
+	const std::vector<KeyScale>& GetScaleKeys() const { return m_Scales; }
 	
 
 
 	int GetPositionIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumPositions - 1; ++index)
-		{
-			if (animationTime < m_Positions[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return FindKeyIndex(m_Positions, animationTime);
 	}
 
 	int GetRotationIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumRotations - 1; ++index)
-		{
-			if (animationTime < m_Rotations[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return FindKeyIndex(m_Rotations, animationTime);
 	}
 
 	int GetScaleIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumScalings - 1; ++index)
-		{
-			if (animationTime < m_Scales[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return FindKeyIndex(m_Scales, animationTime);
 	}
 
 
 private:
 
+	// index of the key starting the interval that holds animationTime, by binary search.
+	// times before the first key use the first interval, times after the last one the last
+	template<typename Key>
+	static int FindKeyIndex(const std::vector<Key>& keys, float animationTime)
+	{
+		auto next = std::upper_bound(keys.begin() + 1, keys.end() - 1, animationTime,
+			[](float time, const Key& key) { return time < key.timeStamp; });
+		return (int)(next - keys.begin()) - 1;
+	}
+
 	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
 	{
 		float scaleFactor = 0.0f;
@@ -6,6 +6,8 @@
 #include <array> //std::array
 #include <memory> //std::unique_ptr
 
+#include <learnopengl/frustum.h>
+
 class Transform
 {
 protected:
@@ -120,36 +122,6 @@ public:
 	}
 };
 
-struct Plan
-{
-	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
-	float     distance = 0.f;        // Distance with origin
-
-	Plan() = default;
-
-	Plan(const glm::vec3& p1, const glm::vec3& norm)
-		: normal(glm::normalize(norm)),
-		distance(glm::dot(normal, p1))
-	{}
-
-	float getSignedDistanceToPlan(const glm::vec3& point) const
-	{
-		return glm::dot(normal, point) - distance;
-	}
-};
-
-struct Frustum
-{
-	Plan topFace;
-	Plan bottomFace;
-
-	Plan rightFace;
-	Plan leftFace;
-
-	Plan farFace;
-	Plan nearFace;
-};
-
 struct BoundingVolume
 {
 	virtual bool isOnFrustum(const Frustum& camFrustum, const Transform& transform) const = 0;
@@ -324,23 +296,6 @@ struct AABB : public BoundingVolume
 	};
 };
 
-Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, float zNear, float zFar)
-{
-	Frustum     frustum;
-	const float halfVSide = zFar * tanf(fovY * .5f);
-	const float halfHSide = halfVSide * aspect;
-	const glm::vec3 frontMultFar = zFar * cam.Front;
-
-	frustum.nearFace = { cam.Position + zNear * cam.Front, cam.Front };
-	frustum.farFace = { cam.Position + frontMultFar, -cam.Front };
-	frustum.rightFace = { cam.Position, glm::cross(cam.Up, frontMultFar + cam.Right * halfHSide) };
-	frustum.leftFace = { cam.Position, glm::cross(frontMultFar - cam.Right * halfHSide, cam.Up) };
-	frustum.topFace = { cam.Position, glm::cross(cam.Right, frontMultFar - cam.Up * halfVSide) };
-	frustum.bottomFace = { cam.Position, glm::cross(frontMultFar + cam.Up * halfVSide, cam.Right) };
-
-	return frustum;
-}
-
 AABB generateAABB(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
@@ -382,6 +337,8 @@ Sphere generateSphereBV(const Model& model)
 	return Sphere((maxAABB + minAABB) * 0.5f, glm::length(minAABB - maxAABB));
 }
 
+//A tree of separately allocated nodes, fine for a few models. SceneGraph in scene_graph.h keeps
+//the same transforms in flat arrays for scenes with many entities
 class Entity
 {
 public:
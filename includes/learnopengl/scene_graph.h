@@ -0,0 +1,327 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include <learnopengl/frustum.h>
+#include <raytracing/thread_pool.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SCENE_GRAPH_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE
+#endif
+
+// nodes per thread below which update and cull don't split the work further
+const int SCENE_GRAPH_MIN_NODES_PER_THREAD = 4096;
+
+//World space bounds of 8 nodes, one array per component so a plane is tested against all 8 at once
+struct alignas(32) BoundsBlock
+{
+	float centerX[8], centerY[8], centerZ[8];
+	float extentX[8], extentY[8], extentZ[8];
+};
+
+//Transform hierarchy of Entity flattened into arrays. A node is an index and its parent has to
+//be added before it, so index order is a topological order. Every node also knows its depth and
+//update walks the nodes level by level: a level only reads the level above, so each level is
+//split across threads. Nodes can't be removed.
+class SceneGraph
+{
+public:
+	//parent -1 for a root. bounds are in the node's local space, like Entity's AABB
+	int addNode(int parent, const glm::vec3& boundsMin = glm::vec3(-1.0f), const glm::vec3& boundsMax = glm::vec3(1.0f))
+	{
+		int node = (int)m_parents.size();
+		m_parents.push_back(parent);
+		m_depths.push_back(parent < 0 ? 0 : m_depths[parent] + 1);
+		m_positions.push_back(glm::vec3(0.0f));
+		m_eulerRots.push_back(glm::vec3(0.0f));
+		m_scales.push_back(glm::vec3(1.0f));
+		m_localMatrices.push_back(glm::mat4(1.0f));
+		m_modelMatrices.push_back(glm::mat4(1.0f));
+		m_boundsCenters.push_back((boundsMax + boundsMin) * 0.5f);
+		m_boundsExtents.push_back((boundsMax - boundsMin) * 0.5f);
+		m_localDirty.push_back(1);
+		m_worldDirty.push_back(1);
+		if(node % 8 == 0)
+		{
+			m_worldBounds.push_back(BoundsBlock());
+			//lanes past the last node never pass the test
+			std::fill(m_worldBounds.back().extentX, m_worldBounds.back().extentX + 8, -INFINITY);
+		}
+		m_levelsValid = false;
+		return node;
+	}
+
+	void setLocalPosition(int node, const glm::vec3& newPosition)
+	{
+		m_positions[node] = newPosition;
+		m_localDirty[node] = 1;
+	}
+
+	//In degrees, applied Y * X * Z as in Transform
+	void setLocalRotation(int node, const glm::vec3& newRotation)
+	{
+		m_eulerRots[node] = newRotation;
+		m_localDirty[node] = 1;
+	}
+
+	void setLocalScale(int node, const glm::vec3& newScale)
+	{
+		m_scales[node] = newScale;
+		m_localDirty[node] = 1;
+	}
+
+	//Recomputes the model matrix and world bounds of every node that changed or sits below one
+	//that did. threadCount 0 uses every hardware thread
+	void update(unsigned int threadCount = 0)
+	{
+		if(!m_levelsValid)
+		{
+			buildLevels();
+		}
+		for(size_t level = 0; level + 1 < m_levelStarts.size(); ++level)
+		{
+			int begin = m_levelStarts[level];
+			int count = m_levelStarts[level + 1] - begin;
+			ParallelFor(count, ChunkCount(count, SCENE_GRAPH_MIN_NODES_PER_THREAD, threadCount), [this, begin](int first, int last)
+			{
+				updateNodes(m_levelOrder.data() + begin + first, last - first);
+			});
+		}
+	}
+
+	//Appends the nodes whose world bounds touch the frustum to visible, in index order, and
+	//returns how many there are. 8 boxes are tested against each plane at once
+	int cull(const Frustum& frustum, std::vector<int>& visible, unsigned int threadCount = 0) const
+	{
+		visible.clear();
+		const Plan planes[6] = { frustum.leftFace, frustum.rightFace, frustum.topFace,
+			frustum.bottomFace, frustum.nearFace, frustum.farFace };
+		int blockCount = (int)m_worldBounds.size();
+		int chunkCount = ChunkCount(blockCount * 8, SCENE_GRAPH_MIN_NODES_PER_THREAD, threadCount);
+		std::vector<std::vector<int>> found(chunkCount);
+		//one item per chunk, so each fills its own list and they join in index order
+		ParallelFor(chunkCount, chunkCount, [&](int firstChunk, int lastChunk)
+		{
+			for(int chunk = firstChunk; chunk < lastChunk; ++chunk)
+			{
+				int first = (int)((int64_t)blockCount * chunk / chunkCount);
+				int last = (int)((int64_t)blockCount * (chunk + 1) / chunkCount);
+				for(int block = first; block < last; ++block)
+				{
+					unsigned int mask = cullBlock(m_worldBounds[block], planes);
+					while(mask)
+					{
+						int lane = lowestBit(mask);
+						found[chunk].push_back(block * 8 + lane);
+						mask &= mask - 1;
+					}
+				}
+			}
+		});
+		for(const std::vector<int>& chunk : found)
+		{
+			visible.insert(visible.end(), chunk.begin(), chunk.end());
+		}
+		return (int)visible.size();
+	}
+
+	int size() const { return (int)m_parents.size(); }
+	int getParent(int node) const { return m_parents[node]; }
+	int getDepth(int node) const { return m_depths[node]; }
+	const glm::vec3& getLocalPosition(int node) const { return m_positions[node]; }
+	const glm::vec3& getLocalRotation(int node) const { return m_eulerRots[node]; }
+	const glm::vec3& getLocalScale(int node) const { return m_scales[node]; }
+	const glm::mat4& getModelMatrix(int node) const { return m_modelMatrices[node]; }
+	//size() matrices in index order, ready to be copied into an instance buffer
+	const glm::mat4* getModelMatrices() const { return m_modelMatrices.data(); }
+
+	glm::vec3 getGlobalCenter(int node) const
+	{
+		const BoundsBlock& block = m_worldBounds[node / 8];
+		return glm::vec3(block.centerX[node % 8], block.centerY[node % 8], block.centerZ[node % 8]);
+	}
+
+	glm::vec3 getGlobalExtents(int node) const
+	{
+		const BoundsBlock& block = m_worldBounds[node / 8];
+		return glm::vec3(block.extentX[node % 8], block.extentY[node % 8], block.extentZ[node % 8]);
+	}
+
+private:
+	//Node indices sorted by depth, stable so a level keeps index order
+	void buildLevels()
+	{
+		int maxDepth = 0;
+		for(int depth : m_depths)
+		{
+			maxDepth = std::max(maxDepth, depth);
+		}
+		m_levelStarts.assign(maxDepth + 2, 0);
+		for(int depth : m_depths)
+		{
+			m_levelStarts[depth + 1]++;
+		}
+		for(int level = 1; level <= maxDepth + 1; ++level)
+		{
+			m_levelStarts[level] += m_levelStarts[level - 1];
+		}
+		m_levelOrder.resize(m_depths.size());
+		std::vector<int> next(m_levelStarts.begin(), m_levelStarts.end() - 1);
+		for(int node = 0; node < (int)m_depths.size(); ++node)
+		{
+			m_levelOrder[next[m_depths[node]]++] = node;
+		}
+		m_levelsValid = true;
+	}
+
+	//Nodes of one level, their parents are up to date
+	void updateNodes(const int* nodes, int count)
+	{
+		for(int k = 0; k < count; ++k)
+		{
+			int node = nodes[k];
+			int parent = m_parents[node];
+			bool moved = m_localDirty[node] || (parent >= 0 && m_worldDirty[parent]);
+			m_worldDirty[node] = moved;
+			if(!moved)
+			{
+				continue;
+			}
+			if(m_localDirty[node])
+			{
+				m_localMatrices[node] = getLocalModelMatrix(node);
+				m_localDirty[node] = 0;
+			}
+			m_modelMatrices[node] = parent < 0 ? m_localMatrices[node] : m_modelMatrices[parent] * m_localMatrices[node];
+			updateBounds(node);
+		}
+	}
+
+	glm::mat4 getLocalModelMatrix(int node) const
+	{
+		const glm::vec3& eulerRot = m_eulerRots[node];
+		const glm::mat4 transformX = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		const glm::mat4 transformY = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::mat4 transformZ = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 matrix = transformY * transformX * transformZ;
+		matrix[0] *= m_scales[node].x;
+		matrix[1] *= m_scales[node].y;
+		matrix[2] *= m_scales[node].z;
+		matrix[3] = glm::vec4(m_positions[node], 1.0f);
+		return matrix;
+	}
+
+	//The box around the transformed local box, as Entity::getGlobalAABB
+	void updateBounds(int node)
+	{
+		const glm::mat4& model = m_modelMatrices[node];
+		const glm::vec3& center = m_boundsCenters[node];
+		const glm::vec3& extents = m_boundsExtents[node];
+		glm::vec3 globalCenter(model * glm::vec4(center, 1.0f));
+		glm::vec3 globalExtents = glm::abs(glm::vec3(model[0])) * extents.x + glm::abs(glm::vec3(model[1])) * extents.y +
+			glm::abs(glm::vec3(model[2])) * extents.z;
+		BoundsBlock& block = m_worldBounds[node / 8];
+		int lane = node % 8;
+		block.centerX[lane] = globalCenter.x;
+		block.centerY[lane] = globalCenter.y;
+		block.centerZ[lane] = globalCenter.z;
+		block.extentX[lane] = globalExtents.x;
+		block.extentY[lane] = globalExtents.y;
+		block.extentZ[lane] = globalExtents.z;
+	}
+
+	//Bit i set when box i is on or in front of all six planes, the test of AABB::isOnOrForwardPlan
+	static unsigned int cullBlock(const BoundsBlock& block, const Plan* planes)
+	{
+#if defined(SCENE_GRAPH_AVX)
+		__m256 cx = _mm256_load_ps(block.centerX), cy = _mm256_load_ps(block.centerY), cz = _mm256_load_ps(block.centerZ);
+		__m256 ex = _mm256_load_ps(block.extentX), ey = _mm256_load_ps(block.extentY), ez = _mm256_load_ps(block.extentZ);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for(int p = 0; p < 6; ++p)
+		{
+			const glm::vec3& n = planes[p].normal;
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(n.x), cx), _mm256_mul_ps(_mm256_set1_ps(n.y), cy)),
+				_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(n.z), cz), _mm256_set1_ps(planes[p].distance)));
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(n.x)), ex),
+				_mm256_mul_ps(_mm256_set1_ps(std::abs(n.y)), ey)), _mm256_mul_ps(_mm256_set1_ps(std::abs(n.z)), ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_sub_ps(_mm256_setzero_ps(), r), d, _CMP_LE_OQ));
+		}
+		return (unsigned int)_mm256_movemask_ps(inside);
+#elif defined(SCENE_GRAPH_SSE)
+		unsigned int mask = 0;
+		for(int half = 0; half < 8; half += 4)
+		{
+			__m128 cx = _mm_load_ps(block.centerX + half), cy = _mm_load_ps(block.centerY + half), cz = _mm_load_ps(block.centerZ + half);
+			__m128 ex = _mm_load_ps(block.extentX + half), ey = _mm_load_ps(block.extentY + half), ez = _mm_load_ps(block.extentZ + half);
+			__m128 inside = _mm_cmpeq_ps(cx, cx);
+			for(int p = 0; p < 6; ++p)
+			{
+				const glm::vec3& n = planes[p].normal;
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n.x), cx), _mm_mul_ps(_mm_set1_ps(n.y), cy)),
+					_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(n.z), cz), _mm_set1_ps(planes[p].distance)));
+				__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(n.x)), ex),
+					_mm_mul_ps(_mm_set1_ps(std::abs(n.y)), ey)), _mm_mul_ps(_mm_set1_ps(std::abs(n.z)), ez));
+				inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_sub_ps(_mm_setzero_ps(), r), d));
+			}
+			mask |= (unsigned int)_mm_movemask_ps(inside) << half;
+		}
+		return mask;
+#else
+		unsigned int mask = 0;
+		for(int lane = 0; lane < 8; ++lane)
+		{
+			bool inside = true;
+			for(int p = 0; p < 6; ++p)
+			{
+				const glm::vec3& n = planes[p].normal;
+				float d = n.x * block.centerX[lane] + n.y * block.centerY[lane] + (n.z * block.centerZ[lane] - planes[p].distance);
+				float r = std::abs(n.x) * block.extentX[lane] + std::abs(n.y) * block.extentY[lane] + std::abs(n.z) * block.extentZ[lane];
+				inside = inside && -r <= d;
+			}
+			mask |= (unsigned int)inside << lane;
+		}
+		return mask;
+#endif
+	}
+
+	static int lowestBit(unsigned int mask)
+	{
+		int bit = 0;
+		while(!(mask & 1u))
+		{
+			mask >>= 1;
+			++bit;
+		}
+		return bit;
+	}
+
+	//Per node, in index order
+	std::vector<int> m_parents;
+	std::vector<int> m_depths;
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec3> m_eulerRots;
+	std::vector<glm::vec3> m_scales;
+	std::vector<glm::mat4> m_localMatrices;
+	std::vector<glm::mat4> m_modelMatrices;
+	std::vector<glm::vec3> m_boundsCenters;
+	std::vector<glm::vec3> m_boundsExtents;
+	std::vector<uint8_t> m_localDirty;
+	std::vector<uint8_t> m_worldDirty;
+	//Per 8 nodes
+	std::vector<BoundsBlock> m_worldBounds;
+
+	std::vector<int> m_levelOrder;
+	std::vector<int> m_levelStarts;
+	bool m_levelsValid = false;
+};
+#endif
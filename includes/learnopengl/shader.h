@@ -5,10 +5,19 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
 #include <iostream>
 
+// typed handle to a uniform location, looked up once and then set without a string
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
@@ -89,6 +98,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -106,62 +116,151 @@ public:
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // uniform locations are cached when the program is linked, names of inactive uniforms give -1
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        return Uniform<T>{ location(name) };
+    }
+    // typed uniform functions
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+    {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // attach a named uniform block to a uniform buffer binding point
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &blockName, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
 
 private:
+    // ------------------------------------------------------------------------
+    void cacheUniforms()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location == -1)
+                continue;
+            uniformLocations[name] = location;
+            // arrays are listed once as name[0], also answer to the bare name and every element
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = location;
+                for (GLint element = 1; element < size; ++element)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -187,5 +286,7 @@ private:
             }
         }
     }
+
+    std::unordered_map<std::string, GLint> uniformLocations;
 };
 #endif
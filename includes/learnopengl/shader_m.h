@@ -5,10 +5,22 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <iterator>
 #include <iostream>
 
+// typed handle to a uniform location, looked up once and then set without a string
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
@@ -17,9 +29,169 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
+        readSources(vertexPath, fragmentPath, vertexCode, fragmentCode);
+        compile(vertexCode, fragmentCode);
+    }
+    // specialized variant: the defines are inserted after the #version line of both stages.
+    // with a cache directory the linked program is kept there as a program binary named after
+    // a hash of the final sources and the driver, so later runs skip compiling it.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines, const std::string& cacheDir = "")
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+        readSources(vertexPath, fragmentPath, vertexCode, fragmentCode);
+        vertexCode = insertDefines(vertexCode, defines);
+        fragmentCode = insertDefines(fragmentCode, defines);
+
+        GLint formats = 0;
+        if (!cacheDir.empty() && glGetProgramBinary != NULL)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0)
+        {
+            compile(vertexCode, fragmentCode);
+            return;
+        }
+
+        // binaries only load on the driver that wrote them, so it is part of the key
+        std::string key = vertexCode + '\0' + fragmentCode + '\0' +
+            (const char*)glGetString(GL_VENDOR) + (const char*)glGetString(GL_RENDERER) + (const char*)glGetString(GL_VERSION);
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)hashSource(key));
+        std::string cachePath = cacheDir + "/" + name + ".bin";
+        if (loadBinary(cachePath))
+            return;
+        compile(vertexCode, fragmentCode);
+        saveBinary(cacheDir, cachePath);
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    { 
+        glUseProgram(ID); 
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {         
+        glUniform1i(location(name), (int)value); 
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const
+    { 
+        glUniform1i(location(name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const
+    { 
+        glUniform1f(location(name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    { 
+        glUniform2fv(location(name), 1, &value[0]); 
+    }
+    void setVec2(const std::string &name, float x, float y) const
+    { 
+        glUniform2f(location(name), x, y); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const
+    { 
+        glUniform3fv(location(name), 1, &value[0]); 
+    }
+    void setVec3(const std::string &name, float x, float y, float z) const
+    { 
+        glUniform3f(location(name), x, y, z); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const std::string &name, const glm::vec4 &value) const
+    { 
+        glUniform4fv(location(name), 1, &value[0]); 
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    { 
+        glUniform4f(location(name), x, y, z, w); 
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // uniform locations are cached when the program is linked, names of inactive uniforms give -1
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        return Uniform<T>{ location(name) };
+    }
+    // typed uniform functions
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+    {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // attach a named uniform block to a uniform buffer binding point
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &blockName, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+private:
+    // 1. retrieve the vertex/fragment source code from filePath
+    // ------------------------------------------------------------------------
+    void readSources(const char* vertexPath, const char* fragmentPath, std::string& vertexCode, std::string& fragmentCode)
+    {
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         // ensure ifstream objects can throw exceptions:
@@ -45,9 +217,13 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
         }
+    }
+    // 2. compile shaders and link the program
+    // ------------------------------------------------------------------------
+    void compile(const std::string& vertexCode, const std::string& fragmentCode)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -63,79 +239,117 @@ public:
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (glProgramParameteri != NULL)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
-    }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() const
-    { 
-        glUseProgram(ID); 
-    }
-    // utility uniform functions
-    // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-    }
-    // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    static std::string insertDefines(const std::string& code, const std::string& defines)
+    {
+        if (defines.empty())
+            return code;
+        // #version has to stay the first line
+        size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+        if (lineEnd == std::string::npos)
+            return defines + "\n" + code;
+        return code.substr(0, lineEnd + 1) + defines + "\n" + code.substr(lineEnd + 1);
     }
+    // 64-bit FNV-1a
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    static unsigned long long hashSource(const std::string& text)
+    {
+        unsigned long long hash = 14695981039346656037ull;
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
     }
+    // a stale or foreign binary fails to link, the caller then compiles from source
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    bool loadBinary(const std::string& cachePath)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        std::ifstream file(cachePath, std::ios::binary);
+        if (!file)
+            return false;
+        GLenum format = 0;
+        file.read((char*)&format, sizeof(format));
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file.eof() || binary.empty())
+            return false;
+        ID = glCreateProgram();
+        glProgramBinary(ID, format, binary.data(), (GLsizei)binary.size());
+        GLint success;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(ID);
+            return false;
+        }
+        cacheUniforms();
+        return true;
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void saveBinary(const std::string& cacheDir, const std::string& cachePath)
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint success, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length == 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(ID, length, NULL, &format, binary.data());
+        std::error_code error;
+        std::filesystem::create_directories(cacheDir, error);
+        std::ofstream file(cachePath, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::CACHE_NOT_WRITABLE: " << cachePath << std::endl;
+            return;
+        }
+        file.write((const char*)&format, sizeof(format));
+        file.write(binary.data(), binary.size());
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void cacheUniforms()
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location == -1)
+                continue;
+            uniformLocations[name] = location;
+            // arrays are listed once as name[0], also answer to the bare name and every element
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = location;
+                for (GLint element = 1; element < size; ++element)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
     }
-
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -161,5 +375,7 @@ private:
             }
         }
     }
+
+    std::unordered_map<std::string, GLint> uniformLocations;
 };
 #endif
@@ -0,0 +1,142 @@
+#ifndef SPHERE_INSTANCES_H
+#define SPHERE_INSTANCES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+
+//Per sphere data of an instanced draw, the layout balls_instanced.vs reads
+struct SphereInstance
+{
+	glm::mat4 model;
+	//rgb tints the sphere, a is the refraction ratio where 0 reflects
+	glm::vec4 material;
+};
+
+//A unit UV sphere with shared vertices and an index buffer, plus a buffer of SphereInstance on
+//the same VAO so any number of spheres goes out in one glDrawElementsInstanced.
+//Attributes: 0 position, 1 normal, 2 texture coords, 3-6 model matrix, 7 material
+class SphereInstances
+{
+public:
+	unsigned int VAO;
+
+	SphereInstances(int xSegments, int ySegments)
+	{
+		const float PI = 3.14159265358979323846f;
+		std::vector<float> vertices;
+		for (int y = 0; y <= ySegments; ++y)
+		{
+			for (int x = 0; x <= xSegments; ++x)
+			{
+				float xSegment = (float)x / (float)xSegments;
+				float ySegment = (float)y / (float)ySegments;
+				float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+				float yPos = std::cos(ySegment * PI);
+				float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+				// on a unit sphere the position is the normal
+				float vertex[8] = { xPos, yPos, zPos, xPos, yPos, zPos, xSegment, ySegment };
+				vertices.insert(vertices.end(), vertex, vertex + 8);
+			}
+		}
+		std::vector<unsigned int> indices;
+		for (int i = 0; i < ySegments; ++i)
+		{
+			for (int j = 0; j < xSegments; ++j)
+			{
+				unsigned int quad[6] = { (unsigned int)(i * (xSegments + 1) + j), (unsigned int)((i + 1) * (xSegments + 1) + j),
+					(unsigned int)((i + 1) * (xSegments + 1) + j + 1), (unsigned int)(i * (xSegments + 1) + j),
+					(unsigned int)((i + 1) * (xSegments + 1) + j + 1), (unsigned int)(i * (xSegments + 1) + j + 1) };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		m_indexCount = (int)indices.size();
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glGenBuffers(1, &instanceVBO);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+		// a mat4 attribute takes four locations, one per column. the buffer starts out holding one
+		// identity instance, so drawSingle never reads enabled attributes from a buffer without storage
+		SphereInstance identity = { glm::mat4(1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 0.0f) };
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(SphereInstance), &identity, GL_STREAM_DRAW);
+		m_capacity = 1;
+		for (int column = 0; column < 4; ++column)
+		{
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance),
+				(void*)(offsetof(SphereInstance, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+		glEnableVertexAttribArray(7);
+		glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, material));
+		glVertexAttribDivisor(7, 1);
+		glBindVertexArray(0);
+	}
+
+	//Replaces the instances. The buffer is orphaned every time so the driver never waits for
+	//the draw still reading last frame's instances, and only grows
+	void upload(const SphereInstance* instances, int count)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		if (count > m_capacity)
+		{
+			m_capacity = count;
+		}
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(SphereInstance), NULL, GL_STREAM_DRAW);
+		if (count > 0)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(SphereInstance), instances);
+		}
+		m_instanceCount = count;
+	}
+
+	//Every uploaded instance in one call
+	void draw() const
+	{
+		glBindVertexArray(VAO);
+		glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, 0, m_instanceCount);
+	}
+
+	//One sphere, for shaders that take the model matrix as a uniform instead
+	void drawSingle() const
+	{
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, 0);
+	}
+
+	int getIndexCount() const { return m_indexCount; }
+	int getInstanceCount() const { return m_instanceCount; }
+
+	void release()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		glDeleteBuffers(1, &instanceVBO);
+	}
+
+private:
+	unsigned int VBO, EBO, instanceVBO;
+	int m_indexCount = 0;
+	int m_instanceCount = 0;
+	int m_capacity = 0;
+};
+#endif
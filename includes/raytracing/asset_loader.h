@@ -0,0 +1,151 @@
+#ifndef RAY_TRACING_ASSET_LOADER_H_
+#define RAY_TRACING_ASSET_LOADER_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "texture_mips.h"
+#include "texture_cache.h"
+#include "mesh_import.h"
+#include "thread_pool.h"
+
+// a 1x1 cube map of one color, stands in for the environment until the real one is loaded
+unsigned int CreateSolidCubemap(const glm::vec3& color)
+{
+    unsigned char texel[3] = { (unsigned char)(glm::clamp(color.r, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (unsigned char)(glm::clamp(color.g, 0.0f, 1.0f) * 255.0f + 0.5f), (unsigned char)(glm::clamp(color.b, 0.0f, 1.0f) * 255.0f + 0.5f) };
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+// decodes images and imports meshes on a thread pool. a worker never touches GL or std::cout:
+// when it is done it queues the upload with whatever it had to report, and ProcessUploads
+// prints that and runs the queued uploads and then the caller's callbacks on the GL thread.
+// the render loop calls it once per frame and keeps drawing whatever it has until the
+// callbacks swap the real assets in
+class AssetLoader
+{
+public:
+    explicit AssetLoader(unsigned int threadCount = 0, TextureCache& cache = SharedTextureCache()): cache(cache), pool(threadCount) {}
+
+    // the six faces are loaded through the texture cache in parallel, onReady gets the cube map
+    // (0 if a face failed). faces the cache already holds, or holds on disk, are not decoded again
+    void LoadCubemap(const std::vector<std::string>& faces, std::function<void(unsigned int)> onReady)
+    {
+        struct Faces
+        {
+            std::vector<std::string> paths;
+            std::shared_ptr<const CachedTexture> images[6];
+            std::ostringstream logs[6];
+            std::atomic<int> remaining{ 6 };
+        };
+        std::shared_ptr<Faces> cubemap = std::make_shared<Faces>();
+        cubemap->paths = faces;
+        TextureEncoding encoding = cache.PreferredEncoding();
+        ++pending;
+        for(int i = 0; i < 6; ++i)
+        {
+            pool.Submit([this, cubemap, i, encoding, onReady]()
+            {
+                cubemap->images[i] = i < (int)cubemap->paths.size() ?
+                    cache.Load(cubemap->paths[i], encoding, false, cubemap->logs[i]) : nullptr;
+                // the last face to finish hands the whole cube map over
+                if(--cubemap->remaining == 0)
+                {
+                    Queue([this, cubemap, onReady]()
+                    {
+                        for(const std::ostringstream& log : cubemap->logs)
+                        {
+                            std::cout << log.str();
+                        }
+                        onReady(cache.Cubemap(cubemap->images));
+                    });
+                }
+            });
+        }
+    }
+
+    // imported on a worker, onReady may move the meshes out. they are empty when the import failed
+    void LoadMeshes(const std::string& path, std::function<void(std::vector<TriangleMesh>&)> onReady)
+    {
+        ++pending;
+        pool.Submit([this, path, onReady]()
+        {
+            std::shared_ptr<std::vector<TriangleMesh>> meshes = std::make_shared<std::vector<TriangleMesh>>();
+            std::shared_ptr<std::ostringstream> log = std::make_shared<std::ostringstream>();
+            MeshImportStats stats;
+            bool imported = ImportTriangleMeshes(path, *meshes, &stats, MeshImporter::Auto, *log);
+            if(!imported)
+            {
+                meshes->clear();
+            }
+            Queue([path, meshes, log, imported, stats, onReady]()
+            {
+                std::cout << log->str();
+                if(imported)
+                {
+                    PrintMeshImportStats(path, stats);
+                }
+                onReady(*meshes);
+            });
+        });
+    }
+
+    // runs every upload that is ready, on the GL thread. returns how many ran
+    int ProcessUploads()
+    {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(uploadMutex);
+            ready.swap(uploads);
+        }
+        for(std::function<void()>& upload : ready)
+        {
+            upload();
+            --pending;
+        }
+        return (int)ready.size();
+    }
+
+    // assets that are still loading or waiting for their upload
+    int Pending() const { return pending; }
+
+private:
+    void Queue(std::function<void()> upload)
+    {
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        uploads.push_back(std::move(upload));
+    }
+
+    TextureCache& cache;
+    std::mutex uploadMutex;
+    std::vector<std::function<void()>> uploads;
+    std::atomic<int> pending{ 0 };
+    // last, so the workers are joined before the queue they write to goes away
+    ThreadPool pool;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef RAY_TRACING_BVH_H_
 #define RAY_TRACING_BVH_H_
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 #include "aabb.h"
 #include "hittable_list.h"
@@ -8,6 +10,23 @@
 
 using std::vector;
 
+// a node's indices and type go into the float texels of the BVHNodes buffer as int bits and the
+// shaders read them back with floatBitsToInt: a float holds every integer only up to 2^24, a
+// 10M object scene has 20M nodes
+inline float NodeIndexTexel(int index)
+{
+    float texel;
+    std::memcpy(&texel, &index, sizeof(float));
+    return texel;
+}
+
+inline int NodeTexelIndex(float texel)
+{
+    int index;
+    std::memcpy(&index, &texel, sizeof(int));
+    return index;
+}
+
 class BVHNode
 {
 public:
@@ -72,4 +91,18 @@ void BuildBVHNodes(vector<BVHNode>& BVHNodes, HittableList& objects)
     }
 }
 
+// number of nodes on the longest root to leaf path, a traversal stack never holds more
+int BVHDepth(const vector<BVHNode>& BVHNodes, int node)
+{
+    if(node == -1)
+    {
+        return 0;
+    }
+    if(BVHNodes[node].objectIndex != -1)
+    {
+        return 1;
+    }
+    return 1 + std::max(BVHDepth(BVHNodes, BVHNodes[node].left), BVHDepth(BVHNodes, BVHNodes[node].right));
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef RAY_TRACING_CAMERA_PATH_H_
+#define RAY_TRACING_CAMERA_PATH_H_
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+#include <glm/glm.hpp>
+#include <learnopengl/camera.h>
+
+// camera state over time, recorded from live input and replayed at a fixed timestep so every
+// replay renders the same views in the same frames no matter how fast the recording ran.
+// the file is text, one line per recorded frame: time position.xyz yaw pitch zoom
+class CameraPath
+{
+public:
+    struct Key
+    {
+        float time;
+        glm::vec3 position;
+        float yaw, pitch, zoom;
+    };
+
+    // appends the camera as it is at time seconds, times must not decrease
+    void Record(float time, const Camera& camera)
+    {
+        keys.push_back({ time, camera.Position, camera.Yaw, camera.Pitch, camera.Zoom });
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if(!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        file << "# time x y z yaw pitch zoom" << std::endl;
+        file << std::setprecision(9);
+        for(const Key& key : keys)
+        {
+            file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " "
+                << key.yaw << " " << key.pitch << " " << key.zoom << "\n";
+        }
+        return true;
+    }
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path);
+        if(!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        while(std::getline(file, line))
+        {
+            if(line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream in(line);
+            Key key;
+            if(in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom)
+            {
+                keys.push_back(key);
+            }
+        }
+        // replays start at time zero whenever the recording started
+        if(keys.empty())
+        {
+            return false;
+        }
+        float start = keys.front().time;
+        for(Key& key : keys)
+        {
+            key.time -= start;
+        }
+        return true;
+    }
+
+    // frames a replay at the given timestep takes to cover the whole path
+    int FrameCount(float timestep) const
+    {
+        return keys.empty() ? 0 : (int)(Duration() / timestep) + 1;
+    }
+
+    float Duration() const
+    {
+        return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+    }
+
+    // puts the camera where the path is at frame * timestep, between two keys it interpolates
+    void Apply(int frame, float timestep, Camera& camera) const
+    {
+        if(keys.empty())
+        {
+            return;
+        }
+        float time = keys.front().time + frame * timestep;
+        // the first key at or after time, binary searched since the times never decrease
+        size_t next = std::lower_bound(keys.begin() + 1, keys.end(), time,
+            [](const Key& key, float t) { return key.time < t; }) - keys.begin();
+        if(next >= keys.size())
+        {
+            const Key& last = keys.back();
+            camera.SetPose(last.position, last.yaw, last.pitch, last.zoom);
+            return;
+        }
+        const Key& a = keys[next - 1];
+        const Key& b = keys[next];
+        float t = b.time > a.time ? glm::clamp((time - a.time) / (b.time - a.time), 0.0f, 1.0f) : 1.0f;
+        camera.SetPose(glm::mix(a.position, b.position, t), glm::mix(a.yaw, b.yaw, t),
+            glm::mix(a.pitch, b.pitch, t), glm::mix(a.zoom, b.zoom, t));
+    }
+
+    std::vector<Key> keys;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef RAY_TRACING_DENOISER_H_
+#define RAY_TRACING_DENOISER_H_
+
+#include <string>
+#include <utility>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <raytracing/render_target.h>
+
+// edge-avoiding a-trous wavelet denoiser (SVGF style) running as full screen passes.
+// the path tracer renders radiance, first-hit normal/depth and albedo into the trace target,
+// the motion pass reprojects every first hit into the previous frame, the temporal pass
+// accumulates demodulated illumination and its luminance moments along those motion vectors,
+// and the a-trous passes filter the illumination guided by normal, depth and variance.
+class Denoiser
+{
+public:
+    Denoiser(int width, int height, const std::string& shaderDir):
+    motionShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/denoise_motion.fs").c_str()),
+    temporalShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/denoise_temporal.fs").c_str()),
+    atrousShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/denoise_atrous.fs").c_str()),
+    modulateShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/denoise_modulate.fs").c_str()),
+    atrousIterations(5), maxHistoryLength(32.0f),
+    sigmaLuminance(4.0f), sigmaNormal(128.0f), sigmaDepth(0.05f),
+    depthTolerance(0.1f), normalTolerance(0.9f),
+    viewProjection(1.0f), prevViewProjection(1.0f), cameraPosition(0.0f), prevCameraPosition(0.0f),
+    historyIndex(0), historyValid(false)
+    {
+        CreateTargets(width, height);
+
+        motionShader.use();
+        motionShader.setInt("normalDepthTexture", 0);
+        temporalShader.use();
+        temporalShader.setInt("colorTexture", 0);
+        temporalShader.setInt("albedoTexture", 1);
+        temporalShader.setInt("historyIllumination", 2);
+        temporalShader.setInt("historyMoments", 3);
+        temporalShader.setInt("normalDepthTexture", 4);
+        temporalShader.setInt("prevNormalDepthTexture", 5);
+        temporalShader.setInt("motionTexture", 6);
+        atrousShader.use();
+        atrousShader.setInt("illuminationTexture", 0);
+        atrousShader.setInt("normalDepthTexture", 1);
+        modulateShader.use();
+        modulateShader.setInt("illuminationTexture", 0);
+        modulateShader.setInt("albedoTexture", 1);
+    }
+
+    ~Denoiser()
+    {
+        ReleaseTargets();
+    }
+
+    // reallocates every target for a new render resolution, the history does not survive
+    void Resize(int width, int height)
+    {
+        ReleaseTargets();
+        CreateTargets(width, height);
+        historyValid = false;
+    }
+
+    // the path tracer draws into this target with three outputs
+    void BindTraceTarget() const
+    {
+        traceTarget.Bind();
+    }
+
+    unsigned int ColorTexture() const { return traceTarget.textures[0]; }
+    unsigned int NormalDepthTexture() const { return traceTarget.textures[1]; }
+    unsigned int AlbedoTexture() const { return traceTarget.textures[2]; }
+
+    unsigned int MotionTexture() const { return motionTarget.textures[0]; }
+
+    // forget accumulated samples, e.g. after the scene changed
+    void ResetHistory()
+    {
+        historyValid = false;
+    }
+
+    // camera the coming frame is traced with. the history keeps the camera it was accumulated
+    // with for reprojection
+    void SetCamera(const glm::mat4& currViewProjection, const glm::vec3& currPosition)
+    {
+        viewProjection = currViewProjection;
+        cameraPosition = currPosition;
+    }
+
+    // runs the temporal and a-trous passes, then writes the remodulated image into outputFBO.
+    // accumulate false filters the frame without keeping it in the history, for trace targets
+    // that are only partly new like the slices of a tiled trace
+    void Denoise(unsigned int quadVAO, bool temporal, unsigned int outputFBO, int outputWidth, int outputHeight,
+        bool accumulate = true)
+    {
+        glBindVertexArray(quadVAO);
+        if(!historyValid)
+        {
+            prevViewProjection = viewProjection;
+            prevCameraPosition = cameraPosition;
+        }
+
+        // motion vectors
+        motionTarget.Bind();
+        motionShader.use();
+        motionShader.setMat4("inverseViewProjection", glm::inverse(viewProjection));
+        motionShader.setMat4("prevViewProjection", prevViewProjection);
+        motionShader.setVec3("cameraPosition", cameraPosition);
+        motionShader.setVec3("prevCameraPosition", prevCameraPosition);
+        BindTexture(0, NormalDepthTexture());
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+        // temporal accumulation
+        int prev = historyIndex;
+        int curr = 1 - historyIndex;
+        history[curr].Bind();
+        temporalShader.use();
+        temporalShader.setBool("resetHistory", !temporal || !historyValid);
+        temporalShader.setFloat("maxHistoryLength", maxHistoryLength);
+        temporalShader.setFloat("depthTolerance", depthTolerance);
+        temporalShader.setFloat("normalTolerance", normalTolerance);
+        BindTexture(0, ColorTexture());
+        BindTexture(1, AlbedoTexture());
+        BindTexture(2, history[prev].textures[0]);
+        BindTexture(3, history[prev].textures[1]);
+        BindTexture(4, NormalDepthTexture());
+        BindTexture(5, prevNormalDepth.textures[0]);
+        BindTexture(6, MotionTexture());
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        if(accumulate)
+        {
+            historyIndex = curr;
+            historyValid = true;
+            prevViewProjection = viewProjection;
+            prevCameraPosition = cameraPosition;
+
+            // keep this frame's surfaces around to validate the next reprojection
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, traceTarget.FBO);
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevNormalDepth.FBO);
+            glBlitFramebuffer(0, 0, traceTarget.width, traceTarget.height, 0, 0, traceTarget.width, traceTarget.height,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+        }
+
+        // a-trous iterations with growing step size
+        atrousShader.use();
+        atrousShader.setFloat("sigmaLuminance", sigmaLuminance);
+        atrousShader.setFloat("sigmaNormal", sigmaNormal);
+        atrousShader.setFloat("sigmaDepth", sigmaDepth);
+        BindTexture(1, NormalDepthTexture());
+        unsigned int input = history[curr].textures[0];
+        for(int i = 0; i < atrousIterations; ++i)
+        {
+            pingPong[i % 2].Bind();
+            atrousShader.setInt("stepSize", 1 << i);
+            BindTexture(0, input);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            input = pingPong[i % 2].textures[0];
+        }
+
+        // put the albedo back on
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glViewport(0, 0, outputWidth, outputHeight);
+        modulateShader.use();
+        BindTexture(0, input);
+        BindTexture(1, AlbedoTexture());
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    Shader motionShader;
+    Shader temporalShader;
+    Shader atrousShader;
+    Shader modulateShader;
+    int atrousIterations;
+    float maxHistoryLength;
+    float sigmaLuminance;
+    float sigmaNormal;
+    float sigmaDepth;
+    float depthTolerance;
+    float normalTolerance;
+
+private:
+    void CreateTargets(int width, int height)
+    {
+        // color, normal + depth, albedo
+        traceTarget.Create(width, height, 3);
+        // illumination + variance, moments + history length
+        history[0].Create(width, height, 2);
+        history[1].Create(width, height, 2);
+        pingPong[0].Create(width, height, 1);
+        pingPong[1].Create(width, height, 1);
+        // reprojected uv offset, expected depth, background flag
+        motionTarget.Create(width, height, 1);
+        prevNormalDepth.Create(width, height, 1);
+    }
+
+    void ReleaseTargets()
+    {
+        traceTarget.Release();
+        history[0].Release();
+        history[1].Release();
+        pingPong[0].Release();
+        pingPong[1].Release();
+        motionTarget.Release();
+        prevNormalDepth.Release();
+    }
+
+    void BindTexture(int unit, unsigned int texture)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    RenderTarget traceTarget;
+    RenderTarget history[2];
+    RenderTarget pingPong[2];
+    RenderTarget motionTarget;
+    RenderTarget prevNormalDepth;
+    glm::mat4 viewProjection, prevViewProjection;
+    glm::vec3 cameraPosition, prevCameraPosition;
+    int historyIndex;
+    bool historyValid;
+};
+
+#endif
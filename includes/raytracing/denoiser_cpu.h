@@ -0,0 +1,283 @@
+#ifndef RAY_TRACING_DENOISER_CPU_H_
+#define RAY_TRACING_DENOISER_CPU_H_
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAY_TRACING_DENOISER_SSE 1
+#endif
+
+// four pixels processed side by side, SSE when available
+#ifdef RAY_TRACING_DENOISER_SSE
+struct Float4
+{
+    __m128 v;
+    Float4() {}
+    Float4(__m128 x) : v(x) {}
+    explicit Float4(float x) : v(_mm_set1_ps(x)) {}
+    static Float4 Load(const float* p) { return Float4(_mm_loadu_ps(p)); }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline Float4 operator+(Float4 a, Float4 b) { return Float4(_mm_add_ps(a.v, b.v)); }
+inline Float4 operator-(Float4 a, Float4 b) { return Float4(_mm_sub_ps(a.v, b.v)); }
+inline Float4 operator*(Float4 a, Float4 b) { return Float4(_mm_mul_ps(a.v, b.v)); }
+inline Float4 operator/(Float4 a, Float4 b) { return Float4(_mm_div_ps(a.v, b.v)); }
+inline Float4 Max(Float4 a, Float4 b) { return Float4(_mm_max_ps(a.v, b.v)); }
+inline Float4 Min(Float4 a, Float4 b) { return Float4(_mm_min_ps(a.v, b.v)); }
+inline Float4 Abs(Float4 a) { return Float4(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+inline Float4 Sqrt(Float4 a) { return Float4(_mm_sqrt_ps(a.v)); }
+// 2^x for x <= 0, exponent bits plus a cubic for the fraction
+inline Float4 Exp2Negative(Float4 x)
+{
+    __m128 c = _mm_max_ps(x.v, _mm_set1_ps(-126.0f));
+    __m128i ipart = _mm_cvttps_epi32(_mm_sub_ps(c, _mm_set1_ps(0.99999994f)));
+    __m128 fpart = _mm_sub_ps(c, _mm_cvtepi32_ps(ipart));
+    __m128 expipart = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(ipart, _mm_set1_epi32(127)), 23));
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(
+        _mm_set1_ps(0.0790199f), fpart), _mm_set1_ps(0.2249423f)), fpart), _mm_set1_ps(0.6960656f)), fpart), _mm_set1_ps(1.0f));
+    return Float4(_mm_mul_ps(expipart, p));
+}
+#else
+struct Float4
+{
+    float v[4];
+    Float4() {}
+    explicit Float4(float x) { v[0] = v[1] = v[2] = v[3] = x; }
+    static Float4 Load(const float* p) { Float4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+    void Store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+};
+#define RAY_TRACING_FLOAT4_OP(name, expr) \
+    inline Float4 name(Float4 a, Float4 b) { Float4 r; for(int i = 0; i < 4; ++i) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return r; }
+RAY_TRACING_FLOAT4_OP(operator+, x + y)
+RAY_TRACING_FLOAT4_OP(operator-, x - y)
+RAY_TRACING_FLOAT4_OP(operator*, x * y)
+RAY_TRACING_FLOAT4_OP(operator/, x / y)
+RAY_TRACING_FLOAT4_OP(Max, std::max(x, y))
+RAY_TRACING_FLOAT4_OP(Min, std::min(x, y))
+#undef RAY_TRACING_FLOAT4_OP
+inline Float4 Abs(Float4 a) { Float4 r; for(int i = 0; i < 4; ++i) r.v[i] = std::fabs(a.v[i]); return r; }
+inline Float4 Sqrt(Float4 a) { Float4 r; for(int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+inline Float4 Exp2Negative(Float4 a) { Float4 r; for(int i = 0; i < 4; ++i) r.v[i] = std::exp2(std::max(a.v[i], -126.0f)); return r; }
+#endif
+
+inline Float4 ExpNegative(Float4 x)
+{
+    return Exp2Negative(x * Float4(-1.4426950f));
+}
+
+// CPU counterpart of the GL denoiser passes. buffers are RGBA float images as read back from the
+// trace target (color, normal + depth, albedo); internally the image is kept as padded planes so
+// every tap of the 5x5 kernel is an unaligned load of four neighbouring pixels.
+class CpuDenoiser
+{
+public:
+    CpuDenoiser(int width, int height):
+    atrousIterations(5), maxHistoryLength(32.0f),
+    sigmaLuminance(4.0f), sigmaNormal(128.0f), sigmaDepth(0.05f),
+    width(width), height(height), historyValid(false)
+    {
+        // 2 * 2^(iterations - 1) plus room for the last group of four
+        padding = 36;
+        stride = width + 2 * padding;
+        planeSize = stride * (height + 2 * padding);
+        for(auto& p : illumination) p.assign(planeSize, 0.0f);
+        for(auto& p : filtered) p.assign(planeSize, 0.0f);
+        for(auto& p : normalDepth) p.assign(planeSize, 0.0f);
+        for(auto& p : albedo) p.assign(planeSize, 0.0f);
+        for(auto& p : historyIllumination) p.assign(planeSize, 0.0f);
+        for(auto& p : historyMoments) p.assign(planeSize, 0.0f);
+    }
+
+    void ResetHistory()
+    {
+        historyValid = false;
+    }
+
+    // color, normalDepth and albedo are width * height * 4 floats, output receives the filtered RGBA image
+    void Denoise(const float* color, const float* normalDepthIn, const float* albedoIn, bool temporal, float* output)
+    {
+        Temporal(color, normalDepthIn, albedoIn, temporal && historyValid);
+        historyValid = true;
+
+        std::vector<float>* input = illumination;
+        std::vector<float>* target = filtered;
+        for(int i = 0; i < atrousIterations; ++i)
+        {
+            Atrous(input, target, 1 << i);
+            std::swap(input, target);
+        }
+
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                int p = Index(x, y);
+                float* out = output + 4 * (y * width + x);
+                for(int c = 0; c < 3; ++c)
+                {
+                    out[c] = input[c][p] * std::max(albedo[c][p], 0.001f);
+                }
+                out[3] = 1.0f;
+            }
+        }
+    }
+
+    int atrousIterations;
+    float maxHistoryLength;
+    float sigmaLuminance;
+    float sigmaNormal;
+    float sigmaDepth;
+
+private:
+    int Index(int x, int y) const
+    {
+        return (y + padding) * stride + x + padding;
+    }
+
+    static float Luminance(float r, float g, float b)
+    {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    // same math as denoise_temporal.fs, the planes of the first a-trous input are filled here
+    void Temporal(const float* color, const float* normalDepthIn, const float* albedoIn, bool useHistory)
+    {
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                int src = 4 * (y * width + x);
+                int p = Index(x, y);
+                float ill[3];
+                for(int c = 0; c < 3; ++c)
+                {
+                    albedo[c][p] = albedoIn[src + c];
+                    ill[c] = color[src + c] / std::max(albedoIn[src + c], 0.001f);
+                }
+                for(int c = 0; c < 4; ++c)
+                {
+                    normalDepth[c][p] = normalDepthIn[src + c];
+                }
+                float l = Luminance(ill[0], ill[1], ill[2]);
+                float m1 = l, m2 = l * l;
+                float len = useHistory ? historyMoments[2][p] : 0.0f;
+                len = std::min(len + 1.0f, maxHistoryLength);
+                float alpha = 1.0f / len;
+                for(int c = 0; c < 3; ++c)
+                {
+                    float prev = useHistory ? historyIllumination[c][p] : 0.0f;
+                    ill[c] = prev + (ill[c] - prev) * alpha;
+                    historyIllumination[c][p] = ill[c];
+                    illumination[c][p] = ill[c];
+                }
+                if(useHistory)
+                {
+                    m1 = historyMoments[0][p] + (m1 - historyMoments[0][p]) * alpha;
+                    m2 = historyMoments[1][p] + (m2 - historyMoments[1][p]) * alpha;
+                }
+                historyMoments[0][p] = m1;
+                historyMoments[1][p] = m2;
+                historyMoments[2][p] = len;
+                float variance = std::max(m2 - m1 * m1, 0.0f);
+                illumination[3][p] = len < 4.0f ? std::max(variance, 1.0f) : variance;
+            }
+        }
+    }
+
+    // one a-trous iteration, four output pixels per step. the padding keeps normals at zero so
+    // taps falling outside the image get no weight.
+    void Atrous(const std::vector<float>* in, std::vector<float>* out, int step)
+    {
+        static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+        const Float4 lumR(0.2126f), lumG(0.7152f), lumB(0.0722f);
+        const Float4 zero(0.0f), one(1.0f), epsilon(1e-4f);
+        const int normalPower = std::max(0, (int)std::round(std::log2(sigmaNormal)));
+
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; x += 4)
+            {
+                int p = Index(x, y);
+                Float4 cr = Float4::Load(&in[0][p]);
+                Float4 cg = Float4::Load(&in[1][p]);
+                Float4 cb = Float4::Load(&in[2][p]);
+                Float4 cv = Float4::Load(&in[3][p]);
+                Float4 nx = Float4::Load(&normalDepth[0][p]);
+                Float4 ny = Float4::Load(&normalDepth[1][p]);
+                Float4 nz = Float4::Load(&normalDepth[2][p]);
+                Float4 z = Float4::Load(&normalDepth[3][p]);
+
+                Float4 centerLuminance = cr * lumR + cg * lumG + cb * lumB;
+                Float4 luminanceScale = Float4(sigmaLuminance) * Sqrt(Max(cv, zero)) + epsilon;
+                Float4 depthScale = Float4(sigmaDepth * step) * z + epsilon;
+
+                Float4 sumR = cr, sumG = cg, sumB = cb, sumV = cv, sumW = one;
+                for(int ky = -2; ky <= 2; ++ky)
+                {
+                    for(int kx = -2; kx <= 2; ++kx)
+                    {
+                        if(kx == 0 && ky == 0)
+                            continue;
+                        int q = p + (ky * stride + kx) * step;
+                        Float4 sr = Float4::Load(&in[0][q]);
+                        Float4 sg = Float4::Load(&in[1][q]);
+                        Float4 sb = Float4::Load(&in[2][q]);
+                        Float4 sv = Float4::Load(&in[3][q]);
+
+                        Float4 d = Max(nx * Float4::Load(&normalDepth[0][q]) + ny * Float4::Load(&normalDepth[1][q])
+                            + nz * Float4::Load(&normalDepth[2][q]), zero);
+                        // pow(d, 2^k) by repeated squaring
+                        for(int i = 0; i < normalPower; ++i)
+                            d = d * d;
+                        Float4 wDepth = ExpNegative(Abs(z - Float4::Load(&normalDepth[3][q])) / depthScale);
+                        Float4 sampleLuminance = sr * lumR + sg * lumG + sb * lumB;
+                        Float4 wLuminance = ExpNegative(Abs(centerLuminance - sampleLuminance) / luminanceScale);
+                        Float4 w = Float4(kernel[std::abs(kx)] * kernel[std::abs(ky)] / (kernel[0] * kernel[0])) * d * wDepth * wLuminance;
+
+                        sumR = sumR + w * sr;
+                        sumG = sumG + w * sg;
+                        sumB = sumB + w * sb;
+                        sumV = sumV + w * w * sv;
+                        sumW = sumW + w;
+                    }
+                }
+
+                // the environment is already noise free, keep it untouched
+                float zs[4], r[4], g[4], b[4], v[4];
+                z.Store(zs);
+                (sumR / sumW).Store(r);
+                (sumG / sumW).Store(g);
+                (sumB / sumW).Store(b);
+                (sumV / (sumW * sumW)).Store(v);
+                for(int i = 0; i < 4 && x + i < width; ++i)
+                {
+                    bool background = zs[i] >= backgroundDepth;
+                    out[0][p + i] = background ? in[0][p + i] : r[i];
+                    out[1][p + i] = background ? in[1][p + i] : g[i];
+                    out[2][p + i] = background ? in[2][p + i] : b[i];
+                    out[3][p + i] = background ? in[3][p + i] : v[i];
+                }
+            }
+        }
+    }
+
+    // matches RAYCAST_MAX in the tracer, written as depth when the primary ray escapes
+    static constexpr float backgroundDepth = 100000.0f;
+
+    int width, height;
+    int padding, stride, planeSize;
+    bool historyValid;
+    std::vector<float> illumination[4];
+    std::vector<float> filtered[4];
+    std::vector<float> normalDepth[4];
+    std::vector<float> albedo[3];
+    std::vector<float> historyIllumination[3];
+    std::vector<float> historyMoments[3];
+};
+
+#endif
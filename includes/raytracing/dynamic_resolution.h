@@ -0,0 +1,188 @@
+#ifndef RAY_TRACING_DYNAMIC_RESOLUTION_H_
+#define RAY_TRACING_DYNAMIC_RESOLUTION_H_
+
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_m.h>
+#include <raytracing/render_target.h>
+
+// gpu time spent between Begin and End. queries rotate through a small ring and are read
+// a few frames later, so asking for the result never stalls the pipeline.
+class GpuFrameTimer
+{
+public:
+    GpuFrameTimer() : current(0), lastMs(-1.0f)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+        for(int i = 0; i < QUERY_COUNT; ++i)
+        {
+            pending[i] = false;
+        }
+    }
+
+    ~GpuFrameTimer()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+    void Begin()
+    {
+        // the slot is about to be reused, its result is old enough to be ready by now
+        if(pending[current])
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+            lastMs = elapsed * 1e-6f;
+            pending[current] = false;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        current = (current + 1) % QUERY_COUNT;
+    }
+
+    // most recent finished measurement, negative until the first one arrives
+    float LastMs() const { return lastMs; }
+
+private:
+    static const int QUERY_COUNT = 4;
+    unsigned int queries[QUERY_COUNT];
+    bool pending[QUERY_COUNT];
+    int current;
+    float lastMs;
+};
+
+// picks the render resolution from measured frame times. the cost of the tracer grows with
+// the pixel count, so the scale factor moves with the square root of the time ratio.
+// it drops quickly when over budget, climbs back one step at a time when well under it,
+// and waits a few frames after every change so the new cost can be measured.
+class DynamicResolution
+{
+public:
+    DynamicResolution(int maxWidth, int maxHeight, float targetMs):
+    targetMs(targetMs), minScale(0.5f), maxScale(1.0f), scaleStep(0.0625f),
+    headroom(0.8f), smoothing(0.1f), cooldownFrames(15),
+    maxWidth(maxWidth), maxHeight(maxHeight), scale(1.0f), smoothedMs(-1.0f), cooldown(0)
+    {
+    }
+
+    // feeds the time of the last frame, returns true when the render resolution changed
+    bool Update(float frameMs)
+    {
+        if(frameMs <= 0.0f)
+            return false;
+        smoothedMs = smoothedMs < 0.0f ? frameMs : smoothedMs + (frameMs - smoothedMs) * smoothing;
+        if(cooldown > 0)
+        {
+            --cooldown;
+            return false;
+        }
+
+        float newScale = scale;
+        if(smoothedMs > targetMs)
+        {
+            float desired = scale * std::sqrt(targetMs / smoothedMs);
+            newScale = std::min(std::floor(desired / scaleStep) * scaleStep, scale - scaleStep);
+        }
+        else if(smoothedMs < targetMs * headroom)
+        {
+            newScale = scale + scaleStep;
+        }
+        newScale = std::max(minScale, std::min(maxScale, newScale));
+        if(newScale == scale)
+            return false;
+
+        scale = newScale;
+        smoothedMs = -1.0f;
+        cooldown = cooldownFrames;
+        return true;
+    }
+
+    float Scale() const { return scale; }
+    float SmoothedMs() const { return smoothedMs; }
+    // rounded down to even sizes
+    int RenderWidth() const { return std::max(2, (int)(maxWidth * scale) & ~1); }
+    int RenderHeight() const { return std::max(2, (int)(maxHeight * scale) & ~1); }
+
+    float targetMs;
+    float minScale;
+    float maxScale;
+    float scaleStep;
+    // fraction of the budget the frame has to stay under before the resolution goes up
+    float headroom;
+    float smoothing;
+    int cooldownFrames;
+
+private:
+    int maxWidth, maxHeight;
+    float scale;
+    float smoothedMs;
+    int cooldown;
+};
+
+// brings the low resolution image up to the window. the filter is a lanczos-like 4x4 kernel
+// stretched along local edges, clamped to the nearest 2x2 texels against ringing.
+class Upscaler
+{
+public:
+    Upscaler(int width, int height, const std::string& shaderDir):
+    upscaleShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/upscale.fs").c_str())
+    {
+        source.Create(width, height, 1);
+        upscaleShader.use();
+        upscaleShader.setInt("sourceTexture", 0);
+    }
+
+    ~Upscaler()
+    {
+        source.Release();
+    }
+
+    void Resize(int width, int height)
+    {
+        source.Release();
+        source.Create(width, height, 1);
+    }
+
+    // the low resolution image is rendered into this framebuffer
+    unsigned int SourceFBO() const { return source.FBO; }
+    void BindSource() const { source.Bind(); }
+    unsigned int SourceTexture() const { return source.textures[0]; }
+
+    void Upscale(unsigned int quadVAO, int outputWidth, int outputHeight)
+    {
+        if(source.width == outputWidth && source.height == outputHeight)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, source.FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, outputWidth, outputHeight,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, outputWidth, outputHeight);
+        upscaleShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source.textures[0]);
+        glBindVertexArray(quadVAO);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    Shader upscaleShader;
+
+private:
+    RenderTarget source;
+};
+
+#endif
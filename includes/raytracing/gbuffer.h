@@ -0,0 +1,281 @@
+#ifndef RAY_TRACING_GBUFFER_H_
+#define RAY_TRACING_GBUFFER_H_
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <raytracing/render_target.h>
+#include "hittable_list.h"
+
+extern const int OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT, OBJ_MODEL;
+
+// rasterized primary visibility for the hybrid tracer. every pixel gets the first surface
+// the tracer's camera ray would hit, so the tracer starts its paths there and only traces
+// the bounces. spheres are drawn as instances of one tessellated sphere that is a little
+// larger than the real one, and each fragment intersects the exact sphere and writes that
+// depth, so silhouettes and hit points match the analytic test. rects and model triangles
+// are a static triangle list.
+// the two attachments are position + object type (0 for no hit) and the normal, oriented the
+// way the tracer's hit functions orient it, + the object index that selects the material.
+class GBuffer
+{
+public:
+    GBuffer(int width, int height, const std::string& shaderDir):
+    shader((shaderDir + "/gbuffer.vs").c_str(), (shaderDir + "/gbuffer.fs").c_str()),
+    sphereShader((shaderDir + "/gbuffer_sphere.vs").c_str(), (shaderDir + "/gbuffer_sphere.fs").c_str()),
+    sphereVAO(0), sphereVBO(0), sphereEBO(0), instanceVBO(0), triangleVAO(0), triangleVBO(0),
+    sphereIndexCount(0), sphereCount(0), triangleVertexCount(0), coverScale(1.0f), depthBuffer(0)
+    {
+        CreateTarget(width, height);
+    }
+
+    ~GBuffer()
+    {
+        ReleaseTarget();
+        glDeleteVertexArrays(1, &sphereVAO);
+        glDeleteBuffers(1, &sphereVBO);
+        glDeleteBuffers(1, &sphereEBO);
+        glDeleteBuffers(1, &instanceVBO);
+        glDeleteVertexArrays(1, &triangleVAO);
+        glDeleteBuffers(1, &triangleVBO);
+    }
+
+    void Resize(int width, int height)
+    {
+        ReleaseTarget();
+        CreateTarget(width, height);
+    }
+
+    // uploads the scene in the order the tracer indexes it, i.e. after sorting. the model is
+    // given as three positions and three normals per triangle, like the tracer's triangle buffer
+    void Build(HittableList& objects, const std::vector<glm::vec3>& modelPositions, const std::vector<glm::vec3>& modelNormals)
+    {
+        BuildSphereMesh(32, 16);
+
+        // per instance center + radius and object type + index
+        std::vector<float> instances;
+        std::vector<float> triangles;
+        for(int i = 0; i < (int)objects.size(); ++i)
+        {
+            const Hittable& object = *objects[i];
+            if(object.objectType == OBJ_SPHERE)
+            {
+                instances.insert(instances.end(), { object.center.x, object.center.y, object.center.z, object.radius,
+                    (float)object.objectType, (float)i });
+            }
+            else if(object.objectType == OBJ_MODEL)
+            {
+                for(size_t v = 0; v < modelPositions.size(); ++v)
+                {
+                    PushVertex(triangles, modelPositions[v], modelNormals[v], object.objectType, i);
+                }
+            }
+            else
+            {
+                PushRect(triangles, object, i);
+            }
+        }
+        sphereCount = instances.size() / 6;
+        triangleVertexCount = triangles.size() / 8;
+
+        glBindVertexArray(sphereVAO);
+        if(instanceVBO == 0)
+        {
+            glGenBuffers(1, &instanceVBO);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(4 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+
+        if(triangleVAO == 0)
+        {
+            glGenVertexArrays(1, &triangleVAO);
+            glGenBuffers(1, &triangleVBO);
+        }
+        glBindVertexArray(triangleVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, triangleVBO);
+        glBufferData(GL_ARRAY_BUFFER, triangles.size() * sizeof(float), triangles.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // rasterizes the scene as seen by the tracer's camera, same parameters as its CameraConstructor
+    void Render(const glm::vec3& lookFrom, const glm::vec3& lookAt, const glm::vec3& vup, float vfov, float aspectRatio)
+    {
+        glm::mat4 viewProjection = glm::perspective(glm::radians(vfov), aspectRatio, NEAR_PLANE, FAR_PLANE) *
+            glm::lookAt(lookFrom, lookAt, vup);
+
+        target.Bind();
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        if(sphereCount > 0)
+        {
+            sphereShader.use();
+            sphereShader.setMat4("viewProjection", viewProjection);
+            sphereShader.setVec3("cameraPosition", lookFrom);
+            sphereShader.setFloat("coverScale", coverScale);
+            glBindVertexArray(sphereVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, sphereCount);
+        }
+        if(triangleVertexCount > 0)
+        {
+            shader.use();
+            shader.setMat4("viewProjection", viewProjection);
+            shader.setVec3("cameraPosition", lookFrom);
+            glBindVertexArray(triangleVAO);
+            glDrawArrays(GL_TRIANGLES, 0, triangleVertexCount);
+        }
+        glBindVertexArray(0);
+        glDisable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    unsigned int PositionTexture() const { return target.textures[0]; }
+    unsigned int NormalTexture() const { return target.textures[1]; }
+
+    Shader shader;
+    Shader sphereShader;
+
+private:
+    static constexpr float NEAR_PLANE = 0.01f;
+    static constexpr float FAR_PLANE = 100000.0f;
+
+    void CreateTarget(int width, int height)
+    {
+        target.Create(width, height, 2);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void ReleaseTarget()
+    {
+        target.Release();
+        glDeleteRenderbuffers(1, &depthBuffer);
+        depthBuffer = 0;
+    }
+
+    // unit uv sphere like the one in balls_earth, indexed. the flat faces lie inside the round
+    // sphere, coverScale pushes them out far enough that they cover all of its pixels
+    void BuildSphereMesh(int xSegments, int ySegments)
+    {
+        if(sphereVAO != 0)
+        {
+            return;
+        }
+        const float PI = 3.14159265358979323846f;
+        std::vector<float> points;
+        std::vector<unsigned int> indices;
+        for(int y = 0; y <= ySegments; ++y)
+        {
+            for(int x = 0; x <= xSegments; ++x)
+            {
+                float xSegment = (float)x / xSegments;
+                float ySegment = (float)y / ySegments;
+                points.push_back(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI));
+                points.push_back(std::cos(ySegment * PI));
+                points.push_back(std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI));
+            }
+        }
+        for(int i = 0; i < ySegments; ++i)
+        {
+            for(int j = 0; j < xSegments; ++j)
+            {
+                unsigned int a = i * (xSegments + 1) + j;
+                unsigned int b = (i + 1) * (xSegments + 1) + j;
+                indices.insert(indices.end(), { a, b, b + 1, a, b + 1, a + 1 });
+            }
+        }
+        sphereIndexCount = indices.size();
+        // a face spans at most half a segment in each direction from its center
+        float halfX = PI / xSegments, halfY = PI / (2.0f * ySegments);
+        coverScale = 1.0f / std::cos(std::sqrt(halfX * halfX + halfY * halfY));
+
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &sphereVBO);
+        glGenBuffers(1, &sphereEBO);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+        glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(float), points.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+    }
+
+    static void PushVertex(std::vector<float>& triangles, const glm::vec3& p, const glm::vec3& n, int objectType, int objectIndex)
+    {
+        triangles.insert(triangles.end(), { p.x, p.y, p.z, n.x, n.y, n.z, (float)objectType, (float)objectIndex });
+    }
+
+    // two triangles in the rect's plane, the normal is flipped per fragment like SetFaceNormal
+    static void PushRect(std::vector<float>& triangles, const Hittable& rect, int objectIndex)
+    {
+        glm::vec3 corners[4];
+        glm::vec3 normal;
+        if(rect.objectType == OBJ_XYRECT)
+        {
+            corners[0] = { rect.x0, rect.y0, rect.k }; corners[1] = { rect.x1, rect.y0, rect.k };
+            corners[2] = { rect.x1, rect.y1, rect.k }; corners[3] = { rect.x0, rect.y1, rect.k };
+            normal = { 0.0f, 0.0f, 1.0f };
+        }
+        else if(rect.objectType == OBJ_XZRECT)
+        {
+            corners[0] = { rect.x0, rect.k, rect.z0 }; corners[1] = { rect.x1, rect.k, rect.z0 };
+            corners[2] = { rect.x1, rect.k, rect.z1 }; corners[3] = { rect.x0, rect.k, rect.z1 };
+            normal = { 0.0f, 1.0f, 0.0f };
+        }
+        else if(rect.objectType == OBJ_YZRECT)
+        {
+            corners[0] = { rect.k, rect.y0, rect.z0 }; corners[1] = { rect.k, rect.y1, rect.z0 };
+            corners[2] = { rect.k, rect.y1, rect.z1 }; corners[3] = { rect.k, rect.y0, rect.z1 };
+            normal = { 1.0f, 0.0f, 0.0f };
+        }
+        else
+        {
+            return;
+        }
+        const int order[] = { 0, 1, 2, 0, 2, 3 };
+        for(int i : order)
+        {
+            PushVertex(triangles, corners[i], normal, rect.objectType, objectIndex);
+        }
+    }
+
+    RenderTarget target;
+    unsigned int sphereVAO, sphereVBO, sphereEBO, instanceVBO;
+    unsigned int triangleVAO, triangleVBO;
+    int sphereIndexCount, sphereCount, triangleVertexCount;
+    float coverScale;
+    unsigned int depthBuffer;
+};
+
+#endif
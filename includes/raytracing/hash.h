@@ -0,0 +1,14 @@
+#ifndef RAY_TRACING_HASH_H_
+#define RAY_TRACING_HASH_H_
+
+#include <cstdint>
+
+// splitmix64's finalizer, every input bit reaches every output bit
+inline uint64_t SplitMix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define RAYTRACING_HITTABLE_H
 
 #include <memory>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,6 +20,8 @@ public:
     float radius;
     float x0, x1, y0, y1, z0, z1, k;
     std::shared_ptr<Material> matPtr;
+    // index of matPtr in the MaterialPool, what the tracers read
+    uint16_t materialIndex = 0;
     AABB box;
     int objectType;
     int modelId;
@@ -26,7 +26,7 @@ public:
         }
         bool firstBox = true;
         AABB tmpBox;
-        for(auto object : objects)
+        for(const auto& object : objects)
         {
             if(!object->BoundingBox(tmpBox))
             {
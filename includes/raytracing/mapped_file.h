@@ -0,0 +1,122 @@
+#ifndef RAY_TRACING_MAPPED_FILE_H_
+#define RAY_TRACING_MAPPED_FILE_H_
+
+#include <string>
+#include <cstddef>
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// a read only view of a whole file. the pages are mapped, not copied, so a parser can walk a
+// file of several gigabytes without holding a second copy of it in memory
+class MappedFile
+{
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string& path) { Open(path); }
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+        Close();
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            std::cout << "Failed to open file: " << path << std::endl;
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = (size_t)fileSize.QuadPart;
+        if(size > 0)
+        {
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            data = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        }
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if(descriptor < 0)
+        {
+            std::cout << "Failed to open file: " << path << std::endl;
+            return false;
+        }
+        struct stat status;
+        fstat(descriptor, &status);
+        size = (size_t)status.st_size;
+        if(size > 0)
+        {
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(view != MAP_FAILED)
+            {
+                data = (const char*)view;
+                madvise(view, size, MADV_SEQUENTIAL);
+            }
+        }
+        close(descriptor);
+#endif
+        if(size > 0 && !data)
+        {
+            std::cout << "Failed to map file: " << path << std::endl;
+            Close();
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if(data)
+        {
+            UnmapViewOfFile(data);
+        }
+        if(mapping)
+        {
+            CloseHandle(mapping);
+        }
+        if(file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(data)
+        {
+            munmap((void*)data, size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        opened = false;
+    }
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+    bool IsOpen() const { return opened; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+#endif
@@ -10,12 +10,14 @@ using glm::vec3;
 class Material
 {
 public:
-    Material(const vec3& co, int type, float roughness = 0, float ior = 0):
-    color(co),materialType(type), roughness(roughness), ior(ior) {}
+    Material(const vec3& co, int type, float roughness = 0, float ior = 0, int texture = -1):
+    color(co),materialType(type), roughness(roughness), ior(ior), texture(texture) {}
     vec3 color;
     int materialType;
     float roughness;
     float ior;
+    // slot in TextureArrays, -1 for untextured materials
+    int texture;
     
 };
 
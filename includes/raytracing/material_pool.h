@@ -0,0 +1,167 @@
+#ifndef RAY_TRACING_MATERIAL_POOL_H_
+#define RAY_TRACING_MATERIAL_POOL_H_
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "material.h"
+#include "hittable_list.h"
+#include "texture_array.h"
+
+// texels per material in the materials buffer:
+// [color.rgb, materialType] [roughness, ior, textureClass, textureLayer] [uvScale.xy, 0, 0]
+// textureClass is -1 for untextured materials
+const int MATERIAL_TEXELS = 3;
+// materials are referenced with 16 bit indices
+const int MATERIAL_POOL_MAX = 65536;
+
+// every distinct material once, referenced by index from the primitives. identical materials
+// (same color, type, roughness, ior and texture) share one entry, so the objects buffer only
+// carries an index and editing a material is one small buffer update.
+class MaterialPool
+{
+public:
+    // index of material, added if no equal one is in the pool yet
+    uint16_t Intern(const Material& material)
+    {
+        Key key = MakeKey(material);
+        auto found = indexByKey.find(key);
+        if(found != indexByKey.end())
+        {
+            return found->second;
+        }
+        if((int)materials.size() >= MATERIAL_POOL_MAX)
+        {
+            std::cout << "ERROR::MATERIAL_POOL::FULL " << MATERIAL_POOL_MAX << " materials" << std::endl;
+            return 0;
+        }
+        uint16_t index = (uint16_t)materials.size();
+        materials.push_back(std::make_shared<Material>(material));
+        indexByKey[key] = index;
+        return index;
+    }
+
+    // sets materialIndex of every object and points objects with equal materials at one shared
+    // instance, so the duplicates the scene builders allocate are released
+    void Intern(HittableList& objects)
+    {
+        for(auto& object : objects)
+        {
+            if(!object->matPtr)
+            {
+                continue;
+            }
+            object->materialIndex = Intern(*object->matPtr);
+            object->matPtr = materials[object->materialIndex];
+        }
+    }
+
+    // changes a material in place, Upload(buffer, index) then sends just that record
+    void Set(uint16_t index, const Material& material)
+    {
+        indexByKey.erase(MakeKey(*materials[index]));
+        *materials[index] = material;
+        indexByKey[MakeKey(material)] = index;
+    }
+
+    // one RGBA32F buffer texture worth of data, MATERIAL_TEXELS texels per material.
+    // textures may be null when no material is textured
+    std::vector<float> Pack(const TextureArrays* textures = nullptr) const
+    {
+        std::vector<float> data(materials.size() * MATERIAL_TEXELS * 4, 0.0f);
+        for(size_t i = 0; i < materials.size(); ++i)
+        {
+            PackMaterial(*materials[i], textures, &data[i * MATERIAL_TEXELS * 4]);
+        }
+        return data;
+    }
+
+    // rewrites the record of one material in a buffer filled from Pack
+    void Upload(unsigned int buffer, uint16_t index, const TextureArrays* textures = nullptr) const
+    {
+        float texels[MATERIAL_TEXELS * 4];
+        PackMaterial(*materials[index], textures, texels);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, sizeof(texels) * index, sizeof(texels), texels);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    int Size() const { return (int)materials.size(); }
+
+    std::vector<std::shared_ptr<Material>> materials;
+
+private:
+    // the material fields as raw bits, equal keys mean bitwise equal materials
+    struct Key
+    {
+        float color[3];
+        int materialType;
+        float roughness, ior;
+        int texture;
+
+        bool operator==(const Key& other) const
+        {
+            return std::memcmp(this, &other, sizeof(Key)) == 0;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            // fnv-1a over the bytes
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+            size_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < sizeof(Key); ++i)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    static Key MakeKey(const Material& material)
+    {
+        Key key;
+        std::memset(&key, 0, sizeof(Key));
+        key.color[0] = material.color.x;
+        key.color[1] = material.color.y;
+        key.color[2] = material.color.z;
+        key.materialType = material.materialType;
+        key.roughness = material.roughness;
+        key.ior = material.ior;
+        key.texture = material.texture;
+        return key;
+    }
+
+    static void PackMaterial(const Material& m, const TextureArrays* textures, float* texel)
+    {
+        std::memset(texel, 0, sizeof(float) * MATERIAL_TEXELS * 4);
+        texel[0] = m.color.x;
+        texel[1] = m.color.y;
+        texel[2] = m.color.z;
+        texel[3] = (float)m.materialType;
+        texel[4] = m.roughness;
+        texel[5] = m.ior;
+        texel[6] = -1.0f;
+        if(textures && m.texture >= 0 && m.texture < (int)textures->slots.size())
+        {
+            const TextureSlot& slot = textures->slots[m.texture];
+            texel[6] = (float)slot.sizeClass;
+            texel[7] = (float)slot.layer;
+            texel[8] = slot.uvScale.x;
+            texel[9] = slot.uvScale.y;
+        }
+    }
+
+    std::unordered_map<Key, uint16_t, KeyHash> indexByKey;
+};
+
+#endif
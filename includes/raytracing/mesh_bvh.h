@@ -0,0 +1,140 @@
+#ifndef RAY_TRACING_MESH_BVH_H_
+#define RAY_TRACING_MESH_BVH_H_
+
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// leaves hold up to this many triangles
+const int MESH_BVH_LEAF_TRIANGLES = 4;
+// no path from the root is longer, the tracer's MODEL_STACK_SIZE has to hold this many nodes
+const int MESH_BVH_MAX_DEPTH = 32;
+
+// count 0: an inner node with children at the next index and at offset.
+// count > 0: a leaf holding the triangles [offset, offset + count) of the leaf order
+struct MeshBVHNode
+{
+    glm::vec3 minimum;
+    int count;
+    glm::vec3 maximum;
+    int offset;
+};
+
+// the bottom level bvh of one model, in its own coordinates so a top level node can reference
+// it. nodes are stored depth first, every parent before its children, so a refit after the
+// vertices moved is one backwards pass that keeps the topology and only grows or shrinks boxes
+class MeshBVH
+{
+public:
+    // corners holds three positions per triangle. order receives the leaf order, order[i] is the
+    // triangle that goes to position i, the triangles have to be stored in that order
+    void Build(const glm::vec3* corners, int triangleCount, std::vector<int>& order)
+    {
+        nodes.clear();
+        order.resize(triangleCount);
+        std::vector<glm::vec3> centroids(triangleCount);
+        for(int i = 0; i < triangleCount; ++i)
+        {
+            order[i] = i;
+            centroids[i] = (corners[3 * i] + corners[3 * i + 1] + corners[3 * i + 2]) / 3.0f;
+        }
+        nodes.reserve(std::max(1, 2 * triangleCount / MESH_BVH_LEAF_TRIANGLES + 1));
+        depth = 0;
+        // no triangles, no nodes
+        if(triangleCount > 0)
+        {
+            Split(corners, centroids, order, 0, triangleCount, 1);
+        }
+    }
+
+    // new bounds for corners in leaf order, after skinning or any other deformation
+    void Refit(const glm::vec3* corners)
+    {
+        for(int i = (int)nodes.size() - 1; i >= 0; --i)
+        {
+            MeshBVHNode& node = nodes[i];
+            if(node.count > 0)
+            {
+                node.minimum = node.maximum = corners[3 * node.offset];
+                for(int c = 3 * node.offset + 1; c < 3 * (node.offset + node.count); ++c)
+                {
+                    node.minimum = glm::min(node.minimum, corners[c]);
+                    node.maximum = glm::max(node.maximum, corners[c]);
+                }
+            }
+            else
+            {
+                node.minimum = glm::min(nodes[i + 1].minimum, nodes[node.offset].minimum);
+                node.maximum = glm::max(nodes[i + 1].maximum, nodes[node.offset].maximum);
+            }
+        }
+    }
+
+    // two texels per node: [minimum, count] [maximum, offset]
+    void Pack(float (*texels)[4]) const
+    {
+        for(size_t i = 0; i < nodes.size(); ++i)
+        {
+            const MeshBVHNode& node = nodes[i];
+            texels[2 * i][0] = node.minimum.x;
+            texels[2 * i][1] = node.minimum.y;
+            texels[2 * i][2] = node.minimum.z;
+            texels[2 * i][3] = (float)node.count;
+            texels[2 * i + 1][0] = node.maximum.x;
+            texels[2 * i + 1][1] = node.maximum.y;
+            texels[2 * i + 1][2] = node.maximum.z;
+            texels[2 * i + 1][3] = (float)node.offset;
+        }
+    }
+
+    int NodeCount() const { return (int)nodes.size(); }
+    int Depth() const { return depth; }
+    glm::vec3 Minimum() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].minimum; }
+    glm::vec3 Maximum() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].maximum; }
+
+    std::vector<MeshBVHNode> nodes;
+
+private:
+    // median split along the longest axis of the centroids
+    void Split(const glm::vec3* corners, const std::vector<glm::vec3>& centroids, std::vector<int>& order,
+        int begin, int end, int level)
+    {
+        depth = std::max(depth, level);
+        int index = (int)nodes.size();
+        nodes.push_back(MeshBVHNode());
+        glm::vec3 minimum(0.0f), maximum(0.0f), centerMinimum(0.0f), centerMaximum(0.0f);
+        for(int i = begin; i < end; ++i)
+        {
+            const glm::vec3* triangle = corners + 3 * order[i];
+            glm::vec3 low = glm::min(glm::min(triangle[0], triangle[1]), triangle[2]);
+            glm::vec3 high = glm::max(glm::max(triangle[0], triangle[1]), triangle[2]);
+            const glm::vec3& center = centroids[order[i]];
+            minimum = i == begin ? low : glm::min(minimum, low);
+            maximum = i == begin ? high : glm::max(maximum, high);
+            centerMinimum = i == begin ? center : glm::min(centerMinimum, center);
+            centerMaximum = i == begin ? center : glm::max(centerMaximum, center);
+        }
+        nodes[index].minimum = minimum;
+        nodes[index].maximum = maximum;
+        if(end - begin <= MESH_BVH_LEAF_TRIANGLES || level >= MESH_BVH_MAX_DEPTH)
+        {
+            nodes[index].count = end - begin;
+            nodes[index].offset = begin;
+            return;
+        }
+        glm::vec3 extent = centerMaximum - centerMinimum;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        int middle = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+            [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        Split(corners, centroids, order, begin, middle, level + 1);
+        nodes[index].count = 0;
+        nodes[index].offset = (int)nodes.size();
+        Split(corners, centroids, order, middle, end, level + 1);
+    }
+
+    int depth = 0;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef RAY_TRACING_MESH_IMPORT_H_
+#define RAY_TRACING_MESH_IMPORT_H_
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "triangle_mesh.h"
+#include "obj_parser.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+struct MeshImportStats
+{
+    double milliseconds = 0.0;
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    // bytes held by the imported meshes
+    size_t meshBytes = 0;
+    // resident set of the process around the import, peak is the highest it got so far
+    size_t residentBefore = 0;
+    size_t residentAfter = 0;
+    size_t residentPeak = 0;
+};
+
+// resident set size of this process in bytes, 0 where it can't be queried
+size_t ResidentMemoryBytes(bool peak = false)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return peak ? counters.PeakWorkingSetSize : counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__)
+    FILE* status = std::fopen("/proc/self/status", "r");
+    if(!status)
+    {
+        return 0;
+    }
+    const char* key = peak ? "VmHWM:" : "VmRSS:";
+    char line[256];
+    size_t kilobytes = 0;
+    while(std::fgets(line, sizeof(line), status))
+    {
+        if(std::strncmp(line, key, 6) == 0)
+        {
+            std::sscanf(line + 6, "%zu", &kilobytes);
+            break;
+        }
+    }
+    std::fclose(status);
+    return kilobytes * 1024;
+#else
+    return 0;
+#endif
+}
+
+void ProcessTriangleMeshNode(const aiNode* node, const aiScene* scene, const std::string& directory,
+    std::vector<TriangleMesh>& meshes)
+{
+    for(unsigned int i = 0; i < node->mNumMeshes; ++i)
+    {
+        const aiMesh* source = scene->mMeshes[node->mMeshes[i]];
+        TriangleMesh mesh;
+        mesh.positions.resize(source->mNumVertices);
+        mesh.normals.resize(source->mNumVertices, glm::vec3(0.0f));
+        mesh.uvs.resize(source->mNumVertices, glm::vec2(0.0f));
+        for(unsigned int v = 0; v < source->mNumVertices; ++v)
+        {
+            mesh.positions[v] = glm::vec3(source->mVertices[v].x, source->mVertices[v].y, source->mVertices[v].z);
+        }
+        if(source->HasNormals())
+        {
+            for(unsigned int v = 0; v < source->mNumVertices; ++v)
+            {
+                mesh.normals[v] = glm::vec3(source->mNormals[v].x, source->mNormals[v].y, source->mNormals[v].z);
+            }
+        }
+        if(source->mTextureCoords[0])
+        {
+            for(unsigned int v = 0; v < source->mNumVertices; ++v)
+            {
+                mesh.uvs[v] = glm::vec2(source->mTextureCoords[0][v].x, source->mTextureCoords[0][v].y);
+            }
+        }
+        // triangulated, so every face has three indices; points and lines are dropped
+        mesh.indices.reserve(source->mNumFaces * 3);
+        for(unsigned int f = 0; f < source->mNumFaces; ++f)
+        {
+            const aiFace& face = source->mFaces[f];
+            if(face.mNumIndices == 3)
+            {
+                mesh.indices.insert(mesh.indices.end(), face.mIndices, face.mIndices + 3);
+            }
+        }
+        const aiMaterial* material = scene->mMaterials[source->mMaterialIndex];
+        aiString texture;
+        if(material->GetTextureCount(aiTextureType_DIFFUSE) > 0
+            && material->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS)
+        {
+            mesh.diffusePath = directory + "/" + texture.C_Str();
+        }
+        meshes.push_back(std::move(mesh));
+    }
+    for(unsigned int i = 0; i < node->mNumChildren; ++i)
+    {
+        ProcessTriangleMeshNode(node->mChildren[i], scene, directory, meshes);
+    }
+}
+
+// assimp keeps the node order of learnopengl's Model, so mesh i of both is the same mesh
+bool ImportTriangleMeshesWithAssimp(const std::string& path, std::vector<TriangleMesh>& meshes, std::ostream& log = std::cout)
+{
+    Assimp::Importer importer;
+    // drop everything the tracer never reads before the other steps see it
+    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS
+        | aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS | aiComponent_LIGHTS | aiComponent_CAMERAS);
+    const aiScene* scene = importer.ReadFile(path, aiProcess_RemoveComponent | aiProcess_Triangulate
+        | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        log << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    ProcessTriangleMeshNode(scene->mRootNode, scene, path.substr(0, path.find_last_of('/')), meshes);
+    return true;
+}
+
+enum class MeshImporter
+{
+    // the native parser for .obj, assimp for everything else and for obj files it can't read
+    Auto,
+    Assimp,
+    Obj
+};
+
+// imports every mesh of the file into meshes. returns false and writes the error to log when it fails
+bool ImportTriangleMeshes(const std::string& path, std::vector<TriangleMesh>& meshes, MeshImportStats* stats = nullptr,
+    MeshImporter importer = MeshImporter::Auto, std::ostream& log = std::cout)
+{
+    size_t residentBefore = ResidentMemoryBytes();
+    auto start = std::chrono::steady_clock::now();
+    size_t firstMesh = meshes.size();
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool imported = false;
+    if(importer == MeshImporter::Obj || (importer == MeshImporter::Auto && extension == "obj"))
+    {
+        imported = ParseObj(path, meshes, 0, log);
+    }
+    if(!imported && importer != MeshImporter::Obj)
+    {
+        imported = ImportTriangleMeshesWithAssimp(path, meshes, log);
+    }
+    if(!imported)
+    {
+        return false;
+    }
+    if(stats)
+    {
+        auto end = std::chrono::steady_clock::now();
+        *stats = MeshImportStats();
+        stats->milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        for(size_t i = firstMesh; i < meshes.size(); ++i)
+        {
+            stats->vertexCount += meshes[i].VertexCount();
+            stats->triangleCount += meshes[i].TriangleCount();
+            stats->meshBytes += meshes[i].Bytes();
+        }
+        stats->residentBefore = residentBefore;
+        stats->residentAfter = ResidentMemoryBytes();
+        stats->residentPeak = ResidentMemoryBytes(true);
+    }
+    return true;
+}
+
+void PrintMeshImportStats(const std::string& path, const MeshImportStats& stats)
+{
+    const double MiB = 1024.0 * 1024.0;
+    std::cout << path << ": " << stats.vertexCount << " vertices, " << stats.triangleCount << " triangles in "
+        << stats.milliseconds << " ms, meshes " << stats.meshBytes / MiB << " MiB, resident "
+        << stats.residentBefore / MiB << " -> " << stats.residentAfter / MiB << " MiB (peak "
+        << stats.residentPeak / MiB << " MiB)" << std::endl;
+}
+
+#endif
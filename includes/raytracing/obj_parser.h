@@ -0,0 +1,604 @@
+#ifndef RAY_TRACING_OBJ_PARSER_H_
+#define RAY_TRACING_OBJ_PARSER_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include "triangle_mesh.h"
+#include "mapped_file.h"
+
+// a native reader for the subset of wavefront OBJ that scanned and exported meshes use:
+// v, vt, vn, f (any polygon, fan triangulated, negative indices allowed), usemtl and mtllib
+// with map_Kd. the file is mapped, cut into one chunk per thread at line boundaries and the
+// chunks are parsed in parallel, then merged into one TriangleMesh per material. uvs are
+// flipped and missing normals are smoothed like assimp's FlipUVs and GenSmoothNormals do.
+
+// chunks smaller than this are not worth a thread of their own
+const size_t OBJ_MIN_CHUNK_BYTES = 1 << 20;
+
+// one face corner, 0 based indices into the merged arrays, -1 when the corner has none
+struct ObjCorner
+{
+    int position;
+    int uv;
+    int normal;
+};
+
+struct ObjChunk
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    // three per triangle
+    std::vector<ObjCorner> corners;
+    // corner components written as chunk local indices (negative obj indices), corner * 3 + component.
+    // they only become global once the sizes of the chunks before are known
+    std::vector<size_t> relative;
+    // usemtl lines as (first triangle in this chunk, name)
+    std::vector<std::pair<size_t, std::string>> materials;
+    std::vector<std::string> libraries;
+    bool failed = false;
+};
+
+// [+-]digits[.digits][(e|E)[+-]digits]. up to 19 significant digits are gathered in an integer
+// and scaled by an exact power of ten, which is exact for everything a mesh file contains and
+// needs no locale or strtod. returns the position after the number, p itself when there is none
+const char* ParseObjFloat(const char* p, const char* end, float& value)
+{
+    static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* start = p;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char* firstDigit = p;
+    while(p < end && (unsigned)(*p - '0') < 10)
+    {
+        if(digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa > 0;
+        }
+        else
+        {
+            ++exponent;
+        }
+        ++p;
+    }
+    bool hasDigits = p != firstDigit;
+    if(p < end && *p == '.')
+    {
+        ++p;
+        const char* fraction = p;
+        while(p < end && (unsigned)(*p - '0') < 10)
+        {
+            if(digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa > 0;
+                --exponent;
+            }
+            ++p;
+        }
+        hasDigits = hasDigits || p != fraction;
+    }
+    if(!hasDigits)
+    {
+        return start;
+    }
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if(q < end && (*q == '-' || *q == '+'))
+        {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+        if(q < end && (unsigned)(*q - '0') < 10)
+        {
+            int e = 0;
+            while(q < end && (unsigned)(*q - '0') < 10)
+            {
+                e = std::min(e * 10 + (*q - '0'), 10000);
+                ++q;
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    double result = (double)mantissa;
+    if(mantissa != 0)
+    {
+        if(exponent >= -22 && exponent <= 22)
+        {
+            result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+        }
+        else
+        {
+            result *= std::pow(10.0, exponent);
+        }
+    }
+    value = (float)(negative ? -result : result);
+    return p;
+}
+
+// [+-]digits, same contract as ParseObjFloat
+const char* ParseObjInt(const char* p, const char* end, int& value)
+{
+    const char* start = p;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+    const char* firstDigit = p;
+    int64_t result = 0;
+    while(p < end && (unsigned)(*p - '0') < 10)
+    {
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+        ++p;
+    }
+    if(p == firstDigit)
+    {
+        return start;
+    }
+    value = (int)(negative ? -result : result);
+    return p;
+}
+
+inline const char* SkipObjBlanks(const char* p, const char* end)
+{
+    while(p < end && (*p == ' ' || *p == '\t'))
+    {
+        ++p;
+    }
+    return p;
+}
+
+inline const char* SkipObjLine(const char* p, const char* end)
+{
+    const char* newline = (const char*)std::memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// the rest of the line without surrounding blanks, for names and paths
+std::string ObjLineArgument(const char* p, const char* end)
+{
+    p = SkipObjBlanks(p, end);
+    const char* last = p;
+    while(last < end && *last != '\n' && *last != '\r')
+    {
+        ++last;
+    }
+    while(last > p && (last[-1] == ' ' || last[-1] == '\t'))
+    {
+        --last;
+    }
+    return std::string(p, last);
+}
+
+// converts an obj index (1 based, negative counts back from the last element read so far) to a
+// chunk local 0 based one and notes it in relative when it has to be shifted in the merge
+inline int ResolveObjIndex(int index, size_t localCount, size_t component, ObjChunk& chunk)
+{
+    if(index > 0)
+    {
+        return index - 1;
+    }
+    chunk.relative.push_back(component);
+    return (int)localCount + index;
+}
+
+void ParseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+{
+    std::vector<ObjCorner> polygon;
+    while(p < end)
+    {
+        const char* line = SkipObjBlanks(p, end);
+        const char* next = SkipObjLine(line, end);
+        const char* lineEnd = next;
+        if(line + 1 >= lineEnd)
+        {
+            p = next;
+            continue;
+        }
+        char c0 = line[0], c1 = line[1];
+        if(c0 == 'v' && (c1 == ' ' || c1 == '\t'))
+        {
+            glm::vec3 position(0.0f);
+            const char* q = line + 1;
+            for(int i = 0; i < 3; ++i)
+            {
+                q = ParseObjFloat(SkipObjBlanks(q, lineEnd), lineEnd, position[i]);
+            }
+            chunk.positions.push_back(position);
+        }
+        else if(c0 == 'v' && c1 == 't')
+        {
+            glm::vec2 uv(0.0f);
+            const char* q = line + 2;
+            for(int i = 0; i < 2; ++i)
+            {
+                q = ParseObjFloat(SkipObjBlanks(q, lineEnd), lineEnd, uv[i]);
+            }
+            uv.y = 1.0f - uv.y;
+            chunk.uvs.push_back(uv);
+        }
+        else if(c0 == 'v' && c1 == 'n')
+        {
+            glm::vec3 normal(0.0f);
+            const char* q = line + 2;
+            for(int i = 0; i < 3; ++i)
+            {
+                q = ParseObjFloat(SkipObjBlanks(q, lineEnd), lineEnd, normal[i]);
+            }
+            chunk.normals.push_back(normal);
+        }
+        else if(c0 == 'f' && (c1 == ' ' || c1 == '\t'))
+        {
+            // v, v/vt, v//vn or v/vt/vn per corner
+            polygon.clear();
+            const char* q = SkipObjBlanks(line + 1, lineEnd);
+            while(q < lineEnd && *q != '\n' && *q != '\r' && *q != '#')
+            {
+                int position = 0, uv = 0, normal = 0;
+                const char* after = ParseObjInt(q, lineEnd, position);
+                if(after == q || position == 0)
+                {
+                    chunk.failed = true;
+                    return;
+                }
+                q = after;
+                if(q < lineEnd && *q == '/')
+                {
+                    q = ParseObjInt(q + 1, lineEnd, uv);
+                    if(q < lineEnd && *q == '/')
+                    {
+                        q = ParseObjInt(q + 1, lineEnd, normal);
+                    }
+                }
+                // components are resolved when the polygon is emitted, until then 0 means absent
+                polygon.push_back({ position, uv, normal });
+                q = SkipObjBlanks(q, lineEnd);
+            }
+            for(size_t i = 2; i < polygon.size(); ++i)
+            {
+                const ObjCorner* fan[3] = { &polygon[0], &polygon[i - 1], &polygon[i] };
+                for(const ObjCorner* corner : fan)
+                {
+                    size_t base = chunk.corners.size() * 3;
+                    ObjCorner resolved;
+                    resolved.position = ResolveObjIndex(corner->position, chunk.positions.size(), base, chunk);
+                    resolved.uv = corner->uv == 0 ? -1 : ResolveObjIndex(corner->uv, chunk.uvs.size(), base + 1, chunk);
+                    resolved.normal = corner->normal == 0 ? -1 : ResolveObjIndex(corner->normal, chunk.normals.size(), base + 2, chunk);
+                    chunk.corners.push_back(resolved);
+                }
+            }
+        }
+        else if(lineEnd - line > 7 && std::strncmp(line, "usemtl", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+        {
+            chunk.materials.push_back({ chunk.corners.size() / 3, ObjLineArgument(line + 6, lineEnd) });
+        }
+        else if(lineEnd - line > 7 && std::strncmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+        {
+            chunk.libraries.push_back(ObjLineArgument(line + 6, lineEnd));
+        }
+        p = next;
+    }
+}
+
+// newmtl name -> map_Kd path, relative paths are made relative to directory
+void ParseObjMaterialLibrary(const std::string& path, const std::string& directory, std::map<std::string, std::string>& diffuseMaps)
+{
+    MappedFile file;
+    if(!file.Open(path))
+    {
+        return;
+    }
+    const char* p = file.Data();
+    const char* end = p + file.Size();
+    std::string material;
+    while(p < end)
+    {
+        const char* line = SkipObjBlanks(p, end);
+        const char* next = SkipObjLine(line, end);
+        if(next - line > 7 && std::strncmp(line, "newmtl", 6) == 0)
+        {
+            material = ObjLineArgument(line + 6, next);
+        }
+        else if(next - line > 6 && std::strncmp(line, "map_Kd", 6) == 0)
+        {
+            // options like -s 1 1 1 come first, the file name is the last token
+            std::string argument = ObjLineArgument(line + 6, next);
+            size_t space = argument.find_last_of(" \t");
+            diffuseMaps[material] = directory + "/" + (space == std::string::npos ? argument : argument.substr(space + 1));
+        }
+        p = next;
+    }
+}
+
+// parses path into one TriangleMesh per material, appended to meshes in order of first use.
+// threadCount 0 uses every hardware thread. returns false without touching meshes when the file
+// can't be read or uses something this reader doesn't handle, the caller can fall back to assimp.
+// errors go to log
+bool ParseObj(const std::string& path, std::vector<TriangleMesh>& meshes, unsigned int threadCount = 0,
+    std::ostream& log = std::cout)
+{
+    MappedFile file;
+    if(!file.Open(path))
+    {
+        return false;
+    }
+    const char* data = file.Data();
+    size_t size = file.Size();
+
+    // split at line boundaries and parse
+    // ----------------------------------
+    if(threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, size / OBJ_MIN_CHUNK_BYTES));
+    std::vector<size_t> bounds(chunkCount + 1, size);
+    bounds[0] = 0;
+    for(size_t i = 1; i < chunkCount; ++i)
+    {
+        size_t cut = std::max(bounds[i - 1], size / chunkCount * i);
+        bounds[i] = SkipObjLine(data + cut, data + size) - data;
+    }
+    std::vector<ObjChunk> chunks(chunkCount);
+    {
+        std::vector<std::thread> workers;
+        for(size_t i = 1; i < chunkCount; ++i)
+        {
+            workers.emplace_back(ParseObjChunk, data + bounds[i], data + bounds[i + 1], std::ref(chunks[i]));
+        }
+        ParseObjChunk(data + bounds[0], data + bounds[1], chunks[0]);
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+    file.Close();
+
+    // merge the vertex streams and make every index global
+    // -------------------------------------------------------
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+    for(const ObjChunk& chunk : chunks)
+    {
+        if(chunk.failed)
+        {
+            log << "ERROR::OBJ:: unsupported face in " << path << std::endl;
+            return false;
+        }
+        positionCount += chunk.positions.size();
+        uvCount += chunk.uvs.size();
+        normalCount += chunk.normals.size();
+        cornerCount += chunk.corners.size();
+    }
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<ObjCorner> corners;
+    std::vector<size_t> chunkTriangles;
+    positions.reserve(positionCount);
+    uvs.reserve(uvCount);
+    normals.reserve(normalCount);
+    corners.reserve(cornerCount);
+    for(ObjChunk& chunk : chunks)
+    {
+        int offsets[3] = { (int)positions.size(), (int)uvs.size(), (int)normals.size() };
+        for(size_t component : chunk.relative)
+        {
+            int* index = &chunk.corners[component / 3].position + component % 3;
+            *index += offsets[component % 3];
+        }
+        chunkTriangles.push_back(chunk.corners.size() / 3);
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        corners.insert(corners.end(), chunk.corners.begin(), chunk.corners.end());
+        std::vector<glm::vec3>().swap(chunk.positions);
+        std::vector<glm::vec2>().swap(chunk.uvs);
+        std::vector<glm::vec3>().swap(chunk.normals);
+        std::vector<ObjCorner>().swap(chunk.corners);
+    }
+    for(const ObjCorner& corner : corners)
+    {
+        if(corner.position < 0 || corner.position >= (int)positionCount || corner.uv < -1 || corner.uv >= (int)uvCount
+            || corner.normal < -1 || corner.normal >= (int)normalCount)
+        {
+            log << "ERROR::OBJ:: face index out of range in " << path << std::endl;
+            return false;
+        }
+    }
+
+    // materials, faces before the first usemtl get an unnamed one
+    // -------------------------------------------------------------
+    size_t triangleCount = corners.size() / 3;
+    std::vector<std::string> materialNames(1, "");
+    std::map<std::string, int> materialByName = { { "", 0 } };
+    std::vector<int> triangleMaterials(triangleCount);
+    std::map<std::string, std::string> diffuseMaps;
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    {
+        int current = 0;
+        size_t offset = 0;
+        for(size_t c = 0; c < chunks.size(); ++c)
+        {
+            size_t start = offset;
+            for(const auto& run : chunks[c].materials)
+            {
+                std::fill(triangleMaterials.begin() + start, triangleMaterials.begin() + offset + run.first, current);
+                auto found = materialByName.find(run.second);
+                if(found == materialByName.end())
+                {
+                    found = materialByName.insert({ run.second, (int)materialNames.size() }).first;
+                    materialNames.push_back(run.second);
+                }
+                current = found->second;
+                start = offset + run.first;
+            }
+            offset += chunkTriangles[c];
+            std::fill(triangleMaterials.begin() + start, triangleMaterials.begin() + offset, current);
+            for(const std::string& library : chunks[c].libraries)
+            {
+                ParseObjMaterialLibrary(directory + "/" + library, directory, diffuseMaps);
+            }
+        }
+    }
+    // triangles sorted by material, stable so every mesh keeps the file order
+    std::vector<size_t> materialStart(materialNames.size() + 1, 0);
+    for(int material : triangleMaterials)
+    {
+        ++materialStart[material + 1];
+    }
+    for(size_t m = 1; m < materialStart.size(); ++m)
+    {
+        materialStart[m] += materialStart[m - 1];
+    }
+    std::vector<unsigned int> triangleOrder(triangleCount);
+    {
+        std::vector<size_t> cursor(materialStart.begin(), materialStart.end() - 1);
+        for(size_t t = 0; t < triangleCount; ++t)
+        {
+            triangleOrder[cursor[triangleMaterials[t]]++] = (unsigned int)t;
+        }
+    }
+    std::vector<int>().swap(triangleMaterials);
+
+    // one mesh per material
+    // ---------------------
+    // corners that use the same index for every stream (f 1 2 3, f 1//1 ...) share vertices through
+    // a flat table over the positions, anything else goes through a hash of the whole corner
+    struct CornerHash
+    {
+        size_t operator()(const ObjCorner& c) const
+        {
+            return ((size_t)(unsigned)c.position * 73856093u) ^ ((size_t)(unsigned)c.uv * 19349663u) ^ ((size_t)(unsigned)c.normal * 83492791u);
+        }
+    };
+    struct CornerEqual
+    {
+        bool operator()(const ObjCorner& a, const ObjCorner& b) const
+        {
+            return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+        }
+    };
+    std::vector<int> vertexByPosition(positionCount, -1);
+    std::vector<glm::vec3> smoothNormals;
+    for(size_t m = 0; m < materialNames.size(); ++m)
+    {
+        if(materialStart[m] == materialStart[m + 1])
+        {
+            continue;
+        }
+        bool sharedIndices = true;
+        bool missingNormals = false;
+        for(size_t i = materialStart[m]; i < materialStart[m + 1]; ++i)
+        {
+            for(int k = 0; k < 3; ++k)
+            {
+                const ObjCorner& corner = corners[triangleOrder[i] * 3 + k];
+                sharedIndices = sharedIndices && (corner.uv < 0 || corner.uv == corner.position)
+                    && (corner.normal < 0 || corner.normal == corner.position);
+                missingNormals = missingNormals || corner.normal < 0;
+            }
+        }
+        TriangleMesh mesh;
+        std::vector<int> vertexPositions;
+        std::unordered_map<ObjCorner, unsigned int, CornerHash, CornerEqual> vertexByCorner;
+        mesh.indices.reserve((materialStart[m + 1] - materialStart[m]) * 3);
+        for(size_t i = materialStart[m]; i < materialStart[m + 1]; ++i)
+        {
+            for(int k = 0; k < 3; ++k)
+            {
+                const ObjCorner& corner = corners[triangleOrder[i] * 3 + k];
+                unsigned int vertex = (unsigned int)mesh.positions.size();
+                bool added;
+                if(sharedIndices)
+                {
+                    int& slot = vertexByPosition[corner.position];
+                    added = slot < 0;
+                    if(added)
+                    {
+                        slot = (int)vertex;
+                    }
+                    vertex = (unsigned int)slot;
+                }
+                else
+                {
+                    auto inserted = vertexByCorner.insert({ corner, vertex });
+                    added = inserted.second;
+                    vertex = inserted.first->second;
+                }
+                if(added)
+                {
+                    mesh.positions.push_back(positions[corner.position]);
+                    mesh.uvs.push_back(corner.uv < 0 ? glm::vec2(0.0f) : uvs[corner.uv]);
+                    mesh.normals.push_back(corner.normal < 0 ? glm::vec3(0.0f) : normals[corner.normal]);
+                    vertexPositions.push_back(corner.position);
+                }
+                mesh.indices.push_back(vertex);
+            }
+        }
+        // area weighted face normals summed per position, so split uv seams still shade smoothly
+        if(missingNormals)
+        {
+            smoothNormals.resize(positionCount, glm::vec3(0.0f));
+            for(size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+            {
+                int p0 = vertexPositions[mesh.indices[t]];
+                int p1 = vertexPositions[mesh.indices[t + 1]];
+                int p2 = vertexPositions[mesh.indices[t + 2]];
+                glm::vec3 faceNormal = glm::cross(positions[p1] - positions[p0], positions[p2] - positions[p0]);
+                smoothNormals[p0] += faceNormal;
+                smoothNormals[p1] += faceNormal;
+                smoothNormals[p2] += faceNormal;
+            }
+            for(size_t v = 0; v < mesh.positions.size(); ++v)
+            {
+                float length = glm::length(smoothNormals[vertexPositions[v]]);
+                if(mesh.normals[v] == glm::vec3(0.0f) && length > 0.0f)
+                {
+                    mesh.normals[v] = smoothNormals[vertexPositions[v]] / length;
+                }
+            }
+        }
+        // clear only what this mesh touched so the tables stay O(positions) for the whole file
+        for(int position : vertexPositions)
+        {
+            vertexByPosition[position] = -1;
+            if(missingNormals)
+            {
+                smoothNormals[position] = glm::vec3(0.0f);
+            }
+        }
+        auto diffuse = diffuseMaps.find(materialNames[m]);
+        if(diffuse != diffuseMaps.end())
+        {
+            mesh.diffusePath = diffuse->second;
+        }
+        meshes.push_back(std::move(mesh));
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef RAY_TRACING_PRIMITIVE_STORAGE_H_
+#define RAY_TRACING_PRIMITIVE_STORAGE_H_
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "hittable_list.h"
+#include "material_pool.h"
+
+extern const int OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT;
+
+// bump allocator: memory is handed out from big blocks and only released all at once,
+// so millions of small primitives cost a handful of allocations and no per object headers
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 1 << 20):
+    blockSize(blockSize), offset(0), capacity(0), bytesUsed(0), bytesReserved(0)
+    {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // alignment up to alignof(std::max_align_t), which new[] guarantees for every block
+    void* Allocate(size_t bytes, size_t alignment)
+    {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if(blocks.empty() || start + bytes > capacity)
+        {
+            capacity = std::max(blockSize, bytes);
+            blocks.emplace_back(new char[capacity]);
+            bytesReserved += capacity;
+            start = 0;
+        }
+        offset = start + bytes;
+        bytesUsed += bytes;
+        return blocks.back().get() + start;
+    }
+
+    // bytes handed out, including arrays that have since grown elsewhere
+    size_t BytesUsed() const { return bytesUsed; }
+    size_t BytesReserved() const { return bytesReserved; }
+
+private:
+    size_t blockSize;
+    size_t offset;
+    size_t capacity;
+    size_t bytesUsed;
+    size_t bytesReserved;
+    std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+// growable array of plain data living in an arena. growing copies into a new arena range and
+// leaves the old one behind, reserve up front when the count is known
+template <typename T>
+class ArenaArray
+{
+    static_assert(std::is_trivially_copyable<T>::value, "arena arrays hold plain data only");
+public:
+    explicit ArenaArray(Arena& arena): arena(&arena), data(nullptr), size(0), capacity(0)
+    {
+    }
+
+    void reserve(size_t count)
+    {
+        if(count <= capacity)
+        {
+            return;
+        }
+        T* grown = static_cast<T*>(arena->Allocate(count * sizeof(T), alignof(T)));
+        if(size > 0)
+        {
+            std::memcpy(grown, data, size * sizeof(T));
+        }
+        data = grown;
+        capacity = count;
+    }
+
+    void push_back(const T& value)
+    {
+        if(size == capacity)
+        {
+            reserve(std::max<size_t>(64, capacity * 2));
+        }
+        data[size++] = value;
+    }
+
+    T& operator[](size_t i) { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+    size_t Size() const { return size; }
+
+private:
+    Arena* arena;
+    T* data;
+    size_t size;
+    size_t capacity;
+};
+
+enum class PrimitiveType : uint32_t
+{
+    Sphere, XYRect, XZRect, YZRect, Triangle
+};
+
+// type in the top 3 bits, index into that type's pool below. primitives are never removed,
+// so a handle stays valid for the life of the storage
+struct PrimitiveHandle
+{
+    static const uint32_t INDEX_BITS = 29;
+
+    PrimitiveHandle(PrimitiveType type, uint32_t index):
+    value(((uint32_t)type << INDEX_BITS) | index)
+    {
+    }
+
+    PrimitiveType Type() const { return (PrimitiveType)(value >> INDEX_BITS); }
+    uint32_t Index() const { return value & ((1u << INDEX_BITS) - 1); }
+
+    uint32_t value;
+};
+
+struct SpherePool
+{
+    explicit SpherePool(Arena& arena): centers(arena), radii(arena), materials(arena) {}
+    size_t Size() const { return centers.Size(); }
+
+    ArenaArray<glm::vec3> centers;
+    ArenaArray<float> radii;
+    ArenaArray<uint16_t> materials;
+};
+
+// one pool per rect orientation: a and b are the in-plane ranges (x/y, x/z or y/z),
+// k the position along the third axis
+struct RectPool
+{
+    explicit RectPool(Arena& arena): a0(arena), a1(arena), b0(arena), b1(arena), k(arena), materials(arena) {}
+    size_t Size() const { return k.Size(); }
+
+    ArenaArray<float> a0, a1, b0, b1, k;
+    ArenaArray<uint16_t> materials;
+};
+
+struct TrianglePool
+{
+    explicit TrianglePool(Arena& arena): p0(arena), p1(arena), p2(arena), materials(arena) {}
+    size_t Size() const { return p0.Size(); }
+
+    ArenaArray<glm::vec3> p0, p1, p2;
+    ArenaArray<uint16_t> materials;
+};
+
+// the scene as one structure of arrays per primitive type instead of a list of shared_ptrs to
+// fat Hittables: a sphere costs 18 bytes, there is no vtable, no refcount and no per object
+// allocation. materials are MaterialPool indices
+class SceneStorage
+{
+public:
+    explicit SceneStorage(size_t arenaBlockSize = 1 << 20):
+    arena(arenaBlockSize), spheres(arena), xyRects(arena), xzRects(arena), yzRects(arena), triangles(arena)
+    {
+    }
+
+    PrimitiveHandle AddSphere(const glm::vec3& center, float radius, uint16_t material)
+    {
+        spheres.centers.push_back(center);
+        spheres.radii.push_back(radius);
+        spheres.materials.push_back(material);
+        return PrimitiveHandle(PrimitiveType::Sphere, (uint32_t)spheres.Size() - 1);
+    }
+
+    PrimitiveHandle AddXYRect(float x0, float x1, float y0, float y1, float k, uint16_t material)
+    {
+        return AddRect(xyRects, PrimitiveType::XYRect, x0, x1, y0, y1, k, material);
+    }
+
+    PrimitiveHandle AddXZRect(float x0, float x1, float z0, float z1, float k, uint16_t material)
+    {
+        return AddRect(xzRects, PrimitiveType::XZRect, x0, x1, z0, z1, k, material);
+    }
+
+    PrimitiveHandle AddYZRect(float y0, float y1, float z0, float z1, float k, uint16_t material)
+    {
+        return AddRect(yzRects, PrimitiveType::YZRect, y0, y1, z0, z1, k, material);
+    }
+
+    PrimitiveHandle AddTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, uint16_t material)
+    {
+        triangles.p0.push_back(p0);
+        triangles.p1.push_back(p1);
+        triangles.p2.push_back(p2);
+        triangles.materials.push_back(material);
+        return PrimitiveHandle(PrimitiveType::Triangle, (uint32_t)triangles.Size() - 1);
+    }
+
+    void ReserveSpheres(size_t count)
+    {
+        spheres.centers.reserve(count);
+        spheres.radii.reserve(count);
+        spheres.materials.reserve(count);
+    }
+
+    // copies a HittableList in, interning its materials. returns the handles in list order
+    std::vector<PrimitiveHandle> Add(HittableList& objects, MaterialPool& materials)
+    {
+        std::vector<PrimitiveHandle> handles;
+        handles.reserve(objects.size());
+        for(const auto& object : objects)
+        {
+            uint16_t material = object->matPtr ? materials.Intern(*object->matPtr) : 0;
+            if(object->objectType == OBJ_SPHERE)
+                handles.push_back(AddSphere(object->center, object->radius, material));
+            else if(object->objectType == OBJ_XYRECT)
+                handles.push_back(AddXYRect(object->x0, object->x1, object->y0, object->y1, object->k, material));
+            else if(object->objectType == OBJ_XZRECT)
+                handles.push_back(AddXZRect(object->x0, object->x1, object->z0, object->z1, object->k, material));
+            else if(object->objectType == OBJ_YZRECT)
+                handles.push_back(AddYZRect(object->y0, object->y1, object->z0, object->z1, object->k, material));
+        }
+        return handles;
+    }
+
+    AABB Bounds(PrimitiveHandle handle) const
+    {
+        uint32_t i = handle.Index();
+        switch(handle.Type())
+        {
+            case PrimitiveType::Sphere:
+            {
+                glm::vec3 r(spheres.radii[i]);
+                return AABB(spheres.centers[i] - r, spheres.centers[i] + r);
+            }
+            case PrimitiveType::XYRect:
+                return AABB(point3(xyRects.a0[i], xyRects.b0[i], xyRects.k[i] - 0.0001f),
+                    point3(xyRects.a1[i], xyRects.b1[i], xyRects.k[i] + 0.0001f));
+            case PrimitiveType::XZRect:
+                return AABB(point3(xzRects.a0[i], xzRects.k[i] - 0.0001f, xzRects.b0[i]),
+                    point3(xzRects.a1[i], xzRects.k[i] + 0.0001f, xzRects.b1[i]));
+            case PrimitiveType::YZRect:
+                return AABB(point3(yzRects.k[i] - 0.0001f, yzRects.a0[i], yzRects.b0[i]),
+                    point3(yzRects.k[i] + 0.0001f, yzRects.a1[i], yzRects.b1[i]));
+            case PrimitiveType::Triangle:
+                return AABB(glm::min(triangles.p0[i], glm::min(triangles.p1[i], triangles.p2[i])),
+                    glm::max(triangles.p0[i], glm::max(triangles.p1[i], triangles.p2[i])));
+        }
+        return AABB(point3(0.0f), point3(0.0f));
+    }
+
+    // bounds of everything, spheres are read as straight arrays
+    AABB Bounds() const
+    {
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for(size_t i = 0; i < spheres.Size(); ++i)
+        {
+            lo = glm::min(lo, spheres.centers[i] - spheres.radii[i]);
+            hi = glm::max(hi, spheres.centers[i] + spheres.radii[i]);
+        }
+        const RectPool* rects[] = { &xyRects, &xzRects, &yzRects };
+        const PrimitiveType types[] = { PrimitiveType::XYRect, PrimitiveType::XZRect, PrimitiveType::YZRect };
+        for(int r = 0; r < 3; ++r)
+        {
+            for(size_t i = 0; i < rects[r]->Size(); ++i)
+            {
+                AABB box = Bounds(PrimitiveHandle(types[r], (uint32_t)i));
+                lo = glm::min(lo, box.minimum);
+                hi = glm::max(hi, box.maximum);
+            }
+        }
+        for(size_t i = 0; i < triangles.Size(); ++i)
+        {
+            AABB box = Bounds(PrimitiveHandle(PrimitiveType::Triangle, (uint32_t)i));
+            lo = glm::min(lo, box.minimum);
+            hi = glm::max(hi, box.maximum);
+        }
+        return AABB(lo, hi);
+    }
+
+    // writes spheres and rects in order into the objects buffer layout of WriteObjectsData,
+    // two texels each. triangles live in their own buffer, their slots are zeroed
+    void Pack(const std::vector<PrimitiveHandle>& order, float (*texels)[4]) const
+    {
+        for(size_t n = 0; n < order.size(); ++n)
+        {
+            float* bounds = texels[n * 2];
+            float* extra = texels[n * 2 + 1];
+            uint32_t i = order[n].Index();
+            const RectPool* rects = nullptr;
+            switch(order[n].Type())
+            {
+                case PrimitiveType::Sphere:
+                    bounds[0] = spheres.centers[i].x;
+                    bounds[1] = spheres.centers[i].y;
+                    bounds[2] = spheres.centers[i].z;
+                    bounds[3] = spheres.radii[i];
+                    extra[0] = spheres.materials[i];
+                    extra[1] = 0.0f;
+                break;
+                case PrimitiveType::XYRect: rects = &xyRects; break;
+                case PrimitiveType::XZRect: rects = &xzRects; break;
+                case PrimitiveType::YZRect: rects = &yzRects; break;
+                case PrimitiveType::Triangle:
+                    std::fill(bounds, bounds + 4, 0.0f);
+                    extra[0] = 0.0f;
+                    extra[1] = 0.0f;
+                break;
+            }
+            if(rects)
+            {
+                bounds[0] = rects->a0[i];
+                bounds[1] = rects->a1[i];
+                bounds[2] = rects->b0[i];
+                bounds[3] = rects->b1[i];
+                extra[0] = rects->materials[i];
+                extra[1] = rects->k[i];
+            }
+            extra[2] = 0.0f;
+            extra[3] = 0.0f;
+        }
+    }
+
+    int ObjectType(PrimitiveHandle handle) const
+    {
+        switch(handle.Type())
+        {
+            case PrimitiveType::Sphere: return OBJ_SPHERE;
+            case PrimitiveType::XYRect: return OBJ_XYRECT;
+            case PrimitiveType::XZRect: return OBJ_XZRECT;
+            case PrimitiveType::YZRect: return OBJ_YZRECT;
+            default: return -1;
+        }
+    }
+
+    size_t Size() const
+    {
+        return spheres.Size() + xyRects.Size() + xzRects.Size() + yzRects.Size() + triangles.Size();
+    }
+
+    Arena arena;
+    SpherePool spheres;
+    RectPool xyRects, xzRects, yzRects;
+    TrianglePool triangles;
+
+private:
+    PrimitiveHandle AddRect(RectPool& pool, PrimitiveType type, float a0, float a1, float b0, float b1, float k,
+        uint16_t material)
+    {
+        pool.a0.push_back(a0);
+        pool.a1.push_back(a1);
+        pool.b0.push_back(b0);
+        pool.b1.push_back(b1);
+        pool.k.push_back(k);
+        pool.materials.push_back(material);
+        return PrimitiveHandle(type, (uint32_t)pool.Size() - 1);
+    }
+};
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef RAY_TRACING_PROFILER_H_
+#define RAY_TRACING_PROFILER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <utility>
+
+#include <glad/glad.h>
+
+// cpu and gpu time per named phase. cpu phases are timed with a steady clock, gpu phases
+// with a pair of GL_TIMESTAMP queries that is read back a few frames later, so collecting
+// them never stalls the pipeline. queries come from a pool that is refilled as frames retire.
+// every range is also kept as an event for WriteChromeTrace, gpu ranges on their own track
+// shifted onto the cpu clock, so the file opens in chrome://tracing or perfetto.
+class Profiler
+{
+public:
+    Profiler(): smoothing(0.1f), overlayScaleMs(33.3f), frameStart(0.0), frameRays(0.0),
+    raysPerSecond(0.0), frameCount(0)
+    {
+        origin = std::chrono::steady_clock::now();
+        // sample both clocks once to line the gpu ranges up with the cpu ones
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuOffsetUs = NowUs() - gpuNow * 1e-3;
+        for(int i = 0; i < FRAME_HISTORY; ++i)
+        {
+            frameTimes[i] = 0.0f;
+        }
+    }
+
+    ~Profiler()
+    {
+        inFlight.push_back(currentGpu);
+        for(auto& frame : inFlight)
+        {
+            for(auto& range : frame)
+            {
+                freeQueries.push_back(range.begin);
+                freeQueries.push_back(range.end);
+            }
+        }
+        if(!freeQueries.empty())
+        {
+            glDeleteQueries(freeQueries.size(), freeQueries.data());
+        }
+    }
+
+    // microseconds since the profiler was created
+    double NowUs() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void BeginFrame()
+    {
+        Collect(false);
+        frameStart = NowUs();
+        frameRays = 0.0;
+    }
+
+    void EndFrame()
+    {
+        double end = NowUs();
+        float ms = (float)((end - frameStart) * 1e-3);
+        frameTimes[frameCount % FRAME_HISTORY] = ms;
+        ++frameCount;
+        AddEvent("frame", CPU_TRACK, frameStart, end);
+        if(ms > 0.0f)
+        {
+            double rate = frameRays / (ms * 1e-3);
+            raysPerSecond = raysPerSecond == 0.0 ? rate : raysPerSecond + smoothing * (rate - raysPerSecond);
+        }
+        inFlight.push_back(currentGpu);
+        currentGpu.clear();
+    }
+
+    // rays traced in this frame
+    void AddRays(double rays)
+    {
+        frameRays += rays;
+    }
+
+    void BeginCpu(const std::string& name)
+    {
+        openCpu.push_back(OpenRange{ name, NowUs() });
+    }
+
+    void EndCpu()
+    {
+        OpenRange range = openCpu.back();
+        openCpu.pop_back();
+        double end = NowUs();
+        Record(range.name, false, (float)((end - range.start) * 1e-3));
+        AddEvent(range.name, CPU_TRACK, range.start, end);
+    }
+
+    void BeginGpu(const std::string& name)
+    {
+        GpuRange range{ name, Acquire(), Acquire() };
+        glQueryCounter(range.begin, GL_TIMESTAMP);
+        openGpu.push_back(currentGpu.size());
+        currentGpu.push_back(range);
+    }
+
+    void EndGpu()
+    {
+        glQueryCounter(currentGpu[openGpu.back()].end, GL_TIMESTAMP);
+        openGpu.pop_back();
+    }
+
+    // smoothed time of a phase, negative when it has not been measured on that side
+    float CpuMs(const std::string& name) const
+    {
+        const Phase* phase = Find(name);
+        return phase && phase->cpuSamples > 0 ? phase->cpuMs : -1.0f;
+    }
+    float GpuMs(const std::string& name) const
+    {
+        const Phase* phase = Find(name);
+        return phase && phase->gpuSamples > 0 ? phase->gpuMs : -1.0f;
+    }
+
+    // frame time percentile over the recent history, p in [0, 100]
+    float FramePercentile(float p) const
+    {
+        int count = std::min(frameCount, FRAME_HISTORY);
+        if(count == 0)
+        {
+            return 0.0f;
+        }
+        std::vector<float> sorted(frameTimes, frameTimes + count);
+        int k = std::min(count - 1, (int)(p / 100.0f * count));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+
+    double RaysPerSecond() const { return raysPerSecond; }
+
+    // one line for the window title: gpu phases, frame percentiles and ray rate
+    std::string Summary() const
+    {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        for(const Phase& phase : phases)
+        {
+            if(phase.gpuSamples > 0)
+            {
+                out << phase.name << " " << phase.gpuMs << " | ";
+            }
+        }
+        out << "frame p50 " << FramePercentile(50.0f) << " p95 " << FramePercentile(95.0f)
+            << " p99 " << FramePercentile(99.0f) << " ms";
+        if(raysPerSecond > 0.0)
+        {
+            out << " | " << std::setprecision(2) << raysPerSecond * 1e-6 << " Mrays/s";
+        }
+        return out.str();
+    }
+
+    // every phase seen so far with its cpu and gpu time
+    void Report(std::ostream& out) const
+    {
+        for(const Phase& phase : phases)
+        {
+            out << "  " << std::left << std::setw(16) << phase.name << std::right;
+            if(phase.cpuSamples > 0)
+            {
+                out << " cpu " << std::setw(9) << std::fixed << std::setprecision(3) << phase.cpuMs << " ms";
+            }
+            if(phase.gpuSamples > 0)
+            {
+                out << " gpu " << std::setw(9) << std::fixed << std::setprecision(3) << phase.gpuMs << " ms";
+            }
+            out << "\n";
+        }
+        out << "  frame p50 " << FramePercentile(50.0f) << " p95 " << FramePercentile(95.0f)
+            << " p99 " << FramePercentile(99.0f) << " ms, " << raysPerSecond * 1e-6 << " Mrays/s" << std::endl;
+    }
+
+    // one bar per gpu phase in the top left corner of the bound framebuffer, full length
+    // is overlayScaleMs. drawn with scissored clears, so no shader or geometry is needed
+    void DrawOverlay(int width, int height) const
+    {
+        static const float palette[][3] = {
+            { 0.90f, 0.30f, 0.25f }, { 0.25f, 0.70f, 0.35f }, { 0.25f, 0.45f, 0.90f },
+            { 0.95f, 0.75f, 0.20f }, { 0.70f, 0.35f, 0.85f }, { 0.20f, 0.80f, 0.80f }
+        };
+        const int barHeight = 6, gap = 2, margin = 8;
+        int maxLength = width / 3;
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        glEnable(GL_SCISSOR_TEST);
+        int row = 0;
+        for(const Phase& phase : phases)
+        {
+            if(phase.gpuSamples == 0)
+            {
+                continue;
+            }
+            const float* color = palette[row % 6];
+            int length = std::max(1, std::min(maxLength, (int)(phase.gpuMs / overlayScaleMs * maxLength)));
+            int y = height - margin - (row + 1) * (barHeight + gap);
+            glScissor(margin, y, maxLength, barHeight);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glScissor(margin, y, length, barHeight);
+            glClearColor(color[0], color[1], color[2], 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ++row;
+        }
+        // 95th percentile frame time in white below the phases
+        int y = height - margin - (row + 1) * (barHeight + gap);
+        int length = std::max(1, std::min(maxLength, (int)(FramePercentile(95.0f) / overlayScaleMs * maxLength)));
+        glScissor(margin, y, length, barHeight);
+        glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    }
+
+    // waits for the outstanding queries and writes every recorded range as trace events
+    bool WriteChromeTrace(const std::string& path)
+    {
+        Collect(true);
+        std::ofstream file(path);
+        if(!file)
+        {
+            std::cout << "Failed to write trace " << path << std::endl;
+            return false;
+        }
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CPU_TRACK << ",\"args\":{\"name\":\"cpu\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"gpu\"}}";
+        file << std::fixed << std::setprecision(3);
+        for(const Event& event : events)
+        {
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.track == GPU_TRACK ? "gpu" : "cpu")
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+                << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+        }
+        file << "\n]}\n";
+        return true;
+    }
+
+    // weight of a new sample in the smoothed phase times
+    float smoothing;
+    // frame time a full overlay bar stands for
+    float overlayScaleMs;
+
+private:
+    static const int FRAME_HISTORY = 512;
+    // frames a gpu query may stay in flight before its result is waited for
+    static const int FRAME_LATENCY = 3;
+    static const int CPU_TRACK = 1;
+    static const int GPU_TRACK = 2;
+    // the trace stops growing here, about 10 MB of json
+    static const size_t MAX_EVENTS = 200000;
+
+    struct Phase
+    {
+        std::string name;
+        float cpuMs, gpuMs;
+        int cpuSamples, gpuSamples;
+    };
+    struct OpenRange
+    {
+        std::string name;
+        double start;
+    };
+    struct GpuRange
+    {
+        std::string name;
+        unsigned int begin, end;
+    };
+    struct Event
+    {
+        std::string name;
+        int track;
+        double start, duration;
+    };
+
+    int FindIndex(const std::string& name) const
+    {
+        for(size_t i = 0; i < phases.size(); ++i)
+        {
+            if(phases[i].name == name)
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    const Phase* Find(const std::string& name) const
+    {
+        int index = FindIndex(name);
+        return index == -1 ? nullptr : &phases[index];
+    }
+
+    void Record(const std::string& name, bool gpu, float ms)
+    {
+        int index = FindIndex(name);
+        if(index == -1)
+        {
+            index = (int)phases.size();
+            phases.push_back(Phase{ name, 0.0f, 0.0f, 0, 0 });
+        }
+        Phase& phase = phases[index];
+        float& value = gpu ? phase.gpuMs : phase.cpuMs;
+        int& samples = gpu ? phase.gpuSamples : phase.cpuSamples;
+        value = samples == 0 ? ms : value + smoothing * (ms - value);
+        ++samples;
+    }
+
+    void AddEvent(const std::string& name, int track, double start, double end)
+    {
+        if(events.size() < MAX_EVENTS)
+        {
+            events.push_back(Event{ name, track, start, end - start });
+        }
+    }
+
+    unsigned int Acquire()
+    {
+        if(freeQueries.empty())
+        {
+            unsigned int batch[16];
+            glGenQueries(16, batch);
+            freeQueries.insert(freeQueries.end(), batch, batch + 16);
+        }
+        unsigned int query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+
+    // reads the oldest frames whose queries are done, or all of them when asked to wait
+    void Collect(bool wait)
+    {
+        while(!inFlight.empty())
+        {
+            std::vector<GpuRange>& frame = inFlight.front();
+            if(!wait && (int)inFlight.size() <= FRAME_LATENCY && !frame.empty())
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(frame.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+                if(!available)
+                {
+                    break;
+                }
+            }
+            // a phase that runs several times in a frame is recorded as its sum
+            std::vector<std::pair<std::string, float>> sums;
+            for(const GpuRange& range : frame)
+            {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(range.begin, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(range.end, GL_QUERY_RESULT, &end);
+                float ms = (float)((end - begin) * 1e-6);
+                auto sum = std::find_if(sums.begin(), sums.end(),
+                    [&range](const std::pair<std::string, float>& s) { return s.first == range.name; });
+                if(sum == sums.end())
+                {
+                    sums.push_back(std::make_pair(range.name, ms));
+                }
+                else
+                {
+                    sum->second += ms;
+                }
+                AddEvent(range.name, GPU_TRACK, begin * 1e-3 + gpuOffsetUs, end * 1e-3 + gpuOffsetUs);
+                freeQueries.push_back(range.begin);
+                freeQueries.push_back(range.end);
+            }
+            for(const auto& sum : sums)
+            {
+                Record(sum.first, true, sum.second);
+            }
+            inFlight.pop_front();
+        }
+    }
+
+    std::chrono::steady_clock::time_point origin;
+    double gpuOffsetUs;
+    double frameStart;
+    double frameRays;
+    double raysPerSecond;
+    float frameTimes[FRAME_HISTORY];
+    int frameCount;
+    std::vector<Phase> phases;
+    std::vector<OpenRange> openCpu;
+    std::vector<size_t> openGpu;
+    std::vector<GpuRange> currentGpu;
+    std::deque<std::vector<GpuRange>> inFlight;
+    std::vector<unsigned int> freeQueries;
+    std::vector<Event> events;
+};
+
+// times the enclosing block on the cpu
+class CpuProfileScope
+{
+public:
+    CpuProfileScope(Profiler& profiler, const std::string& name) : profiler(profiler)
+    {
+        profiler.BeginCpu(name);
+    }
+    ~CpuProfileScope()
+    {
+        profiler.EndCpu();
+    }
+
+private:
+    Profiler& profiler;
+};
+
+// times the gl commands issued in the enclosing block on the gpu
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(Profiler& profiler, const std::string& name) : profiler(profiler)
+    {
+        profiler.BeginGpu(name);
+    }
+    ~GpuProfileScope()
+    {
+        profiler.EndGpu();
+    }
+
+private:
+    Profiler& profiler;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef RAY_TRACING_RENDER_TARGET_H_
+#define RAY_TRACING_RENDER_TARGET_H_
+
+#include <vector>
+#include <iostream>
+
+#include <glad/glad.h>
+
+// framebuffer with a set of RGBA32F color attachments of the same size
+class RenderTarget
+{
+public:
+    RenderTarget() : FBO(0), width(0), height(0) {}
+
+    void Create(int w, int h, int attachmentCount)
+    {
+        width = w;
+        height = h;
+        textures.resize(attachmentCount);
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glGenTextures(attachmentCount, textures.data());
+        std::vector<GLenum> drawBuffers;
+        for(int i = 0; i < attachmentCount; ++i)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        glDrawBuffers(attachmentCount, drawBuffers.data());
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::FRAMEBUFFER:: Render target is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void Release()
+    {
+        if(FBO != 0)
+        {
+            glDeleteFramebuffers(1, &FBO);
+            glDeleteTextures(textures.size(), textures.data());
+            FBO = 0;
+        }
+    }
+
+    void Bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+    }
+
+    unsigned int FBO;
+    std::vector<unsigned int> textures;
+    int width, height;
+};
+
+#endif
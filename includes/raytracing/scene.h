@@ -9,10 +9,13 @@
 extern const int MAT_LAMBERTIAN, MAT_METALLIC, MAT_DIELECTRIC;
 extern const int OBJ_MODEL;
 
+// one generator per thread, so scenes built on several threads at once do not race on it.
+// the thread that builds RandomScene gets the same sequence as before. for scenes that have to
+// come out the same on any number of threads see scene_generator.h
 inline double RandomNumber()
 {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
+    thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    thread_local std::mt19937 generator;
     return distribution(generator);
 }
 
@@ -33,7 +36,7 @@ vec3 RandomVec3()
 
 void Scene1(HittableList& objects, AABB aabbModel)
 {
-    shared_ptr<Sphere> model = std::make_shared<Sphere>(Sphere(Sphere(vec3(0.0, -101.5, -1.0), 100.0, 
+    std::shared_ptr<Sphere> model = std::make_shared<Sphere>(Sphere(Sphere(vec3(0.0, -101.5, -1.0), 100.0, 
     std::make_shared<Material>(Material(vec3(0.1, 0.7, 0.6), MAT_LAMBERTIAN)))));
     model->box = aabbModel;
     model->objectType = OBJ_MODEL;
@@ -109,7 +112,7 @@ void CornellBox(HittableList& objects)
 
 void DisplayScene(HittableList& objects, AABB aabbModel)
 {
-    shared_ptr<Sphere> model = std::make_shared<Sphere>(Sphere(Sphere(vec3(0.0, -101.5, -1.0), 100.0, 
+    std::shared_ptr<Sphere> model = std::make_shared<Sphere>(Sphere(Sphere(vec3(0.0, -101.5, -1.0), 100.0, 
     std::make_shared<Material>(Material(vec3(0.1, 0.7, 0.6), MAT_LAMBERTIAN)))));
     model->box = aabbModel;
     model->objectType = OBJ_MODEL;
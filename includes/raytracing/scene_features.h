@@ -0,0 +1,79 @@
+#ifndef RAY_TRACING_SCENE_FEATURES_H_
+#define RAY_TRACING_SCENE_FEATURES_H_
+
+#include <string>
+
+#include "hittable_list.h"
+
+extern const int MAT_LAMBERTIAN, MAT_METALLIC, MAT_DIELECTRIC;
+extern const int OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT, OBJ_MODEL;
+
+// what a scene actually uses, turned into #define lines for the tracer shader so a
+// specialized program drops the object types and materials the scene does not have
+// and runs its sample, bounce and traversal loops with fixed bounds.
+class SceneFeatures
+{
+public:
+    SceneFeatures(HittableList& objects, int samplesPerPixel, int maxDepth, int stackSize):
+    objectTypes(0), materialTypes(0),
+    samplesPerPixel(samplesPerPixel), maxDepth(maxDepth), stackSize(stackSize)
+    {
+        for(auto& object : objects)
+        {
+            objectTypes |= 1u << object->objectType;
+            if(object->objectType == OBJ_MODEL)
+            {
+                // the shader gives model triangles a fixed dielectric material
+                materialTypes |= 1u << MAT_DIELECTRIC;
+            }
+            else if(object->matPtr)
+            {
+                materialTypes |= 1u << object->matPtr->materialType;
+            }
+        }
+    }
+
+    bool HasObject(int objectType) const
+    {
+        return (objectTypes >> objectType) & 1u;
+    }
+    bool HasMaterial(int materialType) const
+    {
+        return (materialTypes >> materialType) & 1u;
+    }
+
+    std::string Defines() const
+    {
+        std::string defines = "#define SCENE_FEATURES\n";
+        const char* objectFlags[] = { "HAS_SPHERE", "HAS_XYRECT", "HAS_XZRECT", "HAS_YZRECT", "HAS_MODEL" };
+        const int objectIds[] = { OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT, OBJ_MODEL };
+        for(int i = 0; i < 5; ++i)
+        {
+            if(HasObject(objectIds[i]))
+            {
+                defines += std::string("#define ") + objectFlags[i] + "\n";
+            }
+        }
+        const char* materialFlags[] = { "HAS_LAMBERTIAN", "HAS_METALLIC", "HAS_DIELECTRIC" };
+        const int materialIds[] = { MAT_LAMBERTIAN, MAT_METALLIC, MAT_DIELECTRIC };
+        for(int i = 0; i < 3; ++i)
+        {
+            if(HasMaterial(materialIds[i]))
+            {
+                defines += std::string("#define ") + materialFlags[i] + "\n";
+            }
+        }
+        defines += "#define SAMPLES_PER_PIXEL " + std::to_string(samplesPerPixel) + "\n";
+        defines += "#define MAX_DEPTH " + std::to_string(maxDepth) + "\n";
+        defines += "#define BVH_STACK_SIZE " + std::to_string(stackSize) + "\n";
+        return defines;
+    }
+
+    unsigned int objectTypes;
+    unsigned int materialTypes;
+    int samplesPerPixel;
+    int maxDepth;
+    int stackSize;
+};
+
+#endif
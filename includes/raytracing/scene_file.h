@@ -0,0 +1,786 @@
+#ifndef RAY_TRACING_SCENE_FILE_H_
+#define RAY_TRACING_SCENE_FILE_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "rectangle.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "material_pool.h"
+#include "mapped_file.h"
+#include "obj_parser.h"
+
+extern const int MAT_LAMBERTIAN, MAT_METALLIC, MAT_DIELECTRIC, MAT_PBR;
+extern const int OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT, OBJ_MODEL;
+
+// a scene as data instead of a function in scene.h. two forms of the same content:
+//
+// text (.rtscene), for writing by hand. one statement per line, # starts a comment, paths are
+// relative to the repository root and materials are referenced by name:
+//   camera x y z yaw pitch vfov
+//   environment right left top bottom front back
+//   material name lambertian|metallic|dielectric|pbr r g b [roughness [ior]]
+//   sphere x y z radius material
+//   xyrect x0 x1 y0 y1 k material      (xzrect x0 x1 z0 z1 k, yzrect y0 y1 z0 z1 k)
+//   mesh name path
+//   instance mesh material
+//
+// binary (.rtsb), what the text compiles to. a header, a section table and the sections, each
+// at a 64 byte aligned offset. the objects and the bvh are stored already ordered, built and
+// packed in the layouts of the objects and BVHNodes buffers, so loading maps the file and hands
+// out pointers into it: nothing is parsed, sorted or copied on the way to glBufferData.
+// little endian only, like every machine this runs on
+const char SCENE_FILE_MAGIC[4] = { 'R', 'T', 'S', 'B' };
+const uint32_t SCENE_FILE_VERSION = 2;
+const size_t SCENE_FILE_ALIGNMENT = 64;
+// texels per object and per bvh node, as WriteObjectsData and WriteBVHNodesData lay them out:
+// object [center, radius] or [a0, a1, b0, b1], then [material, k, 0, 0]
+// node   [minimum, objectIndex] [maximum, objectType] [left, right, 0, 0]
+// the node's indices and type are int bits in the float texels, see NodeIndexTexel in bvh.h
+const int SCENE_OBJECT_TEXELS = 2;
+const int SCENE_NODE_TEXELS = 3;
+
+enum SceneSectionId : uint32_t
+{
+    SCENE_SECTION_CAMERA = 1,
+    SCENE_SECTION_STRINGS,
+    SCENE_SECTION_ENVIRONMENT,
+    SCENE_SECTION_MESHES,
+    SCENE_SECTION_INSTANCES,
+    SCENE_SECTION_MATERIALS,
+    SCENE_SECTION_OBJECTS,
+    SCENE_SECTION_NODES
+};
+
+struct SceneFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+struct SceneSection
+{
+    uint32_t id;
+    uint32_t count;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// a learnopengl Camera's position and angles, and the field of view the tracer gets
+struct SceneCamera
+{
+    glm::vec3 position = glm::vec3(13.0f, 2.0f, 3.0f);
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+    float vfov = 20.0f;
+};
+
+struct SceneMaterialRecord
+{
+    float color[3];
+    int32_t materialType;
+    float roughness;
+    float ior;
+    int32_t reserved[2];
+};
+
+// mesh loaded from meshes[mesh], placed where it was modelled. object is its OBJ_MODEL leaf,
+// whose box is empty until the mesh is there and RefitModelNode or the like sets it
+struct SceneInstance
+{
+    uint32_t mesh;
+    uint32_t object;
+};
+
+class SceneFile
+{
+public:
+    // building, from a parser or from code. Finish orders and packs what was added
+    // ------------------------------------------------------------------------------
+    uint16_t AddMaterial(const Material& material)
+    {
+        return pool.Intern(material);
+    }
+
+    void AddSphere(const glm::vec3& center, float radius, uint16_t material)
+    {
+        SetSphere(AppendObjects(1), center, radius, material);
+    }
+
+    // objectType OBJ_XYRECT, OBJ_XZRECT or OBJ_YZRECT, a and b the in-plane ranges in that order
+    void AddRect(int objectType, float a0, float a1, float b0, float b1, float k, uint16_t material)
+    {
+        SetRect(AppendObjects(1), objectType, a0, a1, b0, b1, k, material);
+    }
+
+    // count objects at the end, returns the first of them. SetSphere and SetRect fill them in
+    // and can run on several threads as long as every object is set by one
+    size_t AppendObjects(size_t count)
+    {
+        size_t first = boxes.size();
+        ownedObjects.resize((first + count) * SCENE_OBJECT_TEXELS * 4, 0.0f);
+        boxes.resize(first + count);
+        types.resize(first + count, OBJ_SPHERE);
+        return first;
+    }
+
+    void SetSphere(size_t object, const glm::vec3& center, float radius, uint16_t material)
+    {
+        float texels[8] = { center.x, center.y, center.z, radius, (float)material, 0.0f, 0.0f, 0.0f };
+        glm::vec3 r(radius);
+        SetObject(object, OBJ_SPHERE, texels, AABB(center - r, center + r));
+    }
+
+    void SetRect(size_t object, int objectType, float a0, float a1, float b0, float b1, float k, uint16_t material)
+    {
+        float texels[8] = { a0, a1, b0, b1, (float)material, k, 0.0f, 0.0f };
+        AABB box;
+        if(objectType == OBJ_XYRECT)
+            box = AABB(point3(a0, b0, k - 0.0001f), point3(a1, b1, k + 0.0001f));
+        else if(objectType == OBJ_XZRECT)
+            box = AABB(point3(a0, k - 0.0001f, b0), point3(a1, k + 0.0001f, b1));
+        else
+            box = AABB(point3(k - 0.0001f, a0, b0), point3(k + 0.0001f, a1, b1));
+        SetObject(object, objectType, texels, box);
+    }
+
+    int AddMesh(const std::string& path)
+    {
+        meshes.push_back(path);
+        return (int)meshes.size() - 1;
+    }
+
+    void AddInstance(int mesh, uint16_t material)
+    {
+        float texels[8] = { 0.0f, 0.0f, 0.0f, 0.0f, (float)material, 0.0f, 0.0f, 0.0f };
+        size_t object = AppendObjects(1);
+        instances.push_back({ (uint32_t)mesh, (uint32_t)object });
+        SetObject(object, OBJ_MODEL, texels, AABB(point3(0.0f), point3(0.0f)));
+    }
+
+    void ReserveObjects(size_t count)
+    {
+        ownedObjects.reserve(count * SCENE_OBJECT_TEXELS * 4);
+        boxes.reserve(count);
+        types.reserve(count);
+    }
+
+    // puts the objects in morton order of their centers, pairs neighbours into the bvh the
+    // way BuildBVHNodes does and packs it. the instances follow their objects
+    void Finish()
+    {
+        size_t count = boxes.size();
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for(const AABB& box : boxes)
+        {
+            lo = glm::min(lo, (box.minimum + box.maximum) * 0.5f);
+            hi = glm::max(hi, (box.minimum + box.maximum) * 0.5f);
+        }
+        glm::vec3 scale = 1023.0f / glm::max(hi - lo, glm::vec3(1e-20f));
+        std::vector<uint64_t> keys(count);
+        for(size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 cell = ((boxes[i].minimum + boxes[i].maximum) * 0.5f - lo) * scale;
+            keys[i] = ((uint64_t)MortonCode(cell) << 32) | i;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<float> objects(count * SCENE_OBJECT_TEXELS * 4);
+        std::vector<AABB> ordered(count);
+        std::vector<int> orderedTypes(count), newIndex(count);
+        for(size_t n = 0; n < count; ++n)
+        {
+            uint32_t i = (uint32_t)keys[n];
+            std::memcpy(&objects[n * 8], &ownedObjects[i * 8], sizeof(float) * 8);
+            ordered[n] = boxes[i];
+            orderedTypes[n] = types[i];
+            newIndex[i] = (int)n;
+        }
+        for(SceneInstance& instance : instances)
+        {
+            instance.object = newIndex[instance.object];
+        }
+        ownedObjects.swap(objects);
+        boxes.swap(ordered);
+        types.swap(orderedTypes);
+
+        ownedNodes.assign(count == 0 ? 0 : (2 * count - 1) * SCENE_NODE_TEXELS * 4, 0.0f);
+        for(size_t i = 0; i < count; ++i)
+        {
+            WriteNode(&ownedNodes[i * 12], boxes[i], (int)i, types[i], -1, -1);
+        }
+        std::vector<AABB>().swap(boxes);
+        std::vector<int>().swap(types);
+        UseOwned();
+        // the children's boxes are read back from the nodes already written
+        size_t parent = count;
+        for(size_t i = 0; parent + 1 < 2 * count; i += 2, ++parent)
+        {
+            WriteNode(&ownedNodes[parent * 12], SurroundingBox(NodeBox((int)i), NodeBox((int)i + 1)), -1, -1, (int)i, (int)i + 1);
+        }
+    }
+
+    // reading
+    // -------
+    // .rtsb files are mapped, anything else is parsed as text and finished
+    bool Load(const std::string& path)
+    {
+        Clear();
+        MappedFile probe(path);
+        if(!probe.IsOpen())
+        {
+            return false;
+        }
+        bool binary = probe.Size() >= sizeof(SceneFileHeader) && std::memcmp(probe.Data(), SCENE_FILE_MAGIC, 4) == 0;
+        probe.Close();
+        return binary ? LoadBinary(path) : LoadText(path);
+    }
+
+    bool LoadText(const std::string& path)
+    {
+        Clear();
+        MappedFile text(path);
+        if(!text.IsOpen())
+        {
+            return false;
+        }
+        std::unordered_map<std::string, uint16_t> materialByName;
+        std::unordered_map<std::string, int> meshByName;
+        const char* p = text.Data();
+        const char* end = p + text.Size();
+        int line = 0;
+        while(p < end)
+        {
+            ++line;
+            const char* next = SkipObjLine(p, end);
+            p = SkipObjBlanks(p, next);
+            std::string keyword = Word(p, next);
+            if(keyword.empty() || keyword[0] == '#')
+            {
+                p = next;
+                continue;
+            }
+            float v[7];
+            bool ok = true;
+            if(keyword == "camera")
+            {
+                ok = Numbers(p, next, v, 6);
+                camera.position = glm::vec3(v[0], v[1], v[2]);
+                camera.yaw = v[3];
+                camera.pitch = v[4];
+                camera.vfov = v[5];
+            }
+            else if(keyword == "environment")
+            {
+                environment.clear();
+                for(int face = 0; face < 6; ++face)
+                {
+                    environment.push_back(Word(p, next));
+                }
+                ok = !environment.back().empty();
+            }
+            else if(keyword == "material")
+            {
+                std::string name = Word(p, next);
+                std::string type = Word(p, next);
+                int materialType = type == "lambertian" ? MAT_LAMBERTIAN : type == "metallic" ? MAT_METALLIC :
+                    type == "dielectric" ? MAT_DIELECTRIC : type == "pbr" ? MAT_PBR : -1;
+                v[3] = v[4] = 0.0f;
+                ok = materialType >= 0 && Numbers(p, next, v, 3);
+                // roughness and ior are optional
+                for(int i = 3; ok && i < 5 && !AtLineEnd(p, next); ++i)
+                {
+                    ok = Numbers(p, next, v + i, 1);
+                }
+                materialByName[name] = AddMaterial(Material(vec3(v[0], v[1], v[2]), materialType, v[3], v[4]));
+            }
+            else if(keyword == "sphere" || keyword == "xyrect" || keyword == "xzrect" || keyword == "yzrect")
+            {
+                bool sphere = keyword == "sphere";
+                ok = Numbers(p, next, v, sphere ? 4 : 5);
+                auto material = materialByName.find(Word(p, next));
+                ok = ok && material != materialByName.end();
+                if(ok && sphere)
+                    AddSphere(glm::vec3(v[0], v[1], v[2]), v[3], material->second);
+                else if(ok)
+                    AddRect(keyword == "xyrect" ? OBJ_XYRECT : keyword == "xzrect" ? OBJ_XZRECT : OBJ_YZRECT,
+                        v[0], v[1], v[2], v[3], v[4], material->second);
+            }
+            else if(keyword == "mesh")
+            {
+                std::string name = Word(p, next);
+                std::string meshPath = Word(p, next);
+                ok = !meshPath.empty();
+                meshByName[name] = AddMesh(meshPath);
+            }
+            else if(keyword == "instance")
+            {
+                auto mesh = meshByName.find(Word(p, next));
+                auto material = materialByName.find(Word(p, next));
+                ok = mesh != meshByName.end() && material != materialByName.end();
+                if(ok)
+                    AddInstance(mesh->second, material->second);
+            }
+            else
+            {
+                ok = false;
+            }
+            if(!ok)
+            {
+                std::cout << "ERROR::SCENE_FILE::SYNTAX " << path << ":" << line << " " << keyword << std::endl;
+                Clear();
+                return false;
+            }
+            p = next;
+        }
+        Finish();
+        return true;
+    }
+
+    bool LoadBinary(const std::string& path)
+    {
+        Clear();
+        if(!file.Open(path))
+        {
+            return false;
+        }
+        const char* data = file.Data();
+        size_t size = file.Size();
+        const SceneFileHeader* header = (const SceneFileHeader*)data;
+        if(size < sizeof(SceneFileHeader) || std::memcmp(header->magic, SCENE_FILE_MAGIC, 4) != 0 ||
+            header->version != SCENE_FILE_VERSION ||
+            size < sizeof(SceneFileHeader) + header->sectionCount * sizeof(SceneSection))
+        {
+            std::cout << "ERROR::SCENE_FILE::HEADER " << path << std::endl;
+            Clear();
+            return false;
+        }
+        const SceneSection* sections = (const SceneSection*)(data + sizeof(SceneFileHeader));
+        const char* strings = nullptr;
+        size_t stringBytes = 0;
+        for(uint32_t s = 0; s < header->sectionCount; ++s)
+        {
+            if(sections[s].offset > size || sections[s].bytes > size - sections[s].offset)
+            {
+                std::cout << "ERROR::SCENE_FILE::SECTION " << path << " section " << sections[s].id << std::endl;
+                Clear();
+                return false;
+            }
+            if(sections[s].id == SCENE_SECTION_STRINGS)
+            {
+                strings = data + sections[s].offset;
+                stringBytes = sections[s].bytes;
+            }
+        }
+        // a string is an offset into the string section, which ends with a 0
+        auto stringAt = [&](uint32_t offset) -> std::string
+        {
+            return strings && offset < stringBytes && strings[stringBytes - 1] == '\0' ? std::string(strings + offset) : std::string();
+        };
+        bool ok = true;
+        for(uint32_t s = 0; s < header->sectionCount && ok; ++s)
+        {
+            const SceneSection& section = sections[s];
+            const char* begin = data + section.offset;
+            switch(section.id)
+            {
+                case SCENE_SECTION_CAMERA:
+                    ok = section.bytes == sizeof(SceneCamera);
+                    if(ok)
+                        std::memcpy(&camera, begin, sizeof(SceneCamera));
+                break;
+                case SCENE_SECTION_ENVIRONMENT:
+                case SCENE_SECTION_MESHES:
+                {
+                    ok = section.bytes == section.count * sizeof(uint32_t);
+                    std::vector<std::string>& list = section.id == SCENE_SECTION_MESHES ? meshes : environment;
+                    for(uint32_t i = 0; ok && i < section.count; ++i)
+                    {
+                        list.push_back(stringAt(((const uint32_t*)begin)[i]));
+                    }
+                }
+                break;
+                case SCENE_SECTION_INSTANCES:
+                    ok = section.bytes == section.count * sizeof(SceneInstance);
+                    if(ok)
+                        instances.assign((const SceneInstance*)begin, (const SceneInstance*)begin + section.count);
+                break;
+                case SCENE_SECTION_MATERIALS:
+                    ok = section.bytes == section.count * sizeof(SceneMaterialRecord);
+                    for(uint32_t i = 0; ok && i < section.count; ++i)
+                    {
+                        const SceneMaterialRecord& record = ((const SceneMaterialRecord*)begin)[i];
+                        pool.Intern(Material(vec3(record.color[0], record.color[1], record.color[2]), record.materialType,
+                            record.roughness, record.ior));
+                    }
+                    // materials were unique when written, so the indices in the objects still hold
+                    ok = ok && pool.Size() == (int)section.count;
+                break;
+                case SCENE_SECTION_OBJECTS:
+                    ok = section.bytes == (uint64_t)section.count * SCENE_OBJECT_TEXELS * 4 * sizeof(float);
+                    objectTexels = (const float (*)[4])begin;
+                    objectCount = section.count;
+                break;
+                case SCENE_SECTION_NODES:
+                    ok = section.bytes == (uint64_t)section.count * SCENE_NODE_TEXELS * 4 * sizeof(float);
+                    nodeTexels = (const float (*)[4])begin;
+                    nodeCount = section.count;
+                break;
+            }
+        }
+        ok = ok && nodeCount == (objectCount == 0 ? 0 : 2 * objectCount - 1) && IndicesInRange();
+        if(!ok)
+        {
+            std::cout << "ERROR::SCENE_FILE::CONTENT " << path << std::endl;
+            Clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool SaveBinary(const std::string& path) const
+    {
+        std::string strings;
+        auto addString = [&](const std::string& s)
+        {
+            uint32_t offset = (uint32_t)strings.size();
+            strings.append(s).push_back('\0');
+            return offset;
+        };
+        std::vector<uint32_t> environmentOffsets, meshOffsets;
+        for(const std::string& face : environment)
+            environmentOffsets.push_back(addString(face));
+        for(const std::string& mesh : meshes)
+            meshOffsets.push_back(addString(mesh));
+        std::vector<SceneMaterialRecord> materialRecords(pool.Size());
+        for(int i = 0; i < pool.Size(); ++i)
+        {
+            const Material& m = *pool.materials[i];
+            materialRecords[i] = { { m.color.x, m.color.y, m.color.z }, m.materialType, m.roughness, m.ior, { 0, 0 } };
+        }
+
+        struct Payload { uint32_t id; uint32_t count; const void* data; uint64_t bytes; };
+        std::vector<Payload> payloads =
+        {
+            { SCENE_SECTION_CAMERA, 1, &camera, sizeof(SceneCamera) },
+            { SCENE_SECTION_STRINGS, (uint32_t)strings.size(), strings.data(), strings.size() },
+            { SCENE_SECTION_ENVIRONMENT, (uint32_t)environmentOffsets.size(), environmentOffsets.data(), environmentOffsets.size() * sizeof(uint32_t) },
+            { SCENE_SECTION_MESHES, (uint32_t)meshOffsets.size(), meshOffsets.data(), meshOffsets.size() * sizeof(uint32_t) },
+            { SCENE_SECTION_INSTANCES, (uint32_t)instances.size(), instances.data(), instances.size() * sizeof(SceneInstance) },
+            { SCENE_SECTION_MATERIALS, (uint32_t)materialRecords.size(), materialRecords.data(), materialRecords.size() * sizeof(SceneMaterialRecord) },
+            { SCENE_SECTION_OBJECTS, (uint32_t)objectCount, objectTexels, (uint64_t)objectCount * SCENE_OBJECT_TEXELS * 4 * sizeof(float) },
+            { SCENE_SECTION_NODES, (uint32_t)nodeCount, nodeTexels, (uint64_t)nodeCount * SCENE_NODE_TEXELS * 4 * sizeof(float) }
+        };
+        SceneFileHeader header;
+        std::memcpy(header.magic, SCENE_FILE_MAGIC, 4);
+        header.version = SCENE_FILE_VERSION;
+        header.sectionCount = (uint32_t)payloads.size();
+        header.reserved = 0;
+        std::vector<SceneSection> sections;
+        uint64_t offset = sizeof(SceneFileHeader) + payloads.size() * sizeof(SceneSection);
+        for(const Payload& payload : payloads)
+        {
+            offset = (offset + SCENE_FILE_ALIGNMENT - 1) & ~(uint64_t)(SCENE_FILE_ALIGNMENT - 1);
+            sections.push_back({ payload.id, payload.count, offset, payload.bytes });
+            offset += payload.bytes;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if(!out)
+        {
+            std::cout << "ERROR::SCENE_FILE::WRITE " << path << std::endl;
+            return false;
+        }
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)sections.data(), sections.size() * sizeof(SceneSection));
+        uint64_t written = sizeof(SceneFileHeader) + sections.size() * sizeof(SceneSection);
+        const char zeros[SCENE_FILE_ALIGNMENT] = {};
+        for(size_t s = 0; s < payloads.size(); ++s)
+        {
+            out.write(zeros, sections[s].offset - written);
+            out.write((const char*)payloads[s].data, payloads[s].bytes);
+            written = sections[s].offset + payloads[s].bytes;
+        }
+        return (bool)out;
+    }
+
+    // the text form of what is loaded, materials named after their index
+    bool SaveText(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if(!out)
+        {
+            std::cout << "ERROR::SCENE_FILE::WRITE " << path << std::endl;
+            return false;
+        }
+        // enough digits to read back the same floats
+        out.precision(9);
+        const char* typeNames[] = { "lambertian", "metallic", "dielectric", "pbr" };
+        out << "camera " << camera.position.x << " " << camera.position.y << " " << camera.position.z << " "
+            << camera.yaw << " " << camera.pitch << " " << camera.vfov << "\n";
+        if(environment.size() == 6)
+        {
+            out << "environment";
+            for(const std::string& face : environment)
+                out << " " << face;
+            out << "\n";
+        }
+        for(int i = 0; i < pool.Size(); ++i)
+        {
+            const Material& m = *pool.materials[i];
+            out << "material m" << i << " " << typeNames[std::min(3, std::max(0, m.materialType))] << " " << m.color.x << " "
+                << m.color.y << " " << m.color.z << " " << m.roughness << " " << m.ior << "\n";
+        }
+        for(size_t i = 0; i < meshes.size(); ++i)
+        {
+            out << "mesh mesh" << i << " " << meshes[i] << "\n";
+        }
+        for(int i = 0; i < objectCount; ++i)
+        {
+            const float* bounds = objectTexels[i * SCENE_OBJECT_TEXELS];
+            const float* extra = objectTexels[i * SCENE_OBJECT_TEXELS + 1];
+            int type = ObjectType(i);
+            if(type == OBJ_SPHERE)
+                out << "sphere " << bounds[0] << " " << bounds[1] << " " << bounds[2] << " " << bounds[3];
+            else if(type == OBJ_MODEL)
+                continue;
+            else
+                out << (type == OBJ_XYRECT ? "xyrect " : type == OBJ_XZRECT ? "xzrect " : "yzrect ") << bounds[0] << " "
+                    << bounds[1] << " " << bounds[2] << " " << bounds[3] << " " << extra[1];
+            out << " m" << (int)extra[0] << "\n";
+        }
+        for(const SceneInstance& instance : instances)
+        {
+            out << "instance mesh" << instance.mesh << " m" << (int)objectTexels[instance.object * SCENE_OBJECT_TEXELS + 1][0] << "\n";
+        }
+        return (bool)out;
+    }
+
+    // the objects and the bvh as the demos keep them, for the parts that still walk a
+    // HittableList. the materials come from pool, interned at the same indices
+    void Objects(HittableList& objects, std::vector<BVHNode>& nodes) const
+    {
+        objects.clear();
+        objects.objects.reserve(objectCount);
+        for(int i = 0; i < objectCount; ++i)
+        {
+            const float* bounds = objectTexels[i * SCENE_OBJECT_TEXELS];
+            const float* extra = objectTexels[i * SCENE_OBJECT_TEXELS + 1];
+            uint16_t material = (uint16_t)extra[0];
+            std::shared_ptr<Material> matPtr = material < pool.Size() ? pool.materials[material] : nullptr;
+            std::shared_ptr<Hittable> object;
+            int type = ObjectType(i);
+            if(type == OBJ_XYRECT)
+                object = std::make_shared<XYRect>(bounds[0], bounds[1], bounds[2], bounds[3], extra[1], matPtr);
+            else if(type == OBJ_XZRECT)
+                object = std::make_shared<XZRect>(bounds[0], bounds[1], bounds[2], bounds[3], extra[1], matPtr);
+            else if(type == OBJ_YZRECT)
+                object = std::make_shared<YZRect>(bounds[0], bounds[1], bounds[2], bounds[3], extra[1], matPtr);
+            else
+                object = std::make_shared<Sphere>(vec3(bounds[0], bounds[1], bounds[2]), bounds[3], matPtr);
+            // the model is a placeholder sphere with the model's box, as DisplayScene makes it
+            object->objectType = type;
+            object->box = NodeBox(i);
+            object->materialIndex = material;
+            objects.add(object);
+        }
+        nodes.assign(nodeCount, BVHNode());
+        for(int i = 0; i < nodeCount; ++i)
+        {
+            const float (*texels)[4] = nodeTexels + i * SCENE_NODE_TEXELS;
+            nodes[i].aabb = NodeBox(i);
+            nodes[i].objectIndex = NodeTexelIndex(texels[0][3]);
+            nodes[i].objectType = NodeTexelIndex(texels[1][3]);
+            nodes[i].left = NodeTexelIndex(texels[2][0]);
+            nodes[i].right = NodeTexelIndex(texels[2][1]);
+        }
+        for(int i = 0; i < nodeCount; ++i)
+        {
+            if(nodes[i].left >= 0)
+            {
+                nodes[nodes[i].left].parent = nodes[nodes[i].right].parent = i;
+            }
+        }
+    }
+
+    int ObjectCount() const { return objectCount; }
+    int NodeCount() const { return nodeCount; }
+    // ObjectCount() * SCENE_OBJECT_TEXELS texels, in the mapped file when it was binary
+    const float (*ObjectTexels() const)[4] { return objectTexels; }
+    // NodeCount() * SCENE_NODE_TEXELS texels, the root is the last node
+    const float (*NodeTexels() const)[4] { return nodeTexels; }
+    int ObjectType(int object) const { return NodeTexelIndex(nodeTexels[object * SCENE_NODE_TEXELS + 1][3]); }
+    bool IsMapped() const { return file.IsOpen(); }
+    size_t FileSize() const { return file.Size(); }
+
+    void Clear()
+    {
+        file.Close();
+        pool = MaterialPool();
+        camera = SceneCamera();
+        environment.clear();
+        meshes.clear();
+        instances.clear();
+        ownedObjects.clear();
+        ownedNodes.clear();
+        boxes.clear();
+        types.clear();
+        objectTexels = nodeTexels = nullptr;
+        objectCount = nodeCount = 0;
+    }
+
+    SceneCamera camera;
+    // six cubemap faces or none
+    std::vector<std::string> environment;
+    std::vector<std::string> meshes;
+    std::vector<SceneInstance> instances;
+    // the scene's materials, the objects hold indices into it
+    MaterialPool pool;
+
+private:
+    void SetObject(size_t object, int type, const float* texels, const AABB& box)
+    {
+        std::memcpy(&ownedObjects[object * SCENE_OBJECT_TEXELS * 4], texels, sizeof(float) * SCENE_OBJECT_TEXELS * 4);
+        boxes[object] = box;
+        types[object] = type;
+    }
+
+    void UseOwned()
+    {
+        objectCount = (int)(ownedObjects.size() / (SCENE_OBJECT_TEXELS * 4));
+        nodeCount = (int)(ownedNodes.size() / (SCENE_NODE_TEXELS * 4));
+        objectTexels = (const float (*)[4])ownedObjects.data();
+        nodeTexels = (const float (*)[4])ownedNodes.data();
+    }
+
+    // what LoadBinary takes on trust otherwise: the layout Finish writes, leaf i holding object i
+    // and every other node two nodes below it, materials in the pool and instances on mesh leaves
+    bool IndicesInRange() const
+    {
+        for(int i = 0; i < objectCount; ++i)
+        {
+            float material = objectTexels[i * SCENE_OBJECT_TEXELS + 1][0];
+            if(!(material >= 0.0f && material < (float)pool.Size()))
+            {
+                return false;
+            }
+        }
+        for(int i = 0; i < nodeCount; ++i)
+        {
+            const float (*texels)[4] = nodeTexels + i * SCENE_NODE_TEXELS;
+            int objectIndex = NodeTexelIndex(texels[0][3]);
+            int left = NodeTexelIndex(texels[2][0]);
+            int right = NodeTexelIndex(texels[2][1]);
+            bool valid = i < objectCount ? objectIndex == i && left == -1 && right == -1 :
+                objectIndex == -1 && left >= 0 && left < i && right >= 0 && right < i;
+            if(!valid)
+            {
+                return false;
+            }
+        }
+        for(const SceneInstance& instance : instances)
+        {
+            if(instance.mesh >= meshes.size() || instance.object >= (uint32_t)objectCount || ObjectType(instance.object) != OBJ_MODEL)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    AABB NodeBox(int node) const
+    {
+        const float (*texels)[4] = nodeTexels + node * SCENE_NODE_TEXELS;
+        return AABB(point3(texels[0][0], texels[0][1], texels[0][2]), point3(texels[1][0], texels[1][1], texels[1][2]));
+    }
+
+    static void WriteNode(float* texels, const AABB& box, int objectIndex, int objectType, int left, int right)
+    {
+        texels[0] = box.minimum.x;
+        texels[1] = box.minimum.y;
+        texels[2] = box.minimum.z;
+        texels[3] = NodeIndexTexel(objectIndex);
+        texels[4] = box.maximum.x;
+        texels[5] = box.maximum.y;
+        texels[6] = box.maximum.z;
+        texels[7] = NodeIndexTexel(objectType);
+        texels[8] = NodeIndexTexel(left);
+        texels[9] = NodeIndexTexel(right);
+        texels[10] = texels[11] = 0.0f;
+    }
+
+    // 10 bits per axis interleaved, cell in [0, 1023]
+    static uint32_t MortonCode(const glm::vec3& cell)
+    {
+        auto spread = [](uint32_t v)
+        {
+            v = (v | (v << 16)) & 0x030000FF;
+            v = (v | (v << 8)) & 0x0300F00F;
+            v = (v | (v << 4)) & 0x030C30C3;
+            v = (v | (v << 2)) & 0x09249249;
+            return v;
+        };
+        glm::uvec3 c = glm::uvec3(glm::clamp(cell, glm::vec3(0.0f), glm::vec3(1023.0f)));
+        return (spread(c.x) << 2) | (spread(c.y) << 1) | spread(c.z);
+    }
+
+    // the next blank separated word of the line, p moves past it
+    static std::string Word(const char*& p, const char* end)
+    {
+        p = SkipObjBlanks(p, end);
+        const char* start = p;
+        while(p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        {
+            ++p;
+        }
+        return std::string(start, p);
+    }
+
+    static bool AtLineEnd(const char* p, const char* end)
+    {
+        p = SkipObjBlanks(p, end);
+        return p == end || *p == '\r' || *p == '\n' || *p == '#';
+    }
+
+    static bool Numbers(const char*& p, const char* end, float* values, int count)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            p = SkipObjBlanks(p, end);
+            const char* after = ParseObjFloat(p, end, values[i]);
+            if(after == p)
+            {
+                return false;
+            }
+            p = after;
+        }
+        return true;
+    }
+
+    MappedFile file;
+    std::vector<float> ownedObjects, ownedNodes;
+    // per object until Finish
+    std::vector<AABB> boxes;
+    std::vector<int> types;
+    const float (*objectTexels)[4] = nullptr;
+    const float (*nodeTexels)[4] = nullptr;
+    int objectCount = 0;
+    int nodeCount = 0;
+};
+
+#endif
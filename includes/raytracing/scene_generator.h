@@ -0,0 +1,168 @@
+#ifndef RAY_TRACING_SCENE_GENERATOR_H_
+#define RAY_TRACING_SCENE_GENERATOR_H_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "material.h"
+#include "scene_file.h"
+#include "hash.h"
+#include "thread_pool.h"
+
+extern const int MAT_LAMBERTIAN, MAT_METALLIC, MAT_DIELECTRIC;
+extern const int OBJ_XYRECT, OBJ_YZRECT;
+
+const int SCENE_GENERATOR_MIN_OBJECTS_PER_THREAD = 16384;
+// the palette draws from streams past every object's
+const uint64_t SCENE_GENERATOR_PALETTE_STREAM = 1ull << 62;
+
+// counter based random numbers. the n-th number of a stream is a hash of the seed, the stream
+// and n, nothing is carried from one number to the next, so an object drawing from its own
+// stream gets the same numbers on whichever thread and in whatever order it is generated
+class RandomStream
+{
+public:
+    RandomStream(uint64_t seed, uint64_t stream) : key(SplitMix64(seed + SplitMix64(stream + 0x9E3779B97F4A7C15ull))) {}
+
+    uint32_t NextUint()
+    {
+        return (uint32_t)(SplitMix64(key + ++counter * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    // [0, 1)
+    float Next()
+    {
+        return (NextUint() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float Next(float min, float max)
+    {
+        return min + (max - min) * Next();
+    }
+
+private:
+    uint64_t key;
+    uint64_t counter = 0;
+};
+
+// RandomScene without its fixed grid: the defaults give its density and material mix
+struct SceneGeneratorSettings
+{
+    // objects besides the ground
+    size_t count = 10000;
+    // objects per unit of ground, the field grows with count
+    float density = 1.0f;
+    // how the objects split into spheres and rects, need not add up to 1
+    float sphereShare = 1.0f;
+    float rectShare = 0.0f;
+    // how the objects' materials split into the types, need not add up to 1
+    float lambertianShare = 0.8f;
+    float metallicShare = 0.15f;
+    float dielectricShare = 0.05f;
+    // distinct materials of each type
+    int materialVariety = 16;
+    // of the spheres, rects are twice as wide and high
+    float radius = 0.2f;
+    // a big sphere under the field, as in RandomScene
+    bool ground = true;
+    uint64_t seed = 1;
+};
+
+struct SceneGeneratorPalette
+{
+    std::vector<uint16_t> materials[3];
+    float thresholds[2];
+};
+
+// object gets its numbers from its own stream, so the chunks below can go to any thread
+inline void GenerateObjects(const SceneGeneratorSettings& settings, const SceneGeneratorPalette& palette,
+    size_t begin, size_t end, size_t sphereCount, size_t firstObject, SceneFile* scene)
+{
+    float half = 0.5f * std::sqrt(settings.count / std::max(settings.density, 1e-6f));
+    float r = settings.radius;
+    for(size_t i = begin; i < end; ++i)
+    {
+        RandomStream random(settings.seed, i);
+        float type = random.Next();
+        const std::vector<uint16_t>& materials = palette.materials[type < palette.thresholds[0] ? 0 : type < palette.thresholds[1] ? 1 : 2];
+        uint16_t material = materials[random.NextUint() % materials.size()];
+        float x = random.Next(-half, half);
+        float z = random.Next(-half, half);
+        if(i < sphereCount)
+        {
+            scene->SetSphere(firstObject + i, glm::vec3(x, r, z), r, material);
+        }
+        else if(random.NextUint() & 1)
+        {
+            scene->SetRect(firstObject + i, OBJ_XYRECT, x - 2.0f * r, x + 2.0f * r, 0.0f, 4.0f * r, z, material);
+        }
+        else
+        {
+            scene->SetRect(firstObject + i, OBJ_YZRECT, 0.0f, 4.0f * r, z - 2.0f * r, z + 2.0f * r, x, material);
+        }
+    }
+}
+
+// adds the scene settings describe to scene on threadCount threads (0 for every hardware
+// thread). the result depends on settings alone, not on the thread count. Finish orders and
+// packs it like any other scene
+void GenerateScene(const SceneGeneratorSettings& settings, SceneFile& scene, unsigned int threadCount = 0)
+{
+    float half = 0.5f * std::sqrt(settings.count / std::max(settings.density, 1e-6f));
+    scene.camera.position = glm::vec3(0.0f, 2.0f + half, 4.0f + 1.5f * half);
+    scene.camera.yaw = -90.0f;
+    scene.camera.pitch = -30.0f;
+    scene.camera.vfov = 40.0f;
+
+    // the palette, on this thread
+    SceneGeneratorPalette palette;
+    int variety = std::max(1, settings.materialVariety);
+    for(int type = 0; type < 3; ++type)
+    {
+        for(int i = 0; i < variety; ++i)
+        {
+            RandomStream random(settings.seed, SCENE_GENERATOR_PALETTE_STREAM + type * variety + i);
+            if(type == 0)
+            {
+                vec3 albedo(random.Next() * random.Next(), random.Next() * random.Next(), random.Next() * random.Next());
+                palette.materials[type].push_back(scene.AddMaterial(Material(albedo, MAT_LAMBERTIAN)));
+            }
+            else if(type == 1)
+            {
+                vec3 albedo(random.Next(0.5f, 1.0f), random.Next(0.5f, 1.0f), random.Next(0.5f, 1.0f));
+                palette.materials[type].push_back(scene.AddMaterial(Material(albedo, MAT_METALLIC, random.Next(0.0f, 0.2f))));
+            }
+            else
+            {
+                vec3 albedo(random.Next(0.7f, 1.0f), random.Next(0.7f, 1.0f), random.Next(0.7f, 1.0f));
+                palette.materials[type].push_back(scene.AddMaterial(Material(albedo, MAT_DIELECTRIC, 0.0f, 1.5f)));
+            }
+        }
+    }
+    float materialTotal = std::max(settings.lambertianShare + settings.metallicShare + settings.dielectricShare, 1e-6f);
+    palette.thresholds[0] = settings.lambertianShare / materialTotal;
+    palette.thresholds[1] = (settings.lambertianShare + settings.metallicShare) / materialTotal;
+
+    if(settings.ground)
+    {
+        scene.AddSphere(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, scene.AddMaterial(Material(vec3(0.5f, 0.5f, 0.5f), MAT_LAMBERTIAN)));
+    }
+
+    // spheres, then rects, each a contiguous run of the generation order
+    float shareTotal = std::max(settings.sphereShare + settings.rectShare, 1e-6f);
+    size_t sphereCount = (size_t)std::llround(settings.count * (double)(settings.sphereShare / shareTotal));
+    sphereCount = std::min(sphereCount, settings.count);
+
+    size_t count = settings.count;
+    size_t firstObject = scene.AppendObjects(count);
+    ParallelFor((int)count, ChunkCount((int)count, SCENE_GENERATOR_MIN_OBJECTS_PER_THREAD, threadCount), [&](int begin, int end)
+    {
+        GenerateObjects(settings, palette, begin, end, sphereCount, firstObject, &scene);
+    });
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef RAY_TRACING_SCENE_UNIFORMS_H_
+#define RAY_TRACING_SCENE_UNIFORMS_H_
+
+#include <cstring>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// camera and world parameters of the tracer shader, kept in a std140 uniform buffer
+// bound once to BINDING. setters only mark the block dirty when a value changes and
+// Upload writes it, so a still camera costs no buffer traffic at all.
+class SceneUniforms
+{
+public:
+    static const unsigned int BINDING = 0;
+
+    SceneUniforms(): dirty(true)
+    {
+        std::memset(&block, 0, sizeof(block));
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    }
+
+    ~SceneUniforms()
+    {
+        glDeleteBuffers(1, &ubo);
+    }
+
+    void SetCamera(const glm::vec3& lookFrom, const glm::vec3& lookAt, const glm::vec3& vup, float vfov, float aspectRatio)
+    {
+        if(lookFrom != block.lookFrom || lookAt != block.lookAt || vup != block.vup ||
+            vfov != block.vfov || aspectRatio != block.aspectRatio)
+        {
+            block.lookFrom = lookFrom;
+            block.lookAt = lookAt;
+            block.vup = vup;
+            block.vfov = vfov;
+            block.aspectRatio = aspectRatio;
+            dirty = true;
+        }
+    }
+
+    void SetWorld(int objectCount, int triangleCount, int nodesHead)
+    {
+        if(objectCount != block.objectCount || triangleCount != block.triangleCount || nodesHead != block.nodesHead)
+        {
+            block.objectCount = objectCount;
+            block.triangleCount = triangleCount;
+            block.nodesHead = nodesHead;
+            dirty = true;
+        }
+    }
+
+    // writes pending changes, returns whether the buffer was touched
+    bool Upload()
+    {
+        if(!dirty)
+        {
+            return false;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirty = false;
+        return true;
+    }
+
+    unsigned int ID() const { return ubo; }
+
+private:
+    // mirrors the SceneParameters block: CameraParameter then World, std140 padded
+    struct Block
+    {
+        glm::vec3 lookFrom;
+        float pad0;
+        glm::vec3 lookAt;
+        float pad1;
+        glm::vec3 vup;
+        float vfov;
+        float aspectRatio;
+        float pad2[3];
+        int objectCount;
+        int triangleCount;
+        int nodesHead;
+        int pad3;
+    };
+    static_assert(sizeof(Block) == 80, "SceneParameters block must match std140");
+
+    Block block;
+    bool dirty;
+    unsigned int ubo;
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef RAY_TRACING_SKELETAL_ANIMATION_H_
+#define RAY_TRACING_SKELETAL_ANIMATION_H_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "thread_pool.h"
+
+// characters per thread below which UpdateAnimations doesn't split the work further
+const int ANIMATION_MIN_STATES_PER_THREAD = 16;
+
+// the keys of one animated node, ranges into the clip's key arrays
+struct AnimationTrack
+{
+    uint32_t positionBegin, positionCount;
+    uint32_t rotationBegin, rotationCount;
+    uint32_t scaleBegin, scaleCount;
+};
+
+class AnimationClip;
+
+// one character playing a clip. the cursors remember which key every track used last time, so
+// time moving forward finds the next key without a search
+struct AnimationState
+{
+    const AnimationClip* clip = nullptr;
+    // in ticks
+    float time = 0.0f;
+    std::vector<uint32_t> cursors;
+    // global transform of every node, scratch for Evaluate
+    std::vector<glm::mat4> globals;
+};
+
+// an animation compiled for evaluation: the node hierarchy is flattened into arrays with every
+// parent before its children, bone ids and tracks are resolved per node once, and the keys of
+// all tracks sit in a few flat arrays. evaluating it is one pass over the nodes without names,
+// maps or recursion
+class AnimationClip
+{
+public:
+    // parent -1 for the root, otherwise a node added before. boneId -1 for nodes that only move
+    // their children, else the slot in the bone matrices with offset from model to bone space
+    int AddNode(int parent, const glm::mat4& bindTransform, int boneId = -1, const glm::mat4& offset = glm::mat4(1.0f),
+        const std::string& name = "")
+    {
+        parents.push_back(parent);
+        bindTransforms.push_back(bindTransform);
+        boneIds.push_back(boneId);
+        offsets.push_back(offset);
+        trackOfNode.push_back(-1);
+        names.push_back(name);
+        boneCount = std::max(boneCount, boneId + 1);
+        return (int)parents.size() - 1;
+    }
+
+    // keys must be sorted by time and every channel needs at least one
+    void SetTrack(int node, const std::vector<float>& positionTimes, const std::vector<glm::vec3>& positions,
+        const std::vector<float>& rotationTimes, const std::vector<glm::quat>& rotations,
+        const std::vector<float>& scaleTimes, const std::vector<glm::vec3>& scales)
+    {
+        AnimationTrack track;
+        track.positionBegin = (uint32_t)positionKeyTimes.size();
+        track.positionCount = (uint32_t)positions.size();
+        positionKeyTimes.insert(positionKeyTimes.end(), positionTimes.begin(), positionTimes.end());
+        positionKeys.insert(positionKeys.end(), positions.begin(), positions.end());
+        track.rotationBegin = (uint32_t)rotationKeyTimes.size();
+        track.rotationCount = (uint32_t)rotations.size();
+        rotationKeyTimes.insert(rotationKeyTimes.end(), rotationTimes.begin(), rotationTimes.end());
+        rotationKeys.insert(rotationKeys.end(), rotations.begin(), rotations.end());
+        track.scaleBegin = (uint32_t)scaleKeyTimes.size();
+        track.scaleCount = (uint32_t)scales.size();
+        scaleKeyTimes.insert(scaleKeyTimes.end(), scaleTimes.begin(), scaleTimes.end());
+        scaleKeys.insert(scaleKeys.end(), scales.begin(), scales.end());
+        trackOfNode[node] = (int)tracks.size();
+        tracks.push_back(track);
+    }
+
+    void SetTiming(float durationTicks, float ticks)
+    {
+        duration = durationTicks;
+        ticksPerSecond = ticks > 0.0f ? ticks : 25.0f;
+    }
+
+    // a state for this clip at time 0
+    AnimationState CreateState() const
+    {
+        AnimationState state;
+        state.clip = this;
+        state.cursors.assign(tracks.size() * 3, 0);
+        state.globals.resize(parents.size());
+        return state;
+    }
+
+    // moves the state on by dt seconds, wrapping at the end of the clip
+    void Advance(AnimationState& state, float dt) const
+    {
+        state.time += ticksPerSecond * dt;
+        if(duration > 0.0f)
+        {
+            state.time = std::fmod(state.time, duration);
+            if(state.time < 0.0f)
+            {
+                state.time += duration;
+            }
+        }
+    }
+
+    // writes the matrix of every bone below count into boneMatrices, the others are left alone
+    void Evaluate(AnimationState& state, glm::mat4* boneMatrices, int count) const
+    {
+        if(state.globals.size() != parents.size() || state.cursors.size() != tracks.size() * 3)
+        {
+            state.cursors.assign(tracks.size() * 3, 0);
+            state.globals.resize(parents.size());
+        }
+        glm::mat4* globals = state.globals.data();
+        for(size_t node = 0; node < parents.size(); ++node)
+        {
+            int track = trackOfNode[node];
+            glm::mat4 local = track < 0 ? bindTransforms[node] : Sample(tracks[track], state.time, &state.cursors[track * 3]);
+            int parent = parents[node];
+            globals[node] = parent < 0 ? local : globals[parent] * local;
+            int boneId = boneIds[node];
+            if(boneId >= 0 && boneId < count)
+            {
+                boneMatrices[boneId] = globals[node] * offsets[node];
+            }
+        }
+    }
+
+    int NodeCount() const { return (int)parents.size(); }
+    int BoneCount() const { return boneCount; }
+    int TrackCount() const { return (int)tracks.size(); }
+    float Duration() const { return duration; }
+    float TicksPerSecond() const { return ticksPerSecond; }
+
+    // -1 when there is no such node, only for setup code
+    int FindNode(const std::string& name) const
+    {
+        auto found = std::find(names.begin(), names.end(), name);
+        return found == names.end() ? -1 : (int)(found - names.begin());
+    }
+
+private:
+    // the key before t in times[0, count), count > 1. the cursor is tried first, then the key
+    // after it, a jump (a loop or a seek) falls back to a binary search
+    static uint32_t FindKey(const float* times, uint32_t count, float t, uint32_t& cursor)
+    {
+        uint32_t key = cursor;
+        if(key + 1 < count && times[key] <= t && t < times[key + 1])
+        {
+            return key;
+        }
+        if(key + 2 < count && times[key + 1] <= t && t < times[key + 2])
+        {
+            return cursor = key + 1;
+        }
+        // the last key has no interval of its own, times past it stay in the last interval
+        key = (uint32_t)(std::upper_bound(times + 1, times + count - 1, t) - times) - 1;
+        return cursor = key;
+    }
+
+    static float KeyFactor(const float* times, uint32_t key, float t)
+    {
+        float length = times[key + 1] - times[key];
+        return length > 0.0f ? glm::clamp((t - times[key]) / length, 0.0f, 1.0f) : 0.0f;
+    }
+
+    // translation * rotation * scale, built directly instead of multiplying three matrices
+    glm::mat4 Sample(const AnimationTrack& track, float t, uint32_t* cursors) const
+    {
+        glm::vec3 position = positionKeys[track.positionBegin];
+        if(track.positionCount > 1)
+        {
+            const float* times = &positionKeyTimes[track.positionBegin];
+            uint32_t key = FindKey(times, track.positionCount, t, cursors[0]);
+            position = glm::mix(positionKeys[track.positionBegin + key], positionKeys[track.positionBegin + key + 1],
+                KeyFactor(times, key, t));
+        }
+        glm::quat rotation = rotationKeys[track.rotationBegin];
+        if(track.rotationCount > 1)
+        {
+            const float* times = &rotationKeyTimes[track.rotationBegin];
+            uint32_t key = FindKey(times, track.rotationCount, t, cursors[1]);
+            rotation = glm::slerp(rotationKeys[track.rotationBegin + key], rotationKeys[track.rotationBegin + key + 1],
+                KeyFactor(times, key, t));
+        }
+        glm::vec3 scale = scaleKeys[track.scaleBegin];
+        if(track.scaleCount > 1)
+        {
+            const float* times = &scaleKeyTimes[track.scaleBegin];
+            uint32_t key = FindKey(times, track.scaleCount, t, cursors[2]);
+            scale = glm::mix(scaleKeys[track.scaleBegin + key], scaleKeys[track.scaleBegin + key + 1], KeyFactor(times, key, t));
+        }
+        glm::mat4 transform = glm::mat4_cast(glm::normalize(rotation));
+        transform[0] *= scale.x;
+        transform[1] *= scale.y;
+        transform[2] *= scale.z;
+        transform[3] = glm::vec4(position, 1.0f);
+        return transform;
+    }
+
+    // per node, parents first
+    std::vector<int> parents;
+    std::vector<glm::mat4> bindTransforms;
+    std::vector<int> boneIds;
+    std::vector<glm::mat4> offsets;
+    std::vector<int> trackOfNode;
+    std::vector<std::string> names;
+
+    std::vector<AnimationTrack> tracks;
+    std::vector<float> positionKeyTimes, rotationKeyTimes, scaleKeyTimes;
+    std::vector<glm::vec3> positionKeys, scaleKeys;
+    std::vector<glm::quat> rotationKeys;
+
+    int boneCount = 0;
+    float duration = 0.0f;
+    float ticksPerSecond = 25.0f;
+};
+
+// advances every state by dt and evaluates it into its own bonesPerState matrices of
+// boneMatrices, the characters split across threads. threadCount 0 uses every hardware thread
+void UpdateAnimations(AnimationState* states, int count, float dt, glm::mat4* boneMatrices, int bonesPerState,
+    unsigned int threadCount = 0)
+{
+    auto update = [=](int begin, int end)
+    {
+        for(int i = begin; i < end; ++i)
+        {
+            const AnimationClip* clip = states[i].clip;
+            if(clip)
+            {
+                clip->Advance(states[i], dt);
+                clip->Evaluate(states[i], boneMatrices + (size_t)i * bonesPerState, bonesPerState);
+            }
+        }
+    };
+    ParallelFor(count, ChunkCount(count, ANIMATION_MIN_STATES_PER_THREAD, threadCount), update);
+}
+
+#endif
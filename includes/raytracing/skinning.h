@@ -0,0 +1,318 @@
+#ifndef RAY_TRACING_SKINNING_H_
+#define RAY_TRACING_SKINNING_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "triangle_mesh.h"
+#include "mesh_bvh.h"
+#include "thread_pool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RAY_TRACING_SKINNING_SSE
+#endif
+
+// vertices per thread below which SkinVertices doesn't split the work further
+const int SKINNING_MIN_VERTICES_PER_THREAD = 4096;
+// dirty triangle runs closer than this are uploaded as one range
+const int SKINNING_UPLOAD_MERGE_GAP = 64;
+
+// a mesh in bind pose with up to four bone influences per vertex. vertices without any stay
+// where they are, ids of unused influences are 0 with weight 0
+struct SkinnedMesh
+{
+    TriangleMesh bind;
+    std::vector<glm::ivec4> boneIds;
+    std::vector<glm::vec4> weights;
+};
+
+// vertices with Position, Normal, TexCoords, m_BoneIDs and m_Weights, like learnopengl's Vertex.
+// influences with a negative id are dropped, the rest are normalized to sum to one
+template<typename SkinVertex>
+void AppendSkinnedVertices(SkinnedMesh& mesh, const std::vector<SkinVertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    unsigned int first = (unsigned int)mesh.bind.positions.size();
+    for(const SkinVertex& vertex : vertices)
+    {
+        mesh.bind.positions.push_back(vertex.Position);
+        mesh.bind.normals.push_back(vertex.Normal);
+        mesh.bind.uvs.push_back(vertex.TexCoords);
+        glm::ivec4 ids(0);
+        glm::vec4 weights(0.0f);
+        for(int k = 0; k < 4; ++k)
+        {
+            if(vertex.m_BoneIDs[k] >= 0 && vertex.m_Weights[k] > 0.0f)
+            {
+                ids[k] = vertex.m_BoneIDs[k];
+                weights[k] = vertex.m_Weights[k];
+            }
+        }
+        float sum = weights.x + weights.y + weights.z + weights.w;
+        mesh.boneIds.push_back(ids);
+        mesh.weights.push_back(sum > 0.0f ? weights / sum : weights);
+    }
+    for(unsigned int index : indices)
+    {
+        mesh.bind.indices.push_back(first + index);
+    }
+}
+
+// the meshes merged into one without influences, a static model in the same pipeline
+SkinnedMesh StaticSkinnedMesh(const std::vector<TriangleMesh>& meshes)
+{
+    SkinnedMesh skinned;
+    for(const TriangleMesh& mesh : meshes)
+    {
+        unsigned int first = (unsigned int)skinned.bind.positions.size();
+        skinned.bind.positions.insert(skinned.bind.positions.end(), mesh.positions.begin(), mesh.positions.end());
+        skinned.bind.normals.insert(skinned.bind.normals.end(), mesh.normals.begin(), mesh.normals.end());
+        skinned.bind.uvs.insert(skinned.bind.uvs.end(), mesh.uvs.begin(), mesh.uvs.end());
+        for(unsigned int index : mesh.indices)
+        {
+            skinned.bind.indices.push_back(first + index);
+        }
+    }
+    skinned.boneIds.assign(skinned.bind.positions.size(), glm::ivec4(0));
+    skinned.weights.assign(skinned.bind.positions.size(), glm::vec4(0.0f));
+    return skinned;
+}
+
+// binds the vertices to boneCount bones spaced evenly along the y extent of the mesh, each
+// vertex to the two nearest. for meshes that come without a skeleton
+void RigAlongY(SkinnedMesh& mesh, int boneCount)
+{
+    float low = 0.0f, high = 0.0f;
+    for(size_t v = 0; v < mesh.bind.positions.size(); ++v)
+    {
+        low = v == 0 ? mesh.bind.positions[v].y : std::min(low, mesh.bind.positions[v].y);
+        high = v == 0 ? mesh.bind.positions[v].y : std::max(high, mesh.bind.positions[v].y);
+    }
+    float span = std::max(high - low, 1e-6f);
+    for(size_t v = 0; v < mesh.bind.positions.size(); ++v)
+    {
+        float h = (mesh.bind.positions[v].y - low) / span * (boneCount - 1);
+        int bone = std::min((int)h, boneCount - 2);
+        float t = glm::clamp(h - bone, 0.0f, 1.0f);
+        mesh.boneIds[v] = glm::ivec4(bone, bone + 1, 0, 0);
+        mesh.weights[v] = glm::vec4(1.0f - t, t, 0.0f, 0.0f);
+    }
+}
+
+// linear blend skinning of the listed vertices: the four bone matrices are blended by weight
+// and applied to position and normal. normals are renormalized, non uniform scale in the bones
+// is not corrected for
+void SkinVertices(const SkinnedMesh& mesh, const glm::mat4* bones, const int* vertices, int count,
+    glm::vec3* positions, glm::vec3* normals)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        int v = vertices[i];
+        const glm::ivec4& ids = mesh.boneIds[v];
+        const glm::vec4& w = mesh.weights[v];
+        const glm::vec3& p = mesh.bind.positions[v];
+        const glm::vec3& n = mesh.bind.normals[v];
+#if defined(RAY_TRACING_SKINNING_SSE)
+        // four columns of the blended matrix, one weighted add per bone
+        __m128 column[4];
+        for(int c = 0; c < 4; ++c)
+        {
+            column[c] = _mm_mul_ps(_mm_loadu_ps(&bones[ids.x][c][0]), _mm_set1_ps(w.x));
+            column[c] = _mm_add_ps(column[c], _mm_mul_ps(_mm_loadu_ps(&bones[ids.y][c][0]), _mm_set1_ps(w.y)));
+            column[c] = _mm_add_ps(column[c], _mm_mul_ps(_mm_loadu_ps(&bones[ids.z][c][0]), _mm_set1_ps(w.z)));
+            column[c] = _mm_add_ps(column[c], _mm_mul_ps(_mm_loadu_ps(&bones[ids.w][c][0]), _mm_set1_ps(w.w)));
+        }
+        __m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column[0], _mm_set1_ps(n.x)), _mm_mul_ps(column[1], _mm_set1_ps(n.y))),
+            _mm_mul_ps(column[2], _mm_set1_ps(n.z)));
+        __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column[0], _mm_set1_ps(p.x)), _mm_mul_ps(column[1], _mm_set1_ps(p.y))),
+            _mm_add_ps(_mm_mul_ps(column[2], _mm_set1_ps(p.z)), column[3]));
+        float out[4];
+        _mm_storeu_ps(out, position);
+        positions[v] = glm::vec3(out[0], out[1], out[2]);
+        _mm_storeu_ps(out, normal);
+        glm::vec3 skinned(out[0], out[1], out[2]);
+        normals[v] = skinned / std::max(glm::length(skinned), 1e-10f);
+#else
+        glm::mat4 skin = bones[ids.x] * w.x + bones[ids.y] * w.y + bones[ids.z] * w.z + bones[ids.w] * w.w;
+        positions[v] = glm::vec3(skin * glm::vec4(p, 1.0f));
+        glm::vec3 normal = glm::vec3(skin * glm::vec4(n, 0.0f));
+        normals[v] = normal / std::max(glm::length(normal), 1e-10f);
+#endif
+    }
+}
+
+// a model as the tracer sees it: its triangles in the leaf order of its own bvh, three corners
+// each, [position, u] [normal, v] per corner. Update skins the vertices of the bones that moved,
+// refits the bvh and records which triangles changed, Upload sends only those
+class DeformableMesh
+{
+public:
+    // bvh built on the bind pose, boneCount bones of which Update gets the matrices
+    void Build(const SkinnedMesh& skinned, int boneCount)
+    {
+        mesh = skinned;
+        bones = boneCount;
+        int triangleCount = (int)mesh.bind.indices.size() / 3;
+        std::vector<glm::vec3> bindCorners(triangleCount * 3);
+        for(int c = 0; c < triangleCount * 3; ++c)
+        {
+            bindCorners[c] = mesh.bind.positions[mesh.bind.indices[c]];
+        }
+        std::vector<int> order;
+        bvh.Build(bindCorners.data(), triangleCount, order);
+        cornerVertices.resize(triangleCount * 3);
+        for(int t = 0; t < triangleCount; ++t)
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                cornerVertices[3 * t + c] = mesh.bind.indices[3 * order[t] + c];
+            }
+        }
+        positions = mesh.bind.positions;
+        normals = mesh.bind.normals;
+        cornerPositions.resize(cornerVertices.size());
+        cornerNormals.resize(cornerVertices.size());
+        for(size_t c = 0; c < cornerVertices.size(); ++c)
+        {
+            cornerPositions[c] = positions[cornerVertices[c]];
+            cornerNormals[c] = normals[cornerVertices[c]];
+        }
+        previousBones.assign(boneCount, glm::mat4(0.0f));
+        dirtyRanges.clear();
+        dirtyRanges.push_back({ 0, triangleCount });
+    }
+
+    // skins with the new bone matrices on threadCount threads (0 for every hardware thread).
+    // returns whether any vertex moved
+    bool Update(const glm::mat4* boneMatrices, unsigned int threadCount = 0)
+    {
+        std::vector<char> boneMoved(bones, 0);
+        bool anyMoved = false;
+        for(int b = 0; b < bones; ++b)
+        {
+            boneMoved[b] = std::memcmp(&boneMatrices[b], &previousBones[b], sizeof(glm::mat4)) != 0;
+            anyMoved = anyMoved || boneMoved[b];
+        }
+        if(!anyMoved)
+        {
+            return false;
+        }
+        std::copy(boneMatrices, boneMatrices + bones, previousBones.begin());
+
+        std::vector<char> vertexMoved(positions.size(), 0);
+        std::vector<int> moved;
+        for(int v = 0; v < (int)positions.size(); ++v)
+        {
+            const glm::ivec4& ids = mesh.boneIds[v];
+            const glm::vec4& w = mesh.weights[v];
+            if((w.x > 0.0f && boneMoved[ids.x]) || (w.y > 0.0f && boneMoved[ids.y])
+                || (w.z > 0.0f && boneMoved[ids.z]) || (w.w > 0.0f && boneMoved[ids.w]))
+            {
+                vertexMoved[v] = 1;
+                moved.push_back(v);
+            }
+        }
+        int count = (int)moved.size();
+        ParallelFor(count, ChunkCount(count, SKINNING_MIN_VERTICES_PER_THREAD, threadCount), [&](int begin, int end)
+        {
+            SkinVertices(mesh, boneMatrices, moved.data() + begin, end - begin, positions.data(), normals.data());
+        });
+
+        // the triangles with a moved corner, as runs in leaf order
+        dirtyRanges.clear();
+        int triangleCount = (int)cornerVertices.size() / 3;
+        for(int t = 0; t < triangleCount; ++t)
+        {
+            const unsigned int* corner = &cornerVertices[3 * t];
+            if(!vertexMoved[corner[0]] && !vertexMoved[corner[1]] && !vertexMoved[corner[2]])
+            {
+                continue;
+            }
+            for(int c = 3 * t; c < 3 * t + 3; ++c)
+            {
+                cornerPositions[c] = positions[cornerVertices[c]];
+                cornerNormals[c] = normals[cornerVertices[c]];
+            }
+            if(!dirtyRanges.empty() && t - (dirtyRanges.back().first + dirtyRanges.back().second) <= SKINNING_UPLOAD_MERGE_GAP)
+            {
+                dirtyRanges.back().second = t + 1 - dirtyRanges.back().first;
+            }
+            else
+            {
+                dirtyRanges.push_back({ t, 1 });
+            }
+        }
+        bvh.Refit(cornerPositions.data());
+        return true;
+    }
+
+    // the changed triangles into texels, six per triangle
+    void WriteTriangles(float (*texels)[4]) const
+    {
+        for(const std::pair<int, int>& range : dirtyRanges)
+        {
+            for(int c = 3 * range.first; c < 3 * (range.first + range.second); ++c)
+            {
+                unsigned int vertex = cornerVertices[c];
+                float* position = texels[2 * c];
+                float* normal = texels[2 * c + 1];
+                position[0] = cornerPositions[c].x;
+                position[1] = cornerPositions[c].y;
+                position[2] = cornerPositions[c].z;
+                position[3] = mesh.bind.uvs[vertex].x;
+                normal[0] = cornerNormals[c].x;
+                normal[1] = cornerNormals[c].y;
+                normal[2] = cornerNormals[c].z;
+                normal[3] = mesh.bind.uvs[vertex].y;
+            }
+        }
+    }
+
+    // writes the changed triangles and the whole bvh to the texel arrays and sends the changed
+    // ranges to the triangle buffer and the bvh to its buffer. returns the bytes uploaded
+    size_t Upload(unsigned int triangleBuffer, float (*triangleTexels)[4], unsigned int bvhBuffer, float (*bvhTexels)[4])
+    {
+        WriteTriangles(triangleTexels);
+        bvh.Pack(bvhTexels);
+        size_t bytes = 0;
+        glBindBuffer(GL_TEXTURE_BUFFER, triangleBuffer);
+        for(const std::pair<int, int>& range : dirtyRanges)
+        {
+            size_t offset = sizeof(float) * 4 * 6 * range.first, size = sizeof(float) * 4 * 6 * range.second;
+            glBufferSubData(GL_TEXTURE_BUFFER, offset, size, triangleTexels[6 * range.first]);
+            bytes += size;
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, bvhBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 2 * bvh.NodeCount(), bvhTexels);
+        bytes += sizeof(float) * 4 * 2 * bvh.NodeCount();
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        dirtyRanges.clear();
+        return bytes;
+    }
+
+    int TriangleCount() const { return (int)cornerVertices.size() / 3; }
+    int BoneCount() const { return bones; }
+    const MeshBVH& BVH() const { return bvh; }
+    // three per triangle in leaf order, the layout the G-buffer and the cost tracer take
+    const std::vector<glm::vec3>& CornerPositions() const { return cornerPositions; }
+    const std::vector<glm::vec3>& CornerNormals() const { return cornerNormals; }
+    // first triangle and triangle count of every run not uploaded yet
+    const std::vector<std::pair<int, int>>& DirtyRanges() const { return dirtyRanges; }
+
+private:
+    SkinnedMesh mesh;
+    int bones = 0;
+    MeshBVH bvh;
+    std::vector<unsigned int> cornerVertices;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec3> cornerPositions, cornerNormals;
+    std::vector<glm::mat4> previousBones;
+    std::vector<std::pair<int, int>> dirtyRanges;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef RAY_TRACING_TEXTURE_ARRAY_H_
+#define RAY_TRACING_TEXTURE_ARRAY_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "texture_mips.h"
+#include "texture_cache.h"
+
+// square layer sizes, every class is one sampler2DArray in the tracer
+const int TEXTURE_SIZE_CLASS_COUNT = 4;
+const int TEXTURE_SIZE_CLASSES[TEXTURE_SIZE_CLASS_COUNT] = { 256, 512, 1024, 2048 };
+
+// where a texture ended up: its class, its layer in that class and the part of the layer it
+// covers, uv in [0, 1] maps to [0, uvScale] of the layer
+struct TextureSlot
+{
+    int sizeClass;
+    int layer;
+    glm::vec2 uvScale;
+};
+
+// packs any number of textures into one sampler2DArray per size class so a whole scene samples
+// them through a handful of bindings instead of one sampler per model. an image is resized so
+// its long side is the smallest class that holds it (or the largest class), the short side is
+// padded by repeating the edge texels. square images fill their layer and still wrap with
+// GL_REPEAT, padded ones are wrapped in the shader before uvScale is applied.
+class TextureArrays
+{
+public:
+    TextureArrays()
+    {
+        for(int i = 0; i < TEXTURE_SIZE_CLASS_COUNT; ++i)
+        {
+            textures[i] = 0;
+            uploadedLayers[i] = 0;
+        }
+    }
+
+    ~TextureArrays()
+    {
+        glDeleteTextures(TEXTURE_SIZE_CLASS_COUNT, textures);
+    }
+
+    // loads the image once per path and returns its slot index, -1 when it can't be read
+    int Add(const std::string& path)
+    {
+        auto found = slotByPath.find(path);
+        if(found != slotByPath.end())
+        {
+            return found->second;
+        }
+        // the array builds its own mips after resizing, so only level 0 is loaded
+        std::shared_ptr<const CachedTexture> image = SharedTextureCache().Load(path, TextureEncoding::RGBA8, false);
+        if(!image)
+        {
+            return -1;
+        }
+        int slot = Add(image->levels[0].data.data(), image->Width(), image->Height());
+        slotByPath[path] = slot;
+        return slot;
+    }
+
+    // rgba is width * height RGBA8 texels
+    int Add(const unsigned char* rgba, int width, int height)
+    {
+        int sizeClass = TEXTURE_SIZE_CLASS_COUNT - 1;
+        for(int i = 0; i < TEXTURE_SIZE_CLASS_COUNT; ++i)
+        {
+            if(std::max(width, height) <= TEXTURE_SIZE_CLASSES[i])
+            {
+                sizeClass = i;
+                break;
+            }
+        }
+        int size = TEXTURE_SIZE_CLASSES[sizeClass];
+        float scale = (float)size / std::max(width, height);
+        int scaledWidth = std::max(1, std::min(size, (int)std::round(width * scale)));
+        int scaledHeight = std::max(1, std::min(size, (int)std::round(height * scale)));
+
+        TextureSlot slot = { sizeClass, (int)layers[sizeClass].size(),
+            glm::vec2((float)scaledWidth / size, (float)scaledHeight / size) };
+        layers[sizeClass].push_back(ResizeAndPad(rgba, width, height, scaledWidth, scaledHeight, size));
+        slots.push_back(slot);
+        return (int)slots.size() - 1;
+    }
+
+    // (re)creates the arrays of the classes that gained images since the last Upload, with CPU
+    // built mip chains. an array can't grow in place, so the images stay staged for the next one
+    void Upload()
+    {
+        for(int c = 0; c < TEXTURE_SIZE_CLASS_COUNT; ++c)
+        {
+            if((int)layers[c].size() == uploadedLayers[c])
+            {
+                continue;
+            }
+            int size = TEXTURE_SIZE_CLASSES[c];
+            int layerCount = (int)layers[c].size();
+            int levelCount = 1;
+            while((size >> (levelCount - 1)) > 1)
+            {
+                ++levelCount;
+            }
+            glDeleteTextures(1, &textures[c]);
+            glGenTextures(1, &textures[c]);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textures[c]);
+            for(int level = 0; level < levelCount; ++level)
+            {
+                int levelSize = std::max(1, size >> level);
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelSize, levelSize, layerCount, 0,
+                    GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for(int layer = 0; layer < layerCount; ++layer)
+            {
+                MipChain chain;
+                chain.Build(layers[c][layer].data(), size, size);
+                for(int level = 0; level < chain.LevelCount(); ++level)
+                {
+                    const MipLevel& mip = chain.levels[level];
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, mip.rgba.data());
+                }
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            uploadedLayers[c] = layerCount;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // class i goes to texture unit firstUnit + i, classes without textures bind nothing
+    void Bind(int firstUnit) const
+    {
+        for(int c = 0; c < TEXTURE_SIZE_CLASS_COUNT; ++c)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + c);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textures[c]);
+        }
+    }
+
+    std::vector<TextureSlot> slots;
+    unsigned int textures[TEXTURE_SIZE_CLASS_COUNT];
+
+private:
+    // bilinear resize to scaledWidth x scaledHeight in the corner of a size x size layer,
+    // the rest of the layer repeats the last row and column
+    static std::vector<unsigned char> ResizeAndPad(const unsigned char* rgba, int width, int height,
+        int scaledWidth, int scaledHeight, int size)
+    {
+        std::vector<unsigned char> layer(size * size * 4);
+        for(int y = 0; y < size; ++y)
+        {
+            float sy = ((std::min(y, scaledHeight - 1) + 0.5f) * height) / scaledHeight - 0.5f;
+            int y0 = glm::clamp((int)std::floor(sy), 0, height - 1);
+            int y1 = std::min(y0 + 1, height - 1);
+            float fy = glm::clamp(sy - y0, 0.0f, 1.0f);
+            for(int x = 0; x < size; ++x)
+            {
+                float sx = ((std::min(x, scaledWidth - 1) + 0.5f) * width) / scaledWidth - 0.5f;
+                int x0 = glm::clamp((int)std::floor(sx), 0, width - 1);
+                int x1 = std::min(x0 + 1, width - 1);
+                float fx = glm::clamp(sx - x0, 0.0f, 1.0f);
+                for(int c = 0; c < 4; ++c)
+                {
+                    float bottom = glm::mix((float)rgba[(y0 * width + x0) * 4 + c], (float)rgba[(y0 * width + x1) * 4 + c], fx);
+                    float top = glm::mix((float)rgba[(y1 * width + x0) * 4 + c], (float)rgba[(y1 * width + x1) * 4 + c], fx);
+                    layer[(y * size + x) * 4 + c] = (unsigned char)(glm::mix(bottom, top, fy) + 0.5f);
+                }
+            }
+        }
+        return layer;
+    }
+
+    std::vector<std::vector<unsigned char>> layers[TEXTURE_SIZE_CLASS_COUNT];
+    int uploadedLayers[TEXTURE_SIZE_CLASS_COUNT];
+    std::map<std::string, int> slotByPath;
+};
+
+#endif
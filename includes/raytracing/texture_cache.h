@@ -0,0 +1,506 @@
+#ifndef RAY_TRACING_TEXTURE_CACHE_H_
+#define RAY_TRACING_TEXTURE_CACHE_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "texture_mips.h"
+#include "mapped_file.h"
+#include "hash.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// where a demo that wants decoded textures kept between runs points TextureCache::directory,
+// one file per content hash, size and encoding
+const char* const TEXTURE_CACHE_DIR = "texture_cache";
+
+enum class TextureEncoding
+{
+    RGBA8,
+    // 4x4 blocks of 8 bytes, opaque, an eighth of RGBA8
+    BC1
+};
+
+struct CachedLevel
+{
+    int width, height;
+    std::vector<unsigned char> data;
+};
+
+// a full mip chain of one image, or level 0 alone, ready for glTexImage2D or glCompressedTexImage2D
+struct CachedTexture
+{
+    uint64_t contentHash = 0;
+    uint64_t contentSize = 0;
+    TextureEncoding encoding = TextureEncoding::RGBA8;
+    bool mipmapped = true;
+    std::vector<CachedLevel> levels;
+
+    int Width() const { return levels.empty() ? 0 : levels[0].width; }
+    int Height() const { return levels.empty() ? 0 : levels[0].height; }
+};
+
+// 8 bytes at a time, each word mixed in through the finalizer so a change in its high bits
+// moves the whole hash, the tail zero padded and the size last
+uint64_t HashTextureBytes(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = SplitMix64(hash ^ word);
+    }
+    if(i < size)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, size - i);
+        hash = SplitMix64(hash ^ word);
+    }
+    return SplitMix64(hash ^ (uint64_t)size);
+}
+
+inline uint16_t ToRGB565(const glm::ivec3& c)
+{
+    return (uint16_t)(((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3));
+}
+
+inline glm::ivec3 FromRGB565(uint16_t c)
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return glm::ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// BC1 with the endpoints at the corners of each block's color bounding box, every texel takes
+// the nearest of the four palette colors. blocks past the image edge repeat the last texels
+void CompressBC1(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& blocks)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    blocks.resize(blocksX * blocksY * 8);
+    for(int by = 0; by < blocksY; ++by)
+    {
+        for(int bx = 0; bx < blocksX; ++bx)
+        {
+            glm::ivec3 texels[16];
+            glm::ivec3 low(255), high(0);
+            for(int i = 0; i < 16; ++i)
+            {
+                int x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                const unsigned char* p = rgba + (y * width + x) * 4;
+                texels[i] = glm::ivec3(p[0], p[1], p[2]);
+                low = glm::min(low, texels[i]);
+                high = glm::max(high, texels[i]);
+            }
+            uint16_t c0 = ToRGB565(high), c1 = ToRGB565(low);
+            uint32_t indices = 0;
+            // c0 > c1 selects the four color mode, equal endpoints leave every index at 0
+            if(c0 < c1)
+            {
+                std::swap(c0, c1);
+            }
+            if(c0 != c1)
+            {
+                glm::ivec3 e0 = FromRGB565(c0), e1 = FromRGB565(c1);
+                glm::ivec3 palette[4] = { e0, e1, (2 * e0 + e1) / 3, (e0 + 2 * e1) / 3 };
+                for(int i = 0; i < 16; ++i)
+                {
+                    int best = 0, bestDistance = INT32_MAX;
+                    for(int k = 0; k < 4; ++k)
+                    {
+                        glm::ivec3 d = texels[i] - palette[k];
+                        int distance = d.r * d.r + d.g * d.g + d.b * d.b;
+                        if(distance < bestDistance)
+                        {
+                            best = k;
+                            bestDistance = distance;
+                        }
+                    }
+                    indices |= (uint32_t)best << (2 * i);
+                }
+            }
+            unsigned char* block = &blocks[(by * blocksX + bx) * 8];
+            std::memcpy(block, &c0, 2);
+            std::memcpy(block + 2, &c1, 2);
+            std::memcpy(block + 4, &indices, 4);
+        }
+    }
+}
+
+bool HasS3TCSupport()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for(GLint i = 0; i < count; ++i)
+    {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// one texture cache for the whole process, so models and the skybox share what they load.
+// images are keyed by the hash and size of their file contents: a path is read and hashed once
+// per run, the same image under another path is the same entry, and with a directory set the
+// decoded mip chain is kept there so the next run reads it back instead of decoding it again.
+// Load is thread safe and meant for loader threads, the GL functions belong on the GL thread
+class TextureCache
+{
+public:
+    explicit TextureCache(const std::string& directory = ""): directory(directory) {}
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // the mip chain of the image at path, level 0 alone without mipmaps, nullptr when it can't be
+    // read. errors go to log
+    std::shared_ptr<const CachedTexture> Load(const std::string& path, TextureEncoding encoding, bool mipmaps = true,
+        std::ostream& log = std::cout)
+    {
+        std::string key = path + (encoding == TextureEncoding::BC1 ? "#bc1" : "#rgba") + (mipmaps ? "" : "#base");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = byPath.find(key);
+            if(found != byPath.end())
+            {
+                ++memoryHits;
+                return found->second;
+            }
+        }
+        MappedFile file;
+        if(!file.Open(path) || file.Size() == 0)
+        {
+            log << "Texture failed to load at path: " << path << std::endl;
+            return nullptr;
+        }
+        uint64_t contentHash = HashTextureBytes((const unsigned char*)file.Data(), file.Size());
+        uint64_t contentSize = file.Size();
+        std::string entryKey = EntryKey(contentHash, contentSize, encoding, mipmaps);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = byHash.find(entryKey);
+            if(found != byHash.end())
+            {
+                ++memoryHits;
+                byPath[key] = found->second;
+                return found->second;
+            }
+        }
+        // nothing in memory, decode only when the store has nothing either
+        std::shared_ptr<CachedTexture> texture = std::make_shared<CachedTexture>();
+        std::string storePath = directory + "/" + entryKey;
+        if(ReadStore(storePath, contentHash, contentSize, encoding, mipmaps, *texture))
+        {
+            ++diskHits;
+        }
+        else
+        {
+            int width, height, nrComponents;
+            unsigned char* data = stbi_load_from_memory((const stbi_uc*)file.Data(), (int)file.Size(), &width, &height, &nrComponents, 4);
+            if(!data)
+            {
+                log << "Texture failed to load at path: " << path << std::endl;
+                return nullptr;
+            }
+            MipChain chain;
+            if(mipmaps)
+            {
+                chain.Build(data, width, height);
+            }
+            else
+            {
+                chain.levels.push_back({ width, height, std::vector<unsigned char>(data, data + width * height * 4) });
+            }
+            stbi_image_free(data);
+            texture->contentHash = contentHash;
+            texture->contentSize = contentSize;
+            texture->encoding = encoding;
+            texture->mipmapped = mipmaps;
+            for(MipLevel& level : chain.levels)
+            {
+                CachedLevel cached = { level.width, level.height, {} };
+                if(encoding == TextureEncoding::BC1)
+                {
+                    CompressBC1(level.rgba.data(), level.width, level.height, cached.data);
+                }
+                else
+                {
+                    cached.data = std::move(level.rgba);
+                }
+                texture->levels.push_back(std::move(cached));
+            }
+            WriteStore(storePath, *texture, log);
+            ++decodes;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        // another thread may have loaded the same image meanwhile, everyone shares the first
+        auto inserted = byHash.insert({ entryKey, texture });
+        byPath[key] = inserted.first->second;
+        return inserted.first->second;
+    }
+
+    // a mipmapped GL_TEXTURE_2D of the image, one per content for the whole process
+    unsigned int Texture2D(const std::string& path)
+    {
+        std::shared_ptr<const CachedTexture> texture = Load(path, PreferredEncoding());
+        if(!texture)
+        {
+            return 0;
+        }
+        std::string key = EntryKey(*texture);
+        auto found = glTextures.find(key);
+        if(found != glTextures.end())
+        {
+            return found->second;
+        }
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for(size_t level = 0; level < texture->levels.size(); ++level)
+        {
+            UploadLevel(GL_TEXTURE_2D, (GLint)level, *texture, texture->levels[level]);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture->levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextures[key] = textureID;
+        return textureID;
+    }
+
+    // a cube map from six images in +x -x +y -y +z -z order, loaded here or handed over by a
+    // loader thread. one per combination of contents, 0 if a face is missing. the tracers sample
+    // it along scattered rays where screen space derivatives mean nothing, so it has no mips and
+    // its faces are loaded without them
+    unsigned int Cubemap(const std::vector<std::string>& faces)
+    {
+        std::shared_ptr<const CachedTexture> images[6];
+        for(int i = 0; i < 6 && i < (int)faces.size(); ++i)
+        {
+            images[i] = Load(faces[i], PreferredEncoding(), false);
+        }
+        return Cubemap(images);
+    }
+
+    unsigned int Cubemap(const std::shared_ptr<const CachedTexture> faces[6])
+    {
+        std::string key = "cube";
+        for(int i = 0; i < 6; ++i)
+        {
+            if(!faces[i] || faces[i]->levels.empty())
+            {
+                return 0;
+            }
+            key += "/" + EntryKey(*faces[i]);
+        }
+        auto found = glTextures.find(key);
+        if(found != glTextures.end())
+        {
+            return found->second;
+        }
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        for(unsigned int i = 0; i < 6; ++i)
+        {
+            UploadLevel(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, *faces[i], faces[i]->levels[0]);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTextures[key] = textureID;
+        return textureID;
+    }
+
+    // BC1 when compression is on and the driver takes it, else RGBA8
+    TextureEncoding PreferredEncoding()
+    {
+        if(compress && s3tcSupport < 0)
+        {
+            s3tcSupport = HasS3TCSupport() ? 1 : 0;
+        }
+        return compress && s3tcSupport == 1 ? TextureEncoding::BC1 : TextureEncoding::RGBA8;
+    }
+
+    void PrintStats(std::ostream& out) const
+    {
+        out << "texture cache: " << memoryHits << " memory hits, " << diskHits << " disk hits, "
+            << decodes << " decodes, " << glTextures.size() << " GL textures" << std::endl;
+    }
+
+    std::string directory;
+    // compress textures for the GPU to BC1, decided before the first load so a cubemap queried
+    // from a loader thread and one made on the GL thread agree. needs GL_EXT_texture_compression_s3tc
+    bool compress = false;
+
+private:
+    struct StoreHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t encoding;
+        uint32_t levelCount;
+        uint64_t contentHash;
+        uint64_t contentSize;
+    };
+
+    static void UploadLevel(GLenum target, GLint level, const CachedTexture& texture, const CachedLevel& cached)
+    {
+        if(texture.encoding == TextureEncoding::BC1)
+        {
+            glCompressedTexImage2D(target, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, cached.width, cached.height, 0,
+                (GLsizei)cached.data.size(), cached.data.data());
+        }
+        else
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(target, level, GL_RGBA8, cached.width, cached.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, cached.data.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+    }
+
+    // names the entry in memory and its file in the store
+    static std::string EntryKey(uint64_t contentHash, uint64_t contentSize, TextureEncoding encoding, bool mipmaps)
+    {
+        char name[48];
+        std::snprintf(name, sizeof(name), "%016llx-%llx", (unsigned long long)contentHash, (unsigned long long)contentSize);
+        return name + std::string(mipmaps ? "" : ".base") + (encoding == TextureEncoding::BC1 ? ".bc1" : ".rgba");
+    }
+
+    static std::string EntryKey(const CachedTexture& texture)
+    {
+        return EntryKey(texture.contentHash, texture.contentSize, texture.encoding, texture.mipmapped);
+    }
+
+    static size_t LevelBytes(TextureEncoding encoding, int width, int height)
+    {
+        return encoding == TextureEncoding::BC1 ? (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8 : (size_t)width * height * 4;
+    }
+
+    // a file written by another version, for other contents or cut short is ignored
+    bool ReadStore(const std::string& storePath, uint64_t contentHash, uint64_t contentSize, TextureEncoding encoding, bool mipmaps,
+        CachedTexture& texture) const
+    {
+        MappedFile file;
+        if(directory.empty() || !std::filesystem::exists(storePath) || !file.Open(storePath))
+        {
+            return false;
+        }
+        const char* p = file.Data();
+        const char* end = p + file.Size();
+        StoreHeader header;
+        if(file.Size() < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, p, sizeof(header));
+        p += sizeof(header);
+        if(std::memcmp(header.magic, "RTTC", 4) != 0 || header.version != 2 || header.encoding != (uint32_t)encoding
+            || header.contentHash != contentHash || header.contentSize != contentSize || header.levelCount > 32 || (!mipmaps && header.levelCount != 1))
+        {
+            return false;
+        }
+        texture.contentHash = contentHash;
+        texture.contentSize = contentSize;
+        texture.encoding = encoding;
+        texture.mipmapped = mipmaps;
+        texture.levels.resize(header.levelCount);
+        for(CachedLevel& level : texture.levels)
+        {
+            int32_t size[2];
+            if(end - p < (ptrdiff_t)sizeof(size))
+            {
+                return false;
+            }
+            std::memcpy(size, p, sizeof(size));
+            p += sizeof(size);
+            size_t bytes = LevelBytes(encoding, size[0], size[1]);
+            if(size[0] <= 0 || size[1] <= 0 || (size_t)(end - p) < bytes)
+            {
+                return false;
+            }
+            level.width = size[0];
+            level.height = size[1];
+            level.data.assign(p, p + bytes);
+            p += bytes;
+        }
+        return true;
+    }
+
+    // written to a temporary name and renamed, a reader never sees half a file
+    void WriteStore(const std::string& storePath, const CachedTexture& texture, std::ostream& log) const
+    {
+        if(directory.empty())
+        {
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string temporaryPath = storePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            if(!file)
+            {
+                log << "ERROR::TEXTURE_CACHE::NOT_WRITABLE: " << storePath << std::endl;
+                return;
+            }
+            StoreHeader header = { { 'R', 'T', 'T', 'C' }, 2, (uint32_t)texture.encoding, (uint32_t)texture.levels.size(),
+                texture.contentHash, texture.contentSize };
+            file.write((const char*)&header, sizeof(header));
+            for(const CachedLevel& level : texture.levels)
+            {
+                int32_t size[2] = { level.width, level.height };
+                file.write((const char*)size, sizeof(size));
+                file.write((const char*)level.data.data(), level.data.size());
+            }
+        }
+        std::filesystem::rename(temporaryPath, storePath, error);
+        if(error)
+        {
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CachedTexture>> byPath;
+    std::unordered_map<std::string, std::shared_ptr<const CachedTexture>> byHash;
+    // GL thread only. the textures live as long as the process, as the context does
+    std::unordered_map<std::string, unsigned int> glTextures;
+    int s3tcSupport = -1;
+    // counted by loader threads outside the lock
+    std::atomic<int> memoryHits{ 0 }, diskHits{ 0 }, decodes{ 0 };
+};
+
+// the process wide cache. it keeps nothing on disk unless a demo sets its directory
+TextureCache& SharedTextureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+#endif
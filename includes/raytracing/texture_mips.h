@@ -0,0 +1,161 @@
+#ifndef RAY_TRACING_TEXTURE_MIPS_H_
+#define RAY_TRACING_TEXTURE_MIPS_H_
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+// the implementation part of stb_image has no guard, skip it when model.h already pulled it in
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+
+// one level of a mip chain, tightly packed RGBA8
+struct MipLevel
+{
+    int width, height;
+    std::vector<unsigned char> rgba;
+};
+
+// a full mip chain built on the CPU with a 2x2 box filter. the tracer picks its own level of
+// detail from the ray cone instead of screen space derivatives, so the levels are made here
+// once and uploaded explicitly, and the CPU side can sample the exact same data with SampleLod.
+class MipChain
+{
+public:
+    bool Load(const std::string& path)
+    {
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 4);
+        if(!data)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+        Build(data, width, height);
+        stbi_image_free(data);
+        return true;
+    }
+
+    // rgba is width * height RGBA8 texels, level 0 is a copy of it
+    void Build(const unsigned char* rgba, int width, int height)
+    {
+        levels.clear();
+        levels.push_back({ width, height, std::vector<unsigned char>(rgba, rgba + width * height * 4) });
+        while(levels.back().width > 1 || levels.back().height > 1)
+        {
+            levels.push_back(Downsample(levels.back()));
+        }
+    }
+
+    // uploads every level into texture as a GL_TEXTURE_2D with trilinear filtering
+    void Upload(unsigned int texture) const
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for(size_t level = 0; level < levels.size(); ++level)
+        {
+            const MipLevel& mip = levels[level];
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip.rgba.data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // trilinear lookup at an explicit level of detail with repeat wrapping, like textureLod
+    glm::vec4 SampleLod(glm::vec2 uv, float lod) const
+    {
+        if(levels.empty())
+        {
+            return glm::vec4(0.0f);
+        }
+        lod = glm::clamp(lod, 0.0f, (float)(levels.size() - 1));
+        int level = (int)lod;
+        float frac = lod - level;
+        glm::vec4 color = Bilinear(levels[level], uv);
+        if(frac > 0.0f && level + 1 < (int)levels.size())
+        {
+            color = glm::mix(color, Bilinear(levels[level + 1], uv), frac);
+        }
+        return color;
+    }
+
+    int LevelCount() const { return (int)levels.size(); }
+    int Width() const { return levels.empty() ? 0 : levels[0].width; }
+    int Height() const { return levels.empty() ? 0 : levels[0].height; }
+
+    std::vector<MipLevel> levels;
+
+private:
+    // odd sizes round down and the last row or column is folded into its neighbour
+    static MipLevel Downsample(const MipLevel& src)
+    {
+        MipLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.rgba.resize(dst.width * dst.height * 4);
+        for(int y = 0; y < dst.height; ++y)
+        {
+            int y0 = std::min(2 * y, src.height - 1);
+            int y1 = std::min(2 * y + 1, src.height - 1);
+            for(int x = 0; x < dst.width; ++x)
+            {
+                int x0 = std::min(2 * x, src.width - 1);
+                int x1 = std::min(2 * x + 1, src.width - 1);
+                for(int c = 0; c < 4; ++c)
+                {
+                    int sum = src.rgba[(y0 * src.width + x0) * 4 + c] + src.rgba[(y0 * src.width + x1) * 4 + c]
+                        + src.rgba[(y1 * src.width + x0) * 4 + c] + src.rgba[(y1 * src.width + x1) * 4 + c];
+                    dst.rgba[(y * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return dst;
+    }
+
+    static glm::vec4 Texel(const MipLevel& mip, int x, int y)
+    {
+        x = ((x % mip.width) + mip.width) % mip.width;
+        y = ((y % mip.height) + mip.height) % mip.height;
+        const unsigned char* p = &mip.rgba[(y * mip.width + x) * 4];
+        return glm::vec4(p[0], p[1], p[2], p[3]) / 255.0f;
+    }
+
+    static glm::vec4 Bilinear(const MipLevel& mip, glm::vec2 uv)
+    {
+        float x = uv.x * mip.width - 0.5f;
+        float y = uv.y * mip.height - 0.5f;
+        int x0 = (int)std::floor(x);
+        int y0 = (int)std::floor(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        glm::vec4 bottom = glm::mix(Texel(mip, x0, y0), Texel(mip, x0 + 1, y0), fx);
+        glm::vec4 top = glm::mix(Texel(mip, x0, y0 + 1), Texel(mip, x0 + 1, y0 + 1), fx);
+        return glm::mix(bottom, top, fy);
+    }
+};
+
+// loads an image as RGBA with a CPU built mip chain, returns the texture id (0 on failure)
+unsigned int LoadMipmappedTexture(const std::string& path)
+{
+    MipChain chain;
+    if(!chain.Load(path))
+    {
+        return 0;
+    }
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    chain.Upload(textureID);
+    return textureID;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef RAY_TRACING_THREAD_POOL_H_
+#define RAY_TRACING_THREAD_POOL_H_
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+// a fixed set of worker threads running jobs in submission order. jobs still queued when the
+// pool is destroyed are dropped, running ones are waited for
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if(threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for(unsigned int i = 0; i < threadCount; ++i)
+        {
+            workers.emplace_back([this]() { Work(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+        wake.notify_all();
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    unsigned int ThreadCount() const { return (unsigned int)workers.size(); }
+
+private:
+    void Work()
+    {
+        while(true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if(stopping)
+                {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// the process wide pool ParallelFor runs on, one worker per hardware thread, started the
+// first time it is needed so per-frame work never creates threads
+ThreadPool& SharedThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+// how many chunks ParallelFor should cut count items into: one per thread but none smaller
+// than minPerChunk. threadCount 0 uses every hardware thread
+int ChunkCount(int count, int minPerChunk, unsigned int threadCount = 0)
+{
+    if(threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max(1, std::min((int)threadCount, count / std::max(1, minPerChunk)));
+}
+
+// runs work(first, last) over [0, count) cut into chunkCount contiguous chunks and returns
+// once every chunk is done. the calling thread takes chunks as well as the shared pool, so it
+// never waits on a chunk nobody has started, even when the pool is busy or this is nested
+template<typename TWork>
+void ParallelFor(int count, int chunkCount, const TWork& work)
+{
+    chunkCount = std::max(1, std::min(chunkCount, count));
+    if(chunkCount <= 1)
+    {
+        work(0, count);
+        return;
+    }
+    struct Progress
+    {
+        std::atomic<int> next{ 0 };
+        int done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    // a pool job can start after the call returned, it then finds no chunk left and never
+    // touches work
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    auto run = [progress, count, chunkCount, &work]()
+    {
+        int chunk;
+        while((chunk = progress->next++) < chunkCount)
+        {
+            work((int)((int64_t)count * chunk / chunkCount), (int)((int64_t)count * (chunk + 1) / chunkCount));
+            std::lock_guard<std::mutex> lock(progress->mutex);
+            if(++progress->done == chunkCount)
+            {
+                progress->finished.notify_all();
+            }
+        }
+    };
+    ThreadPool& pool = SharedThreadPool();
+    int helpers = std::min(chunkCount - 1, (int)pool.ThreadCount());
+    for(int i = 0; i < helpers; ++i)
+    {
+        pool.Submit(run);
+    }
+    run();
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&progress, chunkCount]() { return progress->done == chunkCount; });
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef RAY_TRACING_TILE_SCHEDULER_H_
+#define RAY_TRACING_TILE_SCHEDULER_H_
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+// splits the render target into square tiles and traces only as many of them per frame as
+// fit the time budget, so a heavy scene never stalls a frame for long and every draw stays
+// short. the cost of a tile is learned from GL_TIME_ELAPSED queries around each slice,
+// read back a few frames late like GpuFrameTimer so nothing waits on the gpu.
+// tiles are handed out in rows from the bottom, a full sweep over the screen is one pass.
+class TileScheduler
+{
+public:
+    TileScheduler(int width, int height, int tileSize, float budgetMs):
+    tileSize(tileSize), budgetMs(budgetMs), smoothing(0.2f),
+    msPerTile(-1.0f), lastSliceMs(-1.0f), tilesPerSlice(1), sliceBegin(0), sliceEnd(0), cursor(0),
+    passComplete(false), current(0)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+        for(int i = 0; i < QUERY_COUNT; ++i)
+        {
+            queryTiles[i] = 0;
+        }
+        Resize(width, height);
+    }
+
+    ~TileScheduler()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+    // a new target size starts a new pass
+    void Resize(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+        tilesX = (width + tileSize - 1) / tileSize;
+        tilesY = (height + tileSize - 1) / tileSize;
+        Restart();
+    }
+
+    // throws away the pass in flight, e.g. when the camera moved
+    void Restart()
+    {
+        cursor = 0;
+    }
+
+    // picks the tiles of this frame and starts timing them. scissor testing is on until EndSlice
+    int BeginSlice()
+    {
+        if(queryTiles[current] > 0)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+            lastSliceMs = elapsed * 1e-6f;
+            float sample = lastSliceMs / queryTiles[current];
+            msPerTile = msPerTile < 0.0f ? sample : msPerTile + smoothing * (sample - msPerTile);
+        }
+        if(msPerTile > 0.0f)
+        {
+            tilesPerSlice = std::max(1, std::min(TileCount(), (int)(budgetMs / msPerTile)));
+        }
+
+        sliceBegin = cursor;
+        sliceEnd = std::min(cursor + tilesPerSlice, TileCount());
+        glEnable(GL_SCISSOR_TEST);
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+        return sliceEnd - sliceBegin;
+    }
+
+    // scissors the i-th tile of the slice
+    void ScissorTile(int i) const
+    {
+        int tile = sliceBegin + i;
+        int x = (tile % tilesX) * tileSize;
+        int y = (tile / tilesX) * tileSize;
+        glScissor(x, y, std::min(tileSize, width - x), std::min(tileSize, height - y));
+    }
+
+    // pixels covered by the current slice
+    int SlicePixels() const
+    {
+        int pixels = 0;
+        for(int tile = sliceBegin; tile < sliceEnd; ++tile)
+        {
+            int x = (tile % tilesX) * tileSize;
+            int y = (tile / tilesX) * tileSize;
+            pixels += std::min(tileSize, width - x) * std::min(tileSize, height - y);
+        }
+        return pixels;
+    }
+
+    void EndSlice()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        glDisable(GL_SCISSOR_TEST);
+        queryTiles[current] = sliceEnd - sliceBegin;
+        current = (current + 1) % QUERY_COUNT;
+        passComplete = sliceEnd == TileCount();
+        cursor = passComplete ? 0 : sliceEnd;
+    }
+
+    // the last slice traced the final tile of a pass
+    bool PassComplete() const { return passComplete; }
+    int TileCount() const { return tilesX * tilesY; }
+    int TilesPerSlice() const { return tilesPerSlice; }
+    // most recent finished slice time, negative until the first one arrives
+    float LastSliceMs() const { return lastSliceMs; }
+    float MsPerTile() const { return msPerTile; }
+
+    int tileSize;
+    float budgetMs;
+    // weight of a new measurement in the per-tile cost
+    float smoothing;
+
+private:
+    static const int QUERY_COUNT = 4;
+    unsigned int queries[QUERY_COUNT];
+    int queryTiles[QUERY_COUNT];
+    int width, height;
+    int tilesX, tilesY;
+    float msPerTile;
+    float lastSliceMs;
+    int tilesPerSlice;
+    int sliceBegin, sliceEnd;
+    int cursor;
+    bool passComplete;
+    int current;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef RAY_TRACING_TRAVERSAL_COST_H_
+#define RAY_TRACING_TRAVERSAL_COST_H_
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+
+#include "bvh.h"
+#include "hittable_list.h"
+#include "mesh_bvh.h"
+
+extern const int OBJ_SPHERE, OBJ_XYRECT, OBJ_XZRECT, OBJ_YZRECT, OBJ_MODEL;
+
+// traversal cost images are RGBA floats, one pixel per texel like the tracer output:
+// x nodes visited, y aabb hits, z primitive tests (spheres, rects and model triangles).
+// every node visited is one box test, so y counts the tests that passed
+const int COST_NODES = 0;
+const int COST_AABB_HITS = 1;
+const int COST_PRIMITIVE_TESTS = 2;
+
+struct TraversalStats
+{
+    float min, mean, max;
+    float p50, p95, p99;
+};
+
+// statistics of one channel of an RGBA cost image
+TraversalStats ComputeTraversalStats(const std::vector<float>& rgba, int channel)
+{
+    TraversalStats stats = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    std::vector<float> values;
+    values.reserve(rgba.size() / 4);
+    double sum = 0.0;
+    for(size_t i = channel; i < rgba.size(); i += 4)
+    {
+        values.push_back(rgba[i]);
+        sum += rgba[i];
+    }
+    if(values.empty())
+    {
+        return stats;
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](float p)
+    {
+        return values[std::min(values.size() - 1, (size_t)(p / 100.0f * (values.size() - 1) + 0.5f))];
+    };
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.mean = (float)(sum / values.size());
+    stats.p50 = percentile(50.0f);
+    stats.p95 = percentile(95.0f);
+    stats.p99 = percentile(99.0f);
+    return stats;
+}
+
+void PrintTraversalStats(const std::string& label, const std::vector<float>& rgba, std::ostream& out)
+{
+    const char* names[] = { "nodes", "aabb hits", "prim tests" };
+    out << label << std::endl;
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    for(int channel = 0; channel < 3; ++channel)
+    {
+        TraversalStats s = ComputeTraversalStats(rgba, channel);
+        out << "  " << std::left << std::setw(12) << names[channel] << std::right
+            << " min " << std::setw(7) << s.min << " mean " << std::setw(7) << s.mean << " max " << std::setw(7) << s.max
+            << "  p50 " << std::setw(7) << s.p50 << " p95 " << std::setw(7) << s.p95 << " p99 " << std::setw(7) << s.p99 << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+    out.precision(precision);
+}
+
+// reads a cost image back from the tracer's float target
+std::vector<float> ReadTraversalCost(unsigned int texture, int width, int height)
+{
+    std::vector<float> rgba(width * height * 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, rgba.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return rgba;
+}
+
+// CPU reference of the shader's WorldHitBVH: the same stack traversal over BVHNodes with the
+// same early outs, counting as it goes. it traces one primary ray through every pixel center,
+// so unlike the gpu image (all bounces of jittered samples) two runs are exactly comparable
+// and a change in bvh.h or in the mesh layout shows up as a change in the numbers.
+class TraversalCostTracer
+{
+public:
+    // triangles holds three model positions per triangle, empty when the scene has no model.
+    // with modelBVH they are in its leaf order and the model is traversed through it like the
+    // tracer does, without it every triangle is tested
+    TraversalCostTracer(HittableList& objects, const vector<BVHNode>& BVHNodes, int nodesHead,
+        const std::vector<glm::vec3>& triangles, const MeshBVH* modelBVH = nullptr):
+    objects(objects), BVHNodes(BVHNodes), nodesHead(nodesHead), triangles(triangles), modelBVH(modelBVH)
+    {
+    }
+
+    // camera parameters as in CameraConstructor of the tracer shader
+    std::vector<float> Trace(const glm::vec3& lookFrom, const glm::vec3& lookAt, const glm::vec3& vup,
+        float vfov, float aspectRatio, int width, int height) const
+    {
+        float h = std::tan(glm::radians(vfov) / 2.0f);
+        glm::vec3 w = glm::normalize(lookFrom - lookAt);
+        glm::vec3 u = glm::normalize(glm::cross(vup, w));
+        glm::vec3 v = glm::cross(w, u);
+        glm::vec3 horizontal = aspectRatio * 2.0f * h * u;
+        glm::vec3 vertical = 2.0f * h * v;
+        glm::vec3 lowerLeftCorner = lookFrom - horizontal / 2.0f - vertical / 2.0f - w;
+
+        std::vector<float> rgba(width * height * 4, 0.0f);
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                glm::vec2 uv((x + 0.5f) / width, (y + 0.5f) / height);
+                glm::vec3 direction = lowerLeftCorner + uv.x * horizontal + uv.y * vertical - lookFrom;
+                float* cost = &rgba[(y * width + x) * 4];
+                Traverse(lookFrom, direction, 0.001f, 100000.0f, cost);
+                cost[3] = 1.0f;
+            }
+        }
+        return rgba;
+    }
+
+private:
+    void Traverse(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float* cost) const
+    {
+        std::vector<int> stack;
+        float closestSoFar = tMax;
+        int curr = nodesHead;
+        while(curr != -1 || !stack.empty())
+        {
+            const BVHNode& node = BVHNodes[curr];
+            cost[COST_NODES] += 1.0f;
+            if(AABBHit(origin, direction, node.aabb, tMin, closestSoFar))
+            {
+                cost[COST_AABB_HITS] += 1.0f;
+                if(node.objectIndex != -1)
+                {
+                    float t;
+                    if(node.objectType == OBJ_MODEL && modelBVH)
+                    {
+                        TraverseModel(origin, direction, tMin, closestSoFar, cost);
+                    }
+                    else if(node.objectType == OBJ_MODEL)
+                    {
+                        for(size_t i = 0; i + 2 < triangles.size(); i += 3)
+                        {
+                            cost[COST_PRIMITIVE_TESTS] += 1.0f;
+                            if(TriangleHit(origin, direction, i, 0.001f, closestSoFar, t))
+                            {
+                                closestSoFar = t;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        cost[COST_PRIMITIVE_TESTS] += 1.0f;
+                        if(PrimitiveHit(*objects[node.objectIndex], origin, direction, tMin, closestSoFar, t))
+                        {
+                            closestSoFar = t;
+                        }
+                    }
+                    curr = Pop(stack);
+                }
+                else
+                {
+                    stack.push_back(node.right);
+                    curr = node.left;
+                }
+            }
+            else
+            {
+                curr = Pop(stack);
+            }
+        }
+    }
+
+    // the model's bvh as ModelHit in the tracer walks it
+    void TraverseModel(const glm::vec3& origin, const glm::vec3& direction, float tMin, float& closestSoFar, float* cost) const
+    {
+        if(modelBVH->nodes.empty())
+        {
+            return;
+        }
+        std::vector<int> stack;
+        int curr = 0;
+        while(curr != -1)
+        {
+            const MeshBVHNode& node = modelBVH->nodes[curr];
+            cost[COST_NODES] += 1.0f;
+            if(AABBHit(origin, direction, AABB(node.minimum, node.maximum), tMin, closestSoFar))
+            {
+                cost[COST_AABB_HITS] += 1.0f;
+                if(node.count == 0)
+                {
+                    stack.push_back(node.offset);
+                    curr = curr + 1;
+                    continue;
+                }
+                for(int i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    float t;
+                    cost[COST_PRIMITIVE_TESTS] += 1.0f;
+                    if(TriangleHit(origin, direction, 3 * i, 0.001f, closestSoFar, t))
+                    {
+                        closestSoFar = t;
+                    }
+                }
+            }
+            curr = Pop(stack);
+        }
+    }
+
+    static int Pop(std::vector<int>& stack)
+    {
+        if(stack.empty())
+        {
+            return -1;
+        }
+        int top = stack.back();
+        stack.pop_back();
+        return top;
+    }
+
+    static bool AABBHit(const glm::vec3& origin, const glm::vec3& direction, const AABB& aabb, float tMin, float tMax)
+    {
+        for(int a = 0; a < 3; ++a)
+        {
+            float invD = 1.0f / direction[a];
+            float t0 = (aabb.minimum[a] - origin[a]) * invD;
+            float t1 = (aabb.maximum[a] - origin[a]) * invD;
+            if(invD < 0.0f)
+            {
+                std::swap(t0, t1);
+            }
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+            if(tMax <= tMin)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool PrimitiveHit(const Hittable& object, const glm::vec3& origin, const glm::vec3& direction,
+        float tMin, float tMax, float& t)
+    {
+        if(object.objectType == OBJ_SPHERE)
+        {
+            glm::vec3 oc = origin - object.center;
+            float a = glm::dot(direction, direction);
+            float b = 2.0f * glm::dot(oc, direction);
+            float c = glm::dot(oc, oc) - object.radius * object.radius;
+            float discriminant = b * b - 4.0f * a * c;
+            if(discriminant <= 0.0f)
+            {
+                return false;
+            }
+            t = (-b - std::sqrt(discriminant)) / (2.0f * a);
+            if(t < tMax && t > tMin)
+            {
+                return true;
+            }
+            t = (-b + std::sqrt(discriminant)) / (2.0f * a);
+            return t < tMax && t > tMin;
+        }
+        // axis of the rect plane, then the two in-plane axes with their bounds
+        int axis, a0, a1;
+        float lo0, hi0, lo1, hi1;
+        if(object.objectType == OBJ_XYRECT)
+        {
+            axis = 2; a0 = 0; a1 = 1; lo0 = object.x0; hi0 = object.x1; lo1 = object.y0; hi1 = object.y1;
+        }
+        else if(object.objectType == OBJ_XZRECT)
+        {
+            axis = 1; a0 = 0; a1 = 2; lo0 = object.x0; hi0 = object.x1; lo1 = object.z0; hi1 = object.z1;
+        }
+        else if(object.objectType == OBJ_YZRECT)
+        {
+            axis = 0; a0 = 1; a1 = 2; lo0 = object.y0; hi0 = object.y1; lo1 = object.z0; hi1 = object.z1;
+        }
+        else
+        {
+            return false;
+        }
+        t = (object.k - origin[axis]) / direction[axis];
+        if(t < tMin || t > tMax)
+        {
+            return false;
+        }
+        float p0 = origin[a0] + t * direction[a0];
+        float p1 = origin[a1] + t * direction[a1];
+        return !(p0 < lo0 || p0 > hi0 || p1 < lo1 || p1 > hi1);
+    }
+
+    // moller-trumbore, the hit distance is the same as the shader's cramer solve
+    bool TriangleHit(const glm::vec3& origin, const glm::vec3& direction, size_t first,
+        float tMin, float tMax, float& t) const
+    {
+        glm::vec3 e1 = triangles[first + 1] - triangles[first];
+        glm::vec3 e2 = triangles[first + 2] - triangles[first];
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if(std::fabs(det) < 1e-5f)
+        {
+            return false;
+        }
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - triangles[first];
+        float b = glm::dot(s, p) * invDet;
+        glm::vec3 q = glm::cross(s, e1);
+        float c = glm::dot(direction, q) * invDet;
+        if(b < 0.0f || c < 0.0f || b + c > 1.0f)
+        {
+            return false;
+        }
+        t = glm::dot(e2, q) * invDet;
+        return t >= tMin && t <= tMax;
+    }
+
+    HittableList& objects;
+    const vector<BVHNode>& BVHNodes;
+    int nodesHead;
+    const std::vector<glm::vec3>& triangles;
+    const MeshBVH* modelBVH;
+};
+
+// shows one channel of a cost image as a false colour ramp, blue for cheap through red at maxCost
+class TraversalHeatmap
+{
+public:
+    TraversalHeatmap(const std::string& shaderDir):
+    heatmapShader((shaderDir + "/ray_tracing_optimize.vs").c_str(), (shaderDir + "/heatmap.fs").c_str()),
+    channel(COST_NODES), maxCost(200.0f)
+    {
+        heatmapShader.use();
+        heatmapShader.setInt("costTexture", 0);
+    }
+
+    void Draw(unsigned int quadVAO, unsigned int costTexture, int outputWidth, int outputHeight)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, outputWidth, outputHeight);
+        heatmapShader.use();
+        heatmapShader.setInt("channel", channel);
+        heatmapShader.setFloat("maxCost", maxCost);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, costTexture);
+        glBindVertexArray(quadVAO);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    Shader heatmapShader;
+    int channel;
+    float maxCost;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef RAY_TRACING_TRIANGLE_MESH_H_
+#define RAY_TRACING_TRIANGLE_MESH_H_
+
+#include <vector>
+#include <string>
+
+#include <glm/glm.hpp>
+
+// what the tracer reads from a mesh: positions, normals and uvs as separate arrays plus the
+// triangle indices. no GL objects, no tangents or bone data, 32 bytes per vertex instead of
+// the 88 of learnopengl's Vertex
+struct TriangleMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> indices;
+    // full path of the first diffuse texture, empty when the mesh has none
+    std::string diffusePath;
+
+    size_t VertexCount() const { return positions.size(); }
+    size_t TriangleCount() const { return indices.size() / 3; }
+    size_t Bytes() const
+    {
+        return positions.capacity() * sizeof(glm::vec3) + normals.capacity() * sizeof(glm::vec3)
+            + uvs.capacity() * sizeof(glm::vec2) + indices.capacity() * sizeof(unsigned int);
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef RAY_TRACING_WAVEFRONT_H_
+#define RAY_TRACING_WAVEFRONT_H_
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_c.h>
+#include <raytracing/profiler.h>
+
+// wavefront path tracer on GL 4.3 compute shaders. instead of one kernel running a whole
+// path per pixel, every bounce is split into stages that talk through ray queues in
+// shader storage buffers: extend finds the closest hit and sorts rays by material,
+// each material gets its own shading kernel, misses fetch the environment, and the
+// surviving rays form the next extend queue. queue sizes live in atomic counters and are
+// turned into indirect dispatch arguments on the gpu, so the cpu never waits for them.
+//
+// the scene is read from the same buffer textures as the fragment shader tracer:
+// objects on unit 0, bvh nodes on unit 1, triangles on unit 2 and the environment cube on unit 3.
+class WavefrontTracer
+{
+public:
+    // mirrors the queue ids in wavefront_common.glsl
+    enum Queue { QUEUE_EXTEND0, QUEUE_EXTEND1, QUEUE_LAMBERTIAN, QUEUE_METALLIC, QUEUE_DIELECTRIC, QUEUE_MISS, QUEUE_COUNT };
+
+    WavefrontTracer(int width, int height, int samplesPerPixel, const std::string& shaderDir):
+    generateShader(Sources(shaderDir, "wavefront_generate.comp")),
+    prepareShader(Sources(shaderDir, "wavefront_prepare.comp")),
+    extendShader(Sources(shaderDir, "wavefront_extend.comp")),
+    lambertianShader(Sources(shaderDir, "wavefront_shade_lambertian.comp")),
+    metallicShader(Sources(shaderDir, "wavefront_shade_metallic.comp")),
+    dielectricShader(Sources(shaderDir, "wavefront_shade_dielectric.comp")),
+    missShader(Sources(shaderDir, "wavefront_miss.comp")),
+    accumulateShader(Sources(shaderDir, "wavefront_accumulate.comp")),
+    width(width), height(height), samplesPerPixel(samplesPerPixel),
+    pathCount(width * height * samplesPerPixel), lastRayCount(0), profiler(nullptr), traceCount(0)
+    {
+        // counters: queue sizes, ray count, padding, then one uvec4 of dispatch arguments per queue
+        glGenBuffers(1, &counterBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, COUNTER_BYTES, NULL, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &pathBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pathBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)pathCount * PATH_BYTES, NULL, GL_DYNAMIC_COPY);
+        glGenBuffers(1, &hitBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, hitBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)pathCount * HIT_BYTES, NULL, GL_DYNAMIC_COPY);
+        glGenBuffers(1, &queueBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, queueBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)pathCount * QUEUE_COUNT * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glGenBuffers(RAY_COUNT_DELAY, rayCountBuffers);
+        for(int i = 0; i < RAY_COUNT_DELAY; ++i)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, rayCountBuffers[i]);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int), NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glGenTextures(1, &outputTexture);
+        glBindTexture(GL_TEXTURE_2D, outputTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &outputFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outputTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        const ComputeShader* all[] = { &generateShader, &prepareShader, &extendShader, &lambertianShader,
+            &metallicShader, &dielectricShader, &missShader, &accumulateShader };
+        for(const ComputeShader* shader : all)
+        {
+            shader->use();
+            shader->setUint("pathCount", pathCount);
+        }
+        extendShader.use();
+        extendShader.setInt("objectsData", 0);
+        extendShader.setInt("BVHNodesData", 1);
+        extendShader.setInt("trianglesData", 2);
+        extendShader.setInt("materialsData", 7);
+        missShader.use();
+        missShader.setInt("envMap", 3);
+    }
+
+    ~WavefrontTracer()
+    {
+        glDeleteBuffers(1, &counterBuffer);
+        glDeleteBuffers(1, &pathBuffer);
+        glDeleteBuffers(1, &hitBuffer);
+        glDeleteBuffers(1, &queueBuffer);
+        glDeleteBuffers(RAY_COUNT_DELAY, rayCountBuffers);
+        glDeleteFramebuffers(1, &outputFBO);
+        glDeleteTextures(1, &outputTexture);
+    }
+
+    // traces one frame of samplesPerPixel paths per pixel into the output texture
+    void Trace(const glm::vec3& lookFrom, const glm::vec3& lookAt, const glm::vec3& vup, float vfov,
+        int objectCount, int nodesHead, int triangleCount, int frameIndex, int maxDepth)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, counterBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, pathBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, hitBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, queueBuffer);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+
+        // every path starts in the first extend queue
+        unsigned int counters[COUNTER_BYTES / sizeof(unsigned int)] = {};
+        counters[QUEUE_EXTEND0] = pathCount;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, COUNTER_BYTES, counters);
+
+        generateShader.use();
+        generateShader.setVec3("cameraParameter.lookFrom", lookFrom);
+        generateShader.setVec3("cameraParameter.lookAt", lookAt);
+        generateShader.setVec3("cameraParameter.vup", vup);
+        generateShader.setFloat("cameraParameter.vfov", vfov);
+        generateShader.setFloat("cameraParameter.aspectRatio", (float)width / height);
+        generateShader.setIvec2("screenSize", width, height);
+        generateShader.setInt("samplesPerPixel", samplesPerPixel);
+        generateShader.setInt("frameIndex", frameIndex);
+        BeginPhase("wf generate");
+        generateShader.dispatch(pathCount, LOCAL_SIZE);
+        EndPhase();
+
+        extendShader.use();
+        extendShader.setInt("world.objectCount", objectCount);
+        extendShader.setInt("world.nodesHead", nodesHead);
+        extendShader.setInt("world.triangleCount", triangleCount);
+        for(int depth = 0; depth < maxDepth; ++depth)
+        {
+            int current = depth % 2 == 0 ? QUEUE_EXTEND0 : QUEUE_EXTEND1;
+            int next = depth % 2 == 0 ? QUEUE_EXTEND1 : QUEUE_EXTEND0;
+
+            // size the extend dispatch, empty everything the extend and shade stages fill
+            unsigned int clearMask = (1u << next) | (1u << QUEUE_LAMBERTIAN) | (1u << QUEUE_METALLIC) |
+                (1u << QUEUE_DIELECTRIC) | (1u << QUEUE_MISS);
+            Prepare(clearMask, current);
+
+            BeginPhase("wf extend");
+            extendShader.use();
+            extendShader.setInt("extendQueue", current);
+            DispatchQueue(current);
+            EndPhase();
+
+            // size the shading dispatches from what extend produced
+            Prepare(0u, -1);
+            BeginPhase("wf shade");
+            const ComputeShader* shade[] = { &lambertianShader, &metallicShader, &dielectricShader };
+            for(int i = 0; i < 3; ++i)
+            {
+                shade[i]->use();
+                shade[i]->setInt("nextExtendQueue", next);
+                DispatchQueue(QUEUE_LAMBERTIAN + i);
+            }
+            EndPhase();
+            BeginPhase("wf miss");
+            missShader.use();
+            DispatchQueue(QUEUE_MISS);
+            EndPhase();
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        BeginPhase("wf accumulate");
+        accumulateShader.use();
+        accumulateShader.setIvec2("screenSize", width, height);
+        accumulateShader.setInt("samplesPerPixel", samplesPerPixel);
+        glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        accumulateShader.dispatch(width * height, LOCAL_SIZE);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        EndPhase();
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+        // keep this frame's ray count aside for DelayedRayCount
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, rayCountBuffers[traceCount % RAY_COUNT_DELAY]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, QUEUE_COUNT * sizeof(unsigned int), 0, sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        ++traceCount;
+    }
+
+    // rays traced by the last frame, reading it waits for the frame to finish
+    unsigned int RayCount()
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, QUEUE_COUNT * sizeof(unsigned int), sizeof(unsigned int), &lastRayCount);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return lastRayCount;
+    }
+
+    // rays of the frame traced RAY_COUNT_DELAY - 1 frames ago, which is done by now,
+    // so reading it does not wait for the gpu. 0 until that many frames were traced
+    unsigned int DelayedRayCount()
+    {
+        if(traceCount < RAY_COUNT_DELAY)
+        {
+            return 0;
+        }
+        unsigned int count = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, rayCountBuffers[traceCount % RAY_COUNT_DELAY]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(unsigned int), &count);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return count;
+    }
+
+    // the stages of every traced frame are timed as gpu phases when a profiler is set
+    void SetProfiler(Profiler* profiler)
+    {
+        this->profiler = profiler;
+    }
+
+    unsigned int OutputTexture() const { return outputTexture; }
+    unsigned int OutputFBO() const { return outputFBO; }
+    int PathCount() const { return pathCount; }
+
+    ComputeShader generateShader;
+    ComputeShader prepareShader;
+    ComputeShader extendShader;
+    ComputeShader lambertianShader;
+    ComputeShader metallicShader;
+    ComputeShader dielectricShader;
+    ComputeShader missShader;
+    ComputeShader accumulateShader;
+
+private:
+    static const unsigned int LOCAL_SIZE = 64;
+    static const unsigned int COUNTER_BYTES = (QUEUE_COUNT + 2) * sizeof(unsigned int) + QUEUE_COUNT * 4 * sizeof(unsigned int);
+    static const unsigned int PATH_BYTES = 64;
+    static const unsigned int HIT_BYTES = 64;
+    static const int RAY_COUNT_DELAY = 4;
+
+    static std::vector<std::string> Sources(const std::string& shaderDir, const std::string& stage)
+    {
+        return std::vector<std::string>{ shaderDir + "/wavefront_common.glsl", shaderDir + "/" + stage };
+    }
+
+    void Prepare(unsigned int clearMask, int countQueue)
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        prepareShader.use();
+        prepareShader.setUint("clearMask", clearMask);
+        prepareShader.setInt("countQueue", countQueue);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    void BeginPhase(const char* name)
+    {
+        if(profiler)
+        {
+            profiler->BeginGpu(name);
+        }
+    }
+
+    void EndPhase()
+    {
+        if(profiler)
+        {
+            profiler->EndGpu();
+        }
+    }
+
+    void DispatchQueue(int queue)
+    {
+        GLintptr argsOffset = (QUEUE_COUNT + 2) * sizeof(unsigned int) + queue * 4 * sizeof(unsigned int);
+        glDispatchComputeIndirect(argsOffset);
+    }
+
+    int width, height;
+    int samplesPerPixel;
+    unsigned int pathCount;
+    unsigned int lastRayCount;
+    unsigned int counterBuffer, pathBuffer, hitBuffer, queueBuffer;
+    unsigned int outputTexture, outputFBO;
+    unsigned int rayCountBuffers[RAY_COUNT_DELAY];
+    Profiler* profiler;
+    int traceCount;
+};
+
+#endif
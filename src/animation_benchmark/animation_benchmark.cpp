@@ -0,0 +1,228 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+#include <raytracing/skeletal_animation.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+// evaluates CHARACTER_COUNT characters of a synthetic skeleton for FRAME_COUNT frames, the way
+// Animator::CalculateBoneTransform used to (recursion over named nodes, bones found by name,
+// the bone map copied at every node, linear key search) and with AnimationClip on one and on
+// all threads, and checks they give the same matrices:
+//   animation_benchmark [characters]
+
+// settings
+const int CHARACTER_COUNT = 500;
+const int FRAME_COUNT = 60;
+const int SKELETON_BONES = 65;
+const int KEYS_PER_TRACK = 60;
+const float CLIP_TICKS = 120.0f;
+const float FRAME_SECONDS = 1.0f / 60.0f;
+
+struct BoneInfo
+{
+    int id;
+    glm::mat4 offset;
+};
+
+// the node tree and per bone keys as the old Animator saw them
+struct LegacyNode
+{
+    glm::mat4 transformation;
+    std::string name;
+    std::vector<LegacyNode> children;
+};
+
+struct LegacyBone
+{
+    std::string name;
+    std::vector<float> times;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+    glm::mat4 local;
+};
+
+struct LegacyAnimation
+{
+    LegacyNode root;
+    std::vector<LegacyBone> bones;
+    std::map<std::string, BoneInfo> boneInfoMap;
+};
+
+int LinearKey(const std::vector<float>& times, float t)
+{
+    for(int index = 0; index < (int)times.size() - 1; ++index)
+    {
+        if(t < times[index + 1])
+        {
+            return index;
+        }
+    }
+    return (int)times.size() - 2;
+}
+
+void LegacyUpdate(LegacyBone& bone, float t)
+{
+    int key = LinearKey(bone.times, t);
+    float factor = glm::clamp((t - bone.times[key]) / (bone.times[key + 1] - bone.times[key]), 0.0f, 1.0f);
+    glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::mix(bone.positions[key], bone.positions[key + 1], factor));
+    glm::mat4 rotation = glm::toMat4(glm::normalize(glm::slerp(bone.rotations[key], bone.rotations[key + 1], factor)));
+    glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::mix(bone.scales[key], bone.scales[key + 1], factor));
+    bone.local = translation * rotation * scale;
+}
+
+void LegacyTransform(LegacyAnimation& animation, const LegacyNode* node, const glm::mat4& parentTransform, float t,
+    std::vector<glm::mat4>& finalBoneMatrices)
+{
+    glm::mat4 nodeTransform = node->transformation;
+    auto bone = std::find_if(animation.bones.begin(), animation.bones.end(),
+        [&](const LegacyBone& bone) { return bone.name == node->name; });
+    if(bone != animation.bones.end())
+    {
+        LegacyUpdate(*bone, t);
+        nodeTransform = bone->local;
+    }
+    glm::mat4 globalTransformation = parentTransform * nodeTransform;
+    auto boneInfoMap = animation.boneInfoMap;
+    if(boneInfoMap.find(node->name) != boneInfoMap.end())
+    {
+        finalBoneMatrices[boneInfoMap[node->name].id] = globalTransformation * boneInfoMap[node->name].offset;
+    }
+    for(const LegacyNode& child : node->children)
+    {
+        LegacyTransform(animation, &child, globalTransformation, t, finalBoneMatrices);
+    }
+}
+
+// a spine with limbs branching off, every node a bone with a track
+void BuildSkeleton(LegacyAnimation& legacy, AnimationClip& clip)
+{
+    std::default_random_engine random(7);
+    std::uniform_real_distribution<float> angle(-0.6f, 0.6f);
+    std::vector<int> parents(SKELETON_BONES, -1);
+    for(int i = 1; i < SKELETON_BONES; ++i)
+    {
+        // every fifth bone starts a limb at the spine, the rest continue the chain
+        parents[i] = (i % 5 == 0) ? std::max(0, i / 5 - 1) : i - 1;
+    }
+    clip.SetTiming(CLIP_TICKS, 30.0f);
+    std::vector<std::vector<int>> children(SKELETON_BONES);
+    for(int i = 1; i < SKELETON_BONES; ++i)
+    {
+        children[parents[i]].push_back(i);
+    }
+    for(int i = 0; i < SKELETON_BONES; ++i)
+    {
+        std::string name = "bone" + std::to_string(i);
+        glm::mat4 bind = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f));
+        glm::mat4 offset = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f * i, 0.0f));
+        clip.AddNode(parents[i], bind, i, offset, name);
+        legacy.boneInfoMap[name] = { i, offset };
+
+        LegacyBone bone;
+        bone.name = name;
+        for(int k = 0; k < KEYS_PER_TRACK; ++k)
+        {
+            bone.times.push_back(CLIP_TICKS * k / (KEYS_PER_TRACK - 1));
+            bone.positions.push_back(glm::vec3(0.0f, 0.1f, 0.01f * angle(random)));
+            bone.rotations.push_back(glm::angleAxis(angle(random), glm::normalize(glm::vec3(angle(random), 1.0f, angle(random)))));
+            bone.scales.push_back(glm::vec3(1.0f + 0.05f * angle(random)));
+        }
+        clip.SetTrack(i, bone.times, bone.positions, bone.times, bone.rotations, bone.times, bone.scales);
+        legacy.bones.push_back(bone);
+    }
+    // the legacy tree in the same order as the clip, children after their parents
+    std::function<void(LegacyNode&, int)> build = [&](LegacyNode& node, int i)
+    {
+        node.name = "bone" + std::to_string(i);
+        node.transformation = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f));
+        for(int child : children[i])
+        {
+            node.children.emplace_back();
+            build(node.children.back(), child);
+        }
+    };
+    build(legacy.root, 0);
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    int characters = argc > 1 ? std::max(1, std::atoi(argv[1])) : CHARACTER_COUNT;
+    LegacyAnimation legacy;
+    AnimationClip clip;
+    BuildSkeleton(legacy, clip);
+    std::cout << characters << " characters, " << clip.NodeCount() << " nodes, " << KEYS_PER_TRACK << " keys per channel, "
+        << FRAME_COUNT << " frames" << std::endl;
+
+    // every character starts at its own point in the clip
+    std::vector<float> phases(characters);
+    for(int c = 0; c < characters; ++c)
+    {
+        phases[c] = CLIP_TICKS * c / characters;
+    }
+
+    std::vector<glm::mat4> legacyMatrices((size_t)characters * SKELETON_BONES, glm::mat4(1.0f));
+    std::vector<glm::mat4> boneMatrices(legacyMatrices.size(), glm::mat4(1.0f));
+    std::vector<glm::mat4> characterMatrices(SKELETON_BONES);
+    auto start = std::chrono::steady_clock::now();
+    for(int frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        for(int c = 0; c < characters; ++c)
+        {
+            float t = std::fmod(phases[c] + clip.TicksPerSecond() * FRAME_SECONDS * frame, CLIP_TICKS);
+            LegacyTransform(legacy, &legacy.root, glm::mat4(1.0f), t, characterMatrices);
+            std::copy(characterMatrices.begin(), characterMatrices.end(), legacyMatrices.begin() + (size_t)c * SKELETON_BONES);
+        }
+    }
+    double legacyMs = Milliseconds(start) / FRAME_COUNT;
+    std::cout << "  " << std::left << std::setw(10) << "tree" << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << legacyMs << " ms per frame" << std::endl;
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int threadCounts[2] = { 1, threads };
+    for(int i = 0; i < (threads > 1 ? 2 : 1); ++i)
+    {
+        std::vector<AnimationState> states(characters);
+        for(int c = 0; c < characters; ++c)
+        {
+            states[c] = clip.CreateState();
+            states[c].time = phases[c];
+        }
+        start = std::chrono::steady_clock::now();
+        for(int frame = 1; frame <= FRAME_COUNT; ++frame)
+        {
+            UpdateAnimations(states.data(), characters, FRAME_SECONDS, boneMatrices.data(), SKELETON_BONES, threadCounts[i]);
+        }
+        double ms = Milliseconds(start) / FRAME_COUNT;
+        float maxError = 0.0f;
+        for(size_t m = 0; m < boneMatrices.size(); ++m)
+        {
+            for(int column = 0; column < 4; ++column)
+            {
+                glm::vec4 d = glm::abs(boneMatrices[m][column] - legacyMatrices[m][column]);
+                maxError = std::max(maxError, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+            }
+        }
+        std::string name = "clip x" + std::to_string(threadCounts[i]);
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(10) << ms << " ms per frame, "
+            << std::setprecision(1) << legacyMs / ms << "x, max difference " << std::scientific << maxError << std::fixed
+            << std::setprecision(3) << std::endl;
+    }
+    return 0;
+}
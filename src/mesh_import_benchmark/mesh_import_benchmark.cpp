@@ -0,0 +1,148 @@
+#include <glm/glm.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <raytracing/mesh_import.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+// imports obj files with the native parser on one and on all threads and with assimp, and
+// prints time and memory of each. with --generate it first writes a synthetic scan sized file:
+//   mesh_import_benchmark                          bunny.obj
+//   mesh_import_benchmark model.obj ...            the given files
+//   mesh_import_benchmark --generate 1024 big.obj  a ~1 GB grid with v/vt/vn faces, then benchmark it
+//   --no-assimp                                    skip assimp, it needs several times the file size in memory
+
+// settings
+const int GRID_VERTICES_PER_ROW = 2048;
+
+// a rolling height field of GRID_VERTICES_PER_ROW wide rows until the file reaches megabytes
+bool GenerateObj(const std::string& path, size_t megabytes)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "Failed to create file: " << path << std::endl;
+        return false;
+    }
+    size_t target = megabytes * 1024 * 1024;
+    size_t written = std::fprintf(file, "# synthetic grid for mesh_import_benchmark\n");
+    const int n = GRID_VERTICES_PER_ROW;
+    char line[256];
+    for(int row = 0; written < target; ++row)
+    {
+        for(int x = 0; x < n; ++x)
+        {
+            float u = (float)x / (n - 1), v = (float)row / n;
+            float h = 0.05f * std::sin(u * 37.0f) * std::cos(row * 0.013f);
+            written += std::fwrite(line, 1, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                u * 10.0f, h, row * 10.0f / n, u, v, 0.0f, 1.0f, 0.0f), file);
+        }
+        if(row == 0)
+        {
+            continue;
+        }
+        // quads between this row and the last, every 64th one with negative indices to cover those too
+        long vertexCount = (long)(row + 1) * n;
+        for(int x = 0; x + 1 < n; ++x)
+        {
+            long shift = (x % 64 == 0) ? -(vertexCount + 1) : 0;
+            long a = (long)(row - 1) * n + x + 1 + shift, b = a + 1, c = a + n + 1, d = a + n;
+            int length = std::snprintf(line, sizeof(line), "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n",
+                a, a, a, b, b, b, c, c, c, d, d, d);
+            written += std::fwrite(line, 1, length, file);
+        }
+    }
+    std::fclose(file);
+    std::cout << "wrote " << written / (1024.0 * 1024.0) << " MiB to " << path << std::endl;
+    return true;
+}
+
+void Report(const char* name, double ms, size_t residentBefore, const std::vector<TriangleMesh>& meshes)
+{
+    size_t vertices = 0, triangles = 0, bytes = 0;
+    for(const TriangleMesh& mesh : meshes)
+    {
+        vertices += mesh.VertexCount();
+        triangles += mesh.TriangleCount();
+        bytes += mesh.Bytes();
+    }
+    const double MiB = 1024.0 * 1024.0;
+    std::cout << "  " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << ms << " ms " << std::setw(10) << vertices << " vertices " << std::setw(10) << triangles
+        << " triangles " << std::setw(8) << bytes / MiB << " MiB meshes, resident +"
+        << ((double)ResidentMemoryBytes() - (double)residentBefore) / MiB << " MiB, peak " << ResidentMemoryBytes(true) / MiB
+        << " MiB" << std::endl;
+}
+
+void Benchmark(const std::string& path, bool withAssimp)
+{
+    std::cout << path << std::endl;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int threadCounts[2] = { 1, threads };
+    for(int i = 0; i < (threads > 1 ? 2 : 1); ++i)
+    {
+        std::vector<TriangleMesh> meshes;
+        size_t residentBefore = ResidentMemoryBytes();
+        auto start = std::chrono::steady_clock::now();
+        bool parsed = ParseObj(path, meshes, threadCounts[i]);
+        auto end = std::chrono::steady_clock::now();
+        std::string name = "obj x" + std::to_string(threadCounts[i]);
+        if(parsed)
+        {
+            Report(name.c_str(), std::chrono::duration<double, std::milli>(end - start).count(), residentBefore, meshes);
+        }
+    }
+    if(withAssimp)
+    {
+        std::vector<TriangleMesh> meshes;
+        MeshImportStats stats;
+        if(ImportTriangleMeshes(path, meshes, &stats, MeshImporter::Assimp))
+        {
+            Report("assimp", stats.milliseconds, stats.residentBefore, meshes);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    bool withAssimp = true;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--no-assimp") == 0)
+        {
+            withAssimp = false;
+        }
+        else if(std::strcmp(argv[i], "--generate") == 0 && i + 2 < argc)
+        {
+            size_t megabytes = std::strtoul(argv[i + 1], nullptr, 10);
+            if(!GenerateObj(argv[i + 2], megabytes))
+            {
+                return -1;
+            }
+            paths.push_back(argv[i + 2]);
+            i += 2;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if(paths.empty())
+    {
+        paths.push_back(FileSystem::getPath("resources/objects/bunny/bunny.obj"));
+    }
+    for(const std::string& path : paths)
+    {
+        Benchmark(path, withAssimp);
+    }
+    return 0;
+}
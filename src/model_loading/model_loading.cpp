@@ -8,11 +8,14 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
-#include <learnopengl/model.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
 #include <raytracing/sphere.h>
 #include <raytracing/bvh.h>
 #include <raytracing/scene.h>
 #include <raytracing/hittable_list.h>
+#include <raytracing/material_pool.h>
+#include <raytracing/mesh_import.h>
 #include <iostream>
 #include <vector>
 #include <map>
@@ -29,8 +32,7 @@ unsigned int loadCubemap(std::vector<std::string> faces);
 void SortObjects(HittableList& objects);
 void WriteObjectsData();
 void WriteBVHNodesData();
-void WriteTrianglesData(Model& m);
-void WriteVerticesIndexData(Model& m);
+void WriteTrianglesData(const std::vector<TriangleMesh>& meshes, const std::vector<int>& meshMaterials);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -41,6 +43,7 @@ const int MAT_LAMBERTIAN = 0;
 const int MAT_METALLIC =  1;
 const int MAT_DIELECTRIC = 2;
 const int MAT_PBR =  3;
+const int MAT_TEXTURE = 4;
 const int OBJ_SPHERE = 1;
 const int OBJ_XYRECT = 2;
 const int OBJ_XZRECT = 3;
@@ -105,12 +108,40 @@ int main()
          FileSystem::getPath("src/model_loading/model_loading.fs").c_str());
 
     // load models
-      Model model(FileSystem::getPath("resources/objects/rock/rock.obj"));
-    //Model model(FileSystem::getPath("resources/objects/bunny/bunny.obj"));
-     //Model model(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
-    std::cout << model.meshes.size() << endl;
-    std::cout << model.meshes[0].vertices.size() << endl;
-    std::cout << model.meshes[0].indices.size() << endl;
+    // -----------
+    // the tracer only reads positions, normals and uvs, so import straight into those arrays
+    // without learnopengl's Model and its GL buffers
+    std::string modelPath = FileSystem::getPath("resources/objects/rock/rock.obj");
+    // std::string modelPath = FileSystem::getPath("resources/objects/bunny/bunny.obj");
+    // std::string modelPath = FileSystem::getPath("resources/objects/backpack/backpack.obj");
+    std::vector<TriangleMesh> meshes;
+    MeshImportStats importStats;
+    if(!ImportTriangleMeshes(modelPath, meshes, &importStats))
+    {
+        glfwTerminate();
+        return -1;
+    }
+    PrintMeshImportStats(modelPath, importStats);
+
+    // materials and textures
+    // ----------------------
+    // every mesh gets a material in one table, its diffuse texture goes into the size class
+    // arrays. meshes without one (the rock only has a bump map) fall back to rock.png
+    TextureArrays textureArrays;
+    MaterialPool materials;
+    std::vector<int> meshMaterials;
+    int triangleCount = 0;
+    for(const TriangleMesh& mesh : meshes)
+    {
+        int texture = mesh.diffusePath.empty() ? -1 : textureArrays.Add(mesh.diffusePath);
+        if(texture < 0)
+        {
+            texture = textureArrays.Add(FileSystem::getPath("resources/objects/rock/rock.png"));
+        }
+        meshMaterials.push_back(materials.Intern(Material(vec3(0.65, 0.05, 0.05), MAT_TEXTURE, 0.0, 0.0, texture)));
+        triangleCount += mesh.TriangleCount();
+    }
+    textureArrays.Upload();
     //  }
     float vertices[] = 
     {
@@ -146,26 +177,35 @@ int main()
     RandomScene(objects);
     // CornellBox(objects);
     SortObjects(objects);
+    materials.Intern(objects);
     WriteObjectsData();
     WriteBVHNodesData();
-    WriteTrianglesData(model);
+    WriteTrianglesData(meshes, meshMaterials);
+    std::vector<float> materialsData = materials.Pack(&textureArrays);
 
     // generate buffer texture
     // -----------------------
-    unsigned int tboSpheresId[3], tboBufferId[3];
-    glGenTextures(3, tboSpheresId);
-    glGenBuffers(3, tboBufferId);
+    unsigned int tboSpheresId[4], tboBufferId[4];
+    glGenTextures(4, tboSpheresId);
+    glGenBuffers(4, tboBufferId);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[0]);
     glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, spheresData, GL_STATIC_DRAW);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[1]);
     glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, BVHNodesData, GL_STATIC_DRAW);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[2]);
     glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, triangleData, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[3]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * materialsData.size(), materialsData.data(), GL_STATIC_DRAW);
 
     shader.use();
     shader.setInt("spheresData", 0);
     shader.setInt("BVHNodesData", 1);
     shader.setInt("trianglesData", 2);
+    shader.setInt("materialsData", 3);
+    for(int i = 0; i < TEXTURE_SIZE_CLASS_COUNT; ++i)
+    {
+        shader.setInt("textureClasses[" + std::to_string(i) + "]", 4 + i);
+    }
 
     // render loop
     // -----------
@@ -201,7 +241,7 @@ int main()
         shader.setFloat("cameraParameter.aspectRatio", (float)SCR_WIDTH/SCR_HEIGHT);
         shader.setInt("world.objectCount", objects.size());
         shader.setInt("world.nodesHead", BVHNodes.size() - 1);
-        shader.setInt("world.triangleCount", model.meshes[0].indices.size()/3);
+        shader.setInt("world.triangleCount", triangleCount);
         // shader.setInt("world.triangleCount", 1);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[0]);
@@ -212,6 +252,10 @@ int main()
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[2]);
         glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[2]);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[3]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[3]);
+        textureArrays.Bind(4);
     
         glBindVertexArray(VAO);
         
@@ -231,7 +275,8 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(3, tboBufferId);
+    glDeleteBuffers(4, tboBufferId);
+    glDeleteTextures(4, tboSpheresId);
     delete [] spheresData;
     delete [] triangleData;
     delete [] BVHNodesData;
@@ -383,64 +428,47 @@ void SortObjects(HittableList& objects)
 
 void WriteObjectsData()
 {
+    // two texels per object, the material is an index into the materials buffer:
+    // sphere [center, radius] [material, 0, 0, 0]
+    // rect   [a0, a1, b0, b1] [material, k, 0, 0]
     for(int i = 0; i < objects.size(); ++i)
     {
+        float* bounds = spheresData[i*2];
+        float* extra = spheresData[i*2+1];
+        extra[0] = objects[i]->materialIndex;
+        extra[1] = 0.0f;
+        extra[2] = 0.0f;
+        extra[3] = 0.0f;
         switch(objects[i]->objectType)
         {
             case OBJ_SPHERE:
-                spheresData[i*3][0] = objects[i]->center[0];
-                spheresData[i*3][1] = objects[i]->center[1];
-                spheresData[i*3][2] = objects[i]->center[2];
-                spheresData[i*3][3] = objects[i]->radius;
-                spheresData[i*3+1][0] = objects[i]->matPtr->color[0];
-                spheresData[i*3+1][1] = objects[i]->matPtr->color[1];
-                spheresData[i*3+1][2] = objects[i]->matPtr->color[2];
-                spheresData[i*3+1][3] = objects[i]->matPtr->materialType;
-                spheresData[i*3+2][0] = objects[i]->matPtr->roughness;
-                spheresData[i*3+2][1] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->center[0];
+                bounds[1] = objects[i]->center[1];
+                bounds[2] = objects[i]->center[2];
+                bounds[3] = objects[i]->radius;
             break;
             case OBJ_XYRECT:
-                spheresData[i*3][0] = objects[i]->x0;
-                spheresData[i*3][1] = objects[i]->x1;
-                spheresData[i*3][2] = objects[i]->y0;
-                spheresData[i*3][3] = objects[i]->y1;
-                spheresData[i*3+1][0] = objects[i]->matPtr->color[0];
-                spheresData[i*3+1][1] = objects[i]->matPtr->color[1];
-                spheresData[i*3+1][2] = objects[i]->matPtr->color[2];
-                spheresData[i*3+1][3] = objects[i]->k;
-                spheresData[i*3+2][0] = objects[i]->matPtr->materialType;
-                spheresData[i*3+2][1] = objects[i]->matPtr->roughness;
-                spheresData[i*3+2][2] = objects[i]->matPtr->ior;
-                
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->y0;
+                bounds[3] = objects[i]->y1;
+                extra[1] = objects[i]->k;
             break;
             case OBJ_XZRECT:
-                spheresData[i*3][0] = objects[i]->x0;
-                spheresData[i*3][1] = objects[i]->x1;
-                spheresData[i*3][2] = objects[i]->z0;
-                spheresData[i*3][3] = objects[i]->z1;
-                spheresData[i*3+1][0] = objects[i]->matPtr->color[0];
-                spheresData[i*3+1][1] = objects[i]->matPtr->color[1];
-                spheresData[i*3+1][2] = objects[i]->matPtr->color[2];
-                spheresData[i*3+1][3] = objects[i]->k;
-                spheresData[i*3+2][0] = objects[i]->matPtr->materialType;
-                spheresData[i*3+2][1] = objects[i]->matPtr->roughness;
-                spheresData[i*3+2][2] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
             break;
             case OBJ_YZRECT:
-                spheresData[i*3][0] = objects[i]->y0;
-                spheresData[i*3][1] = objects[i]->y1;
-                spheresData[i*3][2] = objects[i]->z0;
-                spheresData[i*3][3] = objects[i]->z1;
-                spheresData[i*3+1][0] = objects[i]->matPtr->color[0];
-                spheresData[i*3+1][1] = objects[i]->matPtr->color[1];
-                spheresData[i*3+1][2] = objects[i]->matPtr->color[2];
-                spheresData[i*3+1][3] = objects[i]->k;
-                spheresData[i*3+2][0] = objects[i]->matPtr->materialType;
-                spheresData[i*3+2][1] = objects[i]->matPtr->roughness;
-                spheresData[i*3+2][2] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->y0;
+                bounds[1] = objects[i]->y1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
             break;
         }
-        
     }
 }
 
@@ -463,22 +491,33 @@ void WriteBVHNodesData()
     }
 }
 
-void WriteTrianglesData(Model& m)
+// seven texels per triangle: position + u and normal + v for each vertex, then the material index
+void WriteTrianglesData(const std::vector<TriangleMesh>& meshes, const std::vector<int>& meshMaterials)
 {
     int triangleIndex = 0;
-    for(int i = 0; i < m.meshes.size(); ++i)
+    for(int i = 0; i < meshes.size(); ++i)
     {
-        for( int j = 0; j < m.meshes[i].vertices.size(); ++j)
+        const TriangleMesh& mesh = meshes[i];
+        for(int j = 0; j + 2 < mesh.indices.size(); j += 3)
         {
-            triangleData[triangleIndex][0] = m.meshes[i].vertices[j].Position[0];
-            triangleData[triangleIndex][1] = m.meshes[i].vertices[j].Position[1];
-            triangleData[triangleIndex][2] = m.meshes[i].vertices[j].Position[2];
-            triangleData[triangleIndex][3] = m.meshes[i].vertices[j].TexCoords[0];
-            triangleData[triangleIndex + 1][0] = m.meshes[i].vertices[j].Normal[0];
-            triangleData[triangleIndex + 1][1] = m.meshes[i].vertices[j].Normal[1];
-            triangleData[triangleIndex + 1][2] = m.meshes[i].vertices[j].Normal[2];
-            triangleData[triangleIndex + 1][3] = m.meshes[i].vertices[j].TexCoords[1];
-            triangleIndex+=2;
+            for(int k = 0; k < 3; ++k)
+            {
+                unsigned int vertex = mesh.indices[j + k];
+                triangleData[triangleIndex][0] = mesh.positions[vertex][0];
+                triangleData[triangleIndex][1] = mesh.positions[vertex][1];
+                triangleData[triangleIndex][2] = mesh.positions[vertex][2];
+                triangleData[triangleIndex][3] = mesh.uvs[vertex][0];
+                triangleData[triangleIndex + 1][0] = mesh.normals[vertex][0];
+                triangleData[triangleIndex + 1][1] = mesh.normals[vertex][1];
+                triangleData[triangleIndex + 1][2] = mesh.normals[vertex][2];
+                triangleData[triangleIndex + 1][3] = mesh.uvs[vertex][1];
+                triangleIndex += 2;
+            }
+            triangleData[triangleIndex][0] = meshMaterials[i];
+            triangleData[triangleIndex][1] = 0.0f;
+            triangleData[triangleIndex][2] = 0.0f;
+            triangleData[triangleIndex][3] = 0.0f;
+            triangleIndex += 1;
         }
     }
 }
\ No newline at end of file
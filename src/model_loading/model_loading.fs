@@ -13,6 +13,14 @@ const int OBJ_SPHERE = 1;
 const int OBJ_XYRECT = 2;
 const int OBJ_XZRECT = 3;
 const int OBJ_YZRECT = 4;
+// extra spread in radians a ray cone picks up at a diffuse bounce, specular bounces keep theirs
+const float DIFFUSE_CONE_SPREAD = 0.2;
+// texels per triangle and per material in their buffers, see WriteTrianglesData and MaterialTable
+const int OBJECT_TEXELS = 2;
+const int TRIANGLE_TEXELS = 7;
+const int MATERIAL_TEXELS = 3;
+const int TEXTURE_SIZE_CLASS_COUNT = 4;
+const float TEXTURE_SIZE_CLASSES[TEXTURE_SIZE_CLASS_COUNT] = float[](256.0, 512.0, 1024.0, 2048.0);
 // in variables
 // ------------
 in vec2 screenCoord;
@@ -24,7 +32,9 @@ uniform samplerBuffer objectsData;
 uniform samplerBuffer BVHNodesData;
 uniform samplerBuffer trianglesData;
 
-uniform sampler2D texture_diffuse1;
+uniform samplerBuffer materialsData;
+// one array per texture size class, see TextureArrays
+uniform sampler2DArray textureClasses[TEXTURE_SIZE_CLASS_COUNT];
 
 // out variables
 // ------------
@@ -71,6 +81,10 @@ struct Material
 	vec3 color;
 	float roughness;
 	float ior;
+	// -1 when untextured, otherwise the array and layer holding the texture
+	int textureClass;
+	float textureLayer;
+	vec2 uvScale;
 };
 
 struct Sphere 
@@ -126,6 +140,10 @@ struct HitRecord
 	vec3 normal;
 	float u, v;
     Material material;
+	// log2 of sqrt(texture area / world area) of the hit triangle, only triangles are textured
+	float lodBase;
+	// width of the ray cone at the hit, set by WorldTrace
+	float coneWidth;
 };
 
 struct World
@@ -162,6 +180,8 @@ int rdCnt = 0;
 Camera camera;
 uniform CameraParameter cameraParameter;
 uniform World world;
+// spread angle of the ray cone through one pixel
+float pixelSpreadAngle;
 Triangle triangle;
 int stack[30];
 int stackTop = -1;
@@ -183,6 +203,8 @@ XZRect GetXZRectFromTexture(int xzrectIndex);
 YZRect GetYZRectFromTexture(int yzrectIndex);
 BVHNode GetBVHNodeFromTexture(int BVHNodeIndex);
 Triangle GetTriangleFromTexture(int triangleIndex);
+Material GetMaterialFromTexture(int materialIndex);
+vec4 SampleTextureClass(int textureClass, vec3 uvLayer, float lod);
 bool SphereHit(Sphere sphere, Ray ray, float tMin, float tMax, inout HitRecord hitRec);
 vec3 SetFaceNormal(Ray ray, vec3 outwardNormal);
 bool XYRectHit(XYRect rect, Ray ray, float tMin, float tMax, inout HitRecord hitRec);
@@ -304,77 +326,56 @@ Camera CameraConstructor(vec3 lookFrom, vec3 lookAt, vec3 vup, float vfov, float
 Sphere GetSphereFromTexture(int sphereIndex)
 {
 	Sphere sphere;
-	vec4 pack;
-	int index = sphereIndex*3;
-	pack = texelFetch(objectsData, index);
+	int index = sphereIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(objectsData, index);
 	sphere.center = pack.xyz;
 	sphere.radius = pack.w;
-	pack = texelFetch(objectsData, index + 1);
-	sphere.material.color = pack.xyz;
-	sphere.material.materialType = int(pack.w);
-	pack = texelFetch(objectsData, index + 2);
-	sphere.material.roughness = pack.x;
-	sphere.material.ior = pack.y;
+	sphere.material = GetMaterialFromTexture(int(texelFetch(objectsData, index + 1).x));
 	return sphere;
 }
 
 XYRect GetXYRectFromTexture(int xyrectIndex)
 {
 	XYRect rect;
-	vec4 pack;
-	int index = xyrectIndex * 3;
-	pack = texelFetch(objectsData, index);
+	int index = xyrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(objectsData, index);
 	rect.x0 = pack.x;
 	rect.x1 = pack.y;
 	rect.y0 = pack.z;
 	rect.y1 = pack.w;
 	pack = texelFetch(objectsData, index + 1);
-	rect.material.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(objectsData, index + 2);
-	rect.material.materialType = int(pack.x);
-	rect.material.roughness = pack.y;
-	rect.material.ior = pack.z;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
 XZRect GetXZRectFromTexture(int xzrectIndex)
 {
 	XZRect rect;
-	vec4 pack;
-	int index = xzrectIndex * 3;
-	pack = texelFetch(objectsData, index);
+	int index = xzrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(objectsData, index);
 	rect.x0 = pack.x;
 	rect.x1 = pack.y;
 	rect.z0 = pack.z;
 	rect.z1 = pack.w;
 	pack = texelFetch(objectsData, index + 1);
-	rect.material.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(objectsData, index + 2);
-	rect.material.materialType = int(pack.x);
-	rect.material.roughness = pack.y;
-	rect.material.ior = pack.z;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
 YZRect GetYZRectFromTexture(int yzrectIndex)
 {
 	YZRect rect;
-	vec4 pack;
-	int index = yzrectIndex * 3;
-	pack = texelFetch(objectsData, index);
+	int index = yzrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(objectsData, index);
 	rect.y0 = pack.x;
 	rect.y1 = pack.y;
 	rect.z0 = pack.z;
 	rect.z1 = pack.w;
 	pack = texelFetch(objectsData, index + 1);
-	rect.material.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(objectsData, index + 2);
-	rect.material.materialType = int(pack.x);
-	rect.material.roughness = pack.y;
-	rect.material.ior = pack.z;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
@@ -399,7 +400,7 @@ Triangle GetTriangleFromTexture(int triangleIndex)
 {
 	Triangle tri;
 
-	int index = triangleIndex * 6;
+	int index = triangleIndex * TRIANGLE_TEXELS;
 	vec4 pack = texelFetch(trianglesData, index);
 	tri.a.position = pack.xyz;
 	tri.a.texCoords.x = pack.w;
@@ -421,11 +422,39 @@ Triangle GetTriangleFromTexture(int triangleIndex)
 	tri.c.normal = pack.xyz;
 	tri.c.texCoords.y = pack.w;
 
-	tri.material.color = vec3(0.65, 0.05, 0.05);
-	tri.material.materialType = MAT_TEXTURE;
+	tri.material = GetMaterialFromTexture(int(texelFetch(trianglesData, index + 6).x));
 	return tri;
 }
 
+Material GetMaterialFromTexture(int materialIndex)
+{
+	Material material;
+	int index = materialIndex * MATERIAL_TEXELS;
+	vec4 pack = texelFetch(materialsData, index);
+	material.color = pack.xyz;
+	material.materialType = int(pack.w);
+	pack = texelFetch(materialsData, index + 1);
+	material.roughness = pack.x;
+	material.ior = pack.y;
+	material.textureClass = int(pack.z);
+	material.textureLayer = pack.w;
+	material.uvScale = texelFetch(materialsData, index + 2).xy;
+	return material;
+}
+
+// sampler arrays can only be indexed with constants in glsl 330
+vec4 SampleTextureClass(int textureClass, vec3 uvLayer, float lod)
+{
+	if(textureClass == 0)
+		return textureLod(textureClasses[0], uvLayer, lod);
+	else if(textureClass == 1)
+		return textureLod(textureClasses[1], uvLayer, lod);
+	else if(textureClass == 2)
+		return textureLod(textureClasses[2], uvLayer, lod);
+	else
+		return textureLod(textureClasses[3], uvLayer, lod);
+}
+
 bool SphereHit(Sphere sphere, Ray ray, float tMin, float tMax, inout HitRecord hitRec)
 {
 	vec3 oc = ray.origin - sphere.center;
@@ -559,6 +588,11 @@ bool TriangleHit(Triangle tri, Ray ray, float tMin, float tMax, inout HitRecord
 	hitRec.v = dot(abgt.xyz, vec3(tri.a.texCoords.y, tri.b.texCoords.y, tri.c.texCoords.y));
 	hitRec.normal = abgt[0]*tri.a.normal + abgt[1]*tri.b.normal + abgt[2]*tri.c.normal;
 	hitRec.material = tri.material;
+	float worldArea = length(cross(tri.b.position - tri.a.position, tri.c.position - tri.a.position));
+	vec2 uvEdge1 = tri.b.texCoords - tri.a.texCoords;
+	vec2 uvEdge2 = tri.c.texCoords - tri.a.texCoords;
+	float uvArea = abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+	hitRec.lodBase = 0.5 * log2(max(uvArea, 1e-12) / max(worldArea, 1e-12));
 	return true;
 }
 
@@ -667,16 +701,23 @@ vec3 WorldTrace(Ray ray, int depth)
 
 	vec3 frac = vec3(1.0, 1.0, 1.0);
 	vec3 bgColor = vec3(0.0, 0.0, 0.0);
+	// ray cone carried along the path, it starts as the pixel footprint at the eye
+	float coneWidth = 0.0;
+	float coneSpread = pixelSpreadAngle;
 	while(depth>0)
 	{
 		depth--;
 		if(WorldHit(ray, 0.001, RAYCAST_MAX, hitRecord))
 		// if(WorldHitBVH(ray, 0.001, RAYCAST_MAX, hitRecord))
 		{
+			coneWidth += coneSpread * hitRecord.t * length(ray.direction);
+			hitRecord.coneWidth = coneWidth;
 			Ray scatterRay;
 			vec3 attenuation;
 			if(!MaterialScatter(ray, hitRecord, scatterRay, attenuation))
 				break;
+			if(hitRecord.material.materialType == MAT_LAMBERTIAN || hitRecord.material.materialType == MAT_TEXTURE)
+				coneSpread += DIFFUSE_CONE_SPREAD;
 			
 			frac *= attenuation;
 			ray = scatterRay;
@@ -845,7 +886,22 @@ bool DielectricScatter(in Ray incident, in HitRecord hitRecord, out Ray scattere
 
 bool TextureScatter(in Ray incident, in HitRecord hitRecord, out Ray scattered, out vec3 attenuation)
 {
-	attenuation = texture(texture_diffuse1, vec2(hitRecord.u, hitRecord.v)).xyz;
+	Material material = hitRecord.material;
+	if(material.textureClass < 0)
+	{
+		attenuation = material.color;
+	}
+	else
+	{
+		// ray cone lod: triangle texel density plus the cone footprint, stretched at grazing angles.
+		// a padded texture only covers uvScale of its layer, so it wraps before scaling
+		vec2 textureDim = TEXTURE_SIZE_CLASSES[material.textureClass] * material.uvScale;
+		float cosine = abs(dot(normalize(incident.direction), normalize(hitRecord.normal)));
+		float lod = hitRecord.lodBase + 0.5 * log2(textureDim.x * textureDim.y)
+			+ log2(max(hitRecord.coneWidth, 1e-8) / max(cosine, 1e-4));
+		vec2 uv = fract(vec2(hitRecord.u, hitRecord.v)) * material.uvScale;
+		attenuation = SampleTextureClass(material.textureClass, vec3(uv, material.textureLayer), lod).xyz;
+	}
 
 	scattered.origin = hitRecord.position;
 	scattered.direction = hitRecord.normal + RandInSphere();
@@ -941,6 +997,7 @@ int StackPop()
 void main()
 {
 	camera = CameraConstructor(cameraParameter.lookFrom, cameraParameter.lookAt, cameraParameter.vup, 20.0, cameraParameter.aspectRatio);
+	pixelSpreadAngle = atan(2.0 * tan(radians(20.0) / 2.0) / screenSize.y);
 	vec3 col = vec3(0.0, 0.0, 0.0);
 	int ns = 10;
 	for(int i=0; i<ns; i++)
@@ -0,0 +1,75 @@
+#version 330 core
+
+const float RAYCAST_MAX = 100000.0;
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D illuminationTexture;
+uniform sampler2D normalDepthTexture;
+uniform int stepSize;
+uniform float sigmaLuminance;
+uniform float sigmaNormal;
+uniform float sigmaDepth;
+
+// out variables
+// ------------
+out vec4 FragColor;
+
+const float kernel[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+float Luminance(vec3 c)
+{
+	return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(illuminationTexture, 0);
+	vec4 center = texelFetch(illuminationTexture, pixel, 0);
+	vec4 centerND = texelFetch(normalDepthTexture, pixel, 0);
+
+	// the environment is already noise free
+	if(centerND.w >= RAYCAST_MAX)
+	{
+		FragColor = center;
+		return;
+	}
+
+	float centerLuminance = Luminance(center.xyz);
+	float luminanceScale = sigmaLuminance * sqrt(max(center.w, 0.0)) + 1e-4;
+	float depthScale = sigmaDepth * centerND.w * float(stepSize) + 1e-4;
+
+	vec3 sumIllumination = center.xyz;
+	float sumVariance = center.w;
+	float sumWeight = 1.0;
+	for(int y = -2; y <= 2; ++y)
+	{
+		for(int x = -2; x <= 2; ++x)
+		{
+			if(x == 0 && y == 0)
+				continue;
+			ivec2 q = pixel + ivec2(x, y) * stepSize;
+			if(q.x < 0 || q.y < 0 || q.x >= size.x || q.y >= size.y)
+				continue;
+
+			vec4 sampleIllumination = texelFetch(illuminationTexture, q, 0);
+			vec4 sampleND = texelFetch(normalDepthTexture, q, 0);
+
+			float wNormal = pow(max(dot(centerND.xyz, sampleND.xyz), 0.0), sigmaNormal);
+			float wDepth = exp(-abs(centerND.w - sampleND.w) / depthScale);
+			float wLuminance = exp(-abs(centerLuminance - Luminance(sampleIllumination.xyz)) / luminanceScale);
+			float w = kernel[abs(x)] * kernel[abs(y)] / (kernel[0] * kernel[0]) * wNormal * wDepth * wLuminance;
+
+			sumIllumination += w * sampleIllumination.xyz;
+			sumVariance += w * w * sampleIllumination.w;
+			sumWeight += w;
+		}
+	}
+
+	FragColor = vec4(sumIllumination / sumWeight, sumVariance / (sumWeight * sumWeight));
+}
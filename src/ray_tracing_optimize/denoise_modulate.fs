@@ -0,0 +1,23 @@
+#version 330 core
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D illuminationTexture;
+uniform sampler2D albedoTexture;
+
+// out variables
+// ------------
+out vec4 FragColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec3 illumination = texelFetch(illuminationTexture, pixel, 0).xyz;
+	vec3 albedo = texelFetch(albedoTexture, pixel, 0).xyz;
+
+	FragColor = vec4(illumination * max(albedo, vec3(0.001)), 1.0);
+}
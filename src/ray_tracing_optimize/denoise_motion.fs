@@ -0,0 +1,50 @@
+#version 330 core
+
+const float RAYCAST_MAX = 100000.0;
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D normalDepthTexture;
+uniform mat4 inverseViewProjection;
+uniform mat4 prevViewProjection;
+uniform vec3 cameraPosition;
+uniform vec3 prevCameraPosition;
+
+// out variables
+// ------------
+out vec4 FragColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(normalDepthTexture, pixel, 0).w;
+
+	// direction of the primary ray through this pixel center
+	vec4 farPoint = inverseViewProjection * vec4(screenCoord * 2.0 - 1.0, 1.0, 1.0);
+	vec3 direction = normalize(farPoint.xyz / farPoint.w - cameraPosition);
+
+	vec4 prevClip;
+	float expectedDepth;
+	float background = 0.0;
+	if(depth >= RAYCAST_MAX)
+	{
+		// the environment is infinitely far away, only rotation moves it
+		prevClip = prevViewProjection * vec4(direction, 0.0);
+		expectedDepth = RAYCAST_MAX;
+		background = 1.0;
+	}
+	else
+	{
+		vec3 position = cameraPosition + direction * depth;
+		prevClip = prevViewProjection * vec4(position, 1.0);
+		expectedDepth = length(position - prevCameraPosition);
+	}
+
+	vec2 prevCoord = prevClip.w > 0.0 ? (prevClip.xy / prevClip.w) * 0.5 + 0.5 : vec2(-1.0);
+	// motion in uv units, depth the previous frame should have stored at the reprojected pixel
+	FragColor = vec4(prevCoord - screenCoord, expectedDepth, background);
+}
@@ -0,0 +1,111 @@
+#version 330 core
+
+const float RAYCAST_MAX = 100000.0;
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D colorTexture;
+uniform sampler2D albedoTexture;
+uniform sampler2D historyIllumination;
+uniform sampler2D historyMoments;
+uniform sampler2D normalDepthTexture;
+uniform sampler2D prevNormalDepthTexture;
+uniform sampler2D motionTexture;
+uniform bool resetHistory;
+uniform float maxHistoryLength;
+uniform float depthTolerance;
+uniform float normalTolerance;
+
+// out variables
+// ------------
+layout (location = 0) out vec4 Illumination;
+layout (location = 1) out vec4 Moments;
+
+float Luminance(vec3 c)
+{
+	return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// a history texel is reused only if it saw the same surface: matching depth and orientation
+bool HistoryValid(ivec2 p, ivec2 size, vec3 normal, float expectedDepth, bool background)
+{
+	if(p.x < 0 || p.y < 0 || p.x >= size.x || p.y >= size.y)
+		return false;
+	vec4 prevND = texelFetch(prevNormalDepthTexture, p, 0);
+	if(background)
+		return prevND.w >= RAYCAST_MAX;
+	if(prevND.w >= RAYCAST_MAX)
+		return false;
+	if(abs(prevND.w - expectedDepth) > depthTolerance * expectedDepth)
+		return false;
+	return dot(normal, prevND.xyz) > normalTolerance;
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(colorTexture, 0);
+	vec3 color = texelFetch(colorTexture, pixel, 0).xyz;
+	vec3 albedo = texelFetch(albedoTexture, pixel, 0).xyz;
+	vec3 normal = texelFetch(normalDepthTexture, pixel, 0).xyz;
+	vec4 motion = texelFetch(motionTexture, pixel, 0);
+
+	// demodulate so the filter works on lighting only and keeps texture detail
+	vec3 illumination = color / max(albedo, vec3(0.001));
+	float luminance = Luminance(illumination);
+	vec2 moments = vec2(luminance, luminance * luminance);
+
+	float historyLength = 0.0;
+	vec3 prevIllumination = vec3(0.0);
+	vec2 prevMoments = vec2(0.0);
+	if(!resetHistory)
+	{
+		// bilinear reprojection, every tap checked for disocclusion on its own
+		vec2 prevPos = (screenCoord + motion.xy) * vec2(size) - 0.5;
+		ivec2 base = ivec2(floor(prevPos));
+		vec2 f = fract(prevPos);
+		float weights[4] = float[4]((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+		ivec2 offsets[4] = ivec2[4](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+		float sumWeight = 0.0;
+		vec4 sumMoments = vec4(0.0);
+		for(int i = 0; i < 4; ++i)
+		{
+			ivec2 p = base + offsets[i];
+			if(HistoryValid(p, size, normal, motion.z, motion.w > 0.5))
+			{
+				prevIllumination += weights[i] * texelFetch(historyIllumination, p, 0).xyz;
+				sumMoments += weights[i] * texelFetch(historyMoments, p, 0);
+				sumWeight += weights[i];
+			}
+		}
+		if(sumWeight > 0.01)
+		{
+			prevIllumination /= sumWeight;
+			prevMoments = sumMoments.xy / sumWeight;
+			historyLength = sumMoments.z / sumWeight;
+		}
+		else
+		{
+			prevIllumination = vec3(0.0);
+		}
+	}
+
+	historyLength = min(historyLength + 1.0, maxHistoryLength);
+	float alpha = 1.0 / historyLength;
+	illumination = mix(prevIllumination, illumination, alpha);
+	moments = mix(prevMoments, moments, alpha);
+	float variance = max(moments.y - moments.x * moments.x, 0.0);
+
+	// until enough history exists the temporal variance is meaningless, so let the filter run wide
+	if(historyLength < 4.0)
+	{
+		variance = max(variance, 1.0);
+	}
+
+	Illumination = vec4(illumination, variance);
+	Moments = vec4(moments, historyLength, 0.0);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+const int OBJ_MODEL = 5;
+
+// in variables
+// ------------
+in vec3 worldPosition;
+in vec3 normal;
+flat in vec2 object;
+
+uniform vec3 cameraPosition;
+
+// out variables
+// ------------
+layout (location = 0) out vec4 PositionType;
+layout (location = 1) out vec4 NormalIndex;
+
+void main()
+{
+	// model triangles keep the interpolated vertex normal like TriangleHit,
+	// rects orient theirs against the view ray like SetFaceNormal
+	vec3 n = normal;
+	if(int(object.x) != OBJ_MODEL)
+	{
+		n = dot(worldPosition - cameraPosition, n) > 0.0 ? n : -n;
+	}
+	PositionType = vec4(worldPosition, object.x);
+	NormalIndex = vec4(n, object.y);
+}
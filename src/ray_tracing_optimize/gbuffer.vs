@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aObject;
+
+uniform mat4 viewProjection;
+
+out vec3 worldPosition;
+out vec3 normal;
+flat out vec2 object;
+
+void main()
+{
+	worldPosition = aPos;
+	normal = aNormal;
+	object = aObject;
+	gl_Position = viewProjection * vec4(aPos, 1.0);
+}
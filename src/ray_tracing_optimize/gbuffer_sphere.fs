@@ -0,0 +1,39 @@
+#version 330 core
+
+// in variables
+// ------------
+in vec3 worldPosition;
+flat in vec4 sphere;
+flat in vec2 object;
+
+uniform mat4 viewProjection;
+uniform vec3 cameraPosition;
+
+// out variables
+// ------------
+layout (location = 0) out vec4 PositionType;
+layout (location = 1) out vec4 NormalIndex;
+
+void main()
+{
+	// the view ray through this fragment against the exact sphere, nearest hit in front
+	// of the camera first as in SphereHit, the far one when the camera is inside
+	vec3 direction = normalize(worldPosition - cameraPosition);
+	vec3 oc = cameraPosition - sphere.xyz;
+	float b = dot(oc, direction);
+	float c = dot(oc, oc) - sphere.w * sphere.w;
+	float discriminant = b * b - c;
+	if(discriminant <= 0.0)
+		discard;
+	float t = -b - sqrt(discriminant);
+	if(t <= 0.001)
+		t = -b + sqrt(discriminant);
+	if(t <= 0.001)
+		discard;
+
+	vec3 position = cameraPosition + t * direction;
+	vec4 clip = viewProjection * vec4(position, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+	PositionType = vec4(position, object.x);
+	NormalIndex = vec4((position - sphere.xyz) / sphere.w, object.y);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aSphere;
+layout (location = 2) in vec2 aObject;
+
+uniform mat4 viewProjection;
+uniform float coverScale;
+
+out vec3 worldPosition;
+flat out vec4 sphere;
+flat out vec2 object;
+
+void main()
+{
+	worldPosition = aSphere.xyz + aPos * aSphere.w * coverScale;
+	sphere = aSphere;
+	object = aObject;
+	gl_Position = viewProjection * vec4(worldPosition, 1.0);
+}
@@ -0,0 +1,42 @@
+#version 330 core
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D costTexture;
+uniform int channel;
+uniform float maxCost;
+
+// out variables
+// ------------
+out vec4 FragColor;
+
+// blue, cyan, green, yellow, red as the cost goes from 0 to 1
+vec3 Ramp(float x)
+{
+	x = clamp(x, 0.0, 1.0) * 4.0;
+	vec3 c0 = vec3(0.0, 0.0, 1.0);
+	vec3 c1 = vec3(0.0, 1.0, 1.0);
+	vec3 c2 = vec3(0.0, 1.0, 0.0);
+	vec3 c3 = vec3(1.0, 1.0, 0.0);
+	vec3 c4 = vec3(1.0, 0.0, 0.0);
+	if(x < 1.0)
+		return mix(c0, c1, x);
+	if(x < 2.0)
+		return mix(c1, c2, x - 1.0);
+	if(x < 3.0)
+		return mix(c2, c3, x - 2.0);
+	return mix(c3, c4, x - 3.0);
+}
+
+void main()
+{
+	ivec2 size = textureSize(costTexture, 0);
+	ivec2 p = clamp(ivec2(screenCoord * vec2(size)), ivec2(0), size - 1);
+	float cost = texelFetch(costTexture, p, 0)[channel];
+	// over budget pixels turn white so they stand out from the ramp
+	FragColor = vec4(cost > maxCost ? vec3(1.0) : Ramp(cost / maxCost), 1.0);
+}
@@ -8,20 +8,37 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
-#include <learnopengl/model.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
 #include <raytracing/sphere.h>
 #include <raytracing/bvh.h>
 #include <raytracing/scene.h>
+#include <raytracing/scene_file.h>
 #include <raytracing/hittable_list.h>
+#include <raytracing/material_pool.h>
+#include <raytracing/scene_features.h>
+#include <raytracing/scene_uniforms.h>
+#include <raytracing/denoiser.h>
+#include <raytracing/denoiser_cpu.h>
+#include <raytracing/dynamic_resolution.h>
+#include <raytracing/tile_scheduler.h>
+#include <raytracing/profiler.h>
+#include <raytracing/camera_path.h>
+#include <raytracing/traversal_cost.h>
+#include <raytracing/gbuffer.h>
+#include <raytracing/mesh_import.h>
+#include <raytracing/asset_loader.h>
+#include <raytracing/skeletal_animation.h>
+#include <raytracing/skinning.h>
 #include <iostream>
 #include <vector>
 #include <map>
 #include <iostream>
 #include <random>
+#include <fstream>
+#include <memory>
 
-// #define STB_IMAGE_IMPLEMENTATION
-// #include "stb_image.h"
-
+void Run(GLFWwindow* window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -31,13 +48,76 @@ unsigned int loadCubemap(std::vector<std::string> faces);
 void SortObjects(HittableList& objects);
 void WriteObjectsData();
 void WriteBVHNodesData();
-void WriteTrianglesData(Model& m);
-AABB AABBofModel(Model& m);
+int BuildScene(const std::vector<TriangleMesh>& meshes, MaterialPool& materialPool);
+int WriteTrianglesData(const std::vector<TriangleMesh>& meshes);
+AABB AABBofModel(const std::vector<TriangleMesh>& meshes);
+AnimationClip SwayClip(const AABB& box, int boneCount);
+void RefitModelNode(const AABB& box);
 
 // settings
 const unsigned int SCR_WIDTH = 1080;
 const unsigned int SCR_HEIGHT = 720;
 const unsigned int BIG_DATA_SIZE = 100000;
+const int SAMPLES_PER_PIXEL = 2;
+const int MAX_DEPTH = 7;
+
+// the tracer is compiled for the features of the loaded scene, linked programs are
+// cached in SHADER_CACHE_DIR so the next start skips compiling, empty to disable
+const bool SPECIALIZE_SHADER = true;
+const char* SHADER_CACHE_DIR = "shader_cache";
+
+// denoiser
+const bool DENOISE = true;
+const bool DENOISE_TEMPORAL = true;
+const bool DENOISE_ON_CPU = false;
+
+// dynamic resolution: the tracer renders below window size to hold the frame time
+const bool DYNAMIC_RESOLUTION = true;
+const float TARGET_FRAME_MS = 16.6f;
+// tiled tracing: each frame traces only the tiles that fit TRACE_BUDGET_MS and presents
+// the progressive image, the other tiles follow in the next frames
+const bool TILED_TRACE = true;
+const int TILE_SIZE = 64;
+const float TRACE_BUDGET_MS = 10.0f;
+// hybrid tracing: the first hit of every camera ray is rasterized into a G-buffer and the
+// tracer only follows the bounces from there. primary rays go through pixel centers, so
+// edges lose their antialiasing
+const bool HYBRID_PRIMARY = false;
+// profiling: gpu phase bars in the top left corner and timings in the window title,
+// a chrome trace of every phase is written on exit, empty path to skip it
+const bool PROFILE_OVERLAY = true;
+const char* PROFILE_TRACE = "profile_trace.json";
+// traversal heatmap: the tracer writes what each pixel costs instead of its color and the
+// window shows HEATMAP_CHANNEL as a false colour ramp up to HEATMAP_MAX_COST. statistics of
+// a cpu reference are printed at startup and of the last gpu image on exit
+const bool TRAVERSAL_HEATMAP = false;
+const int HEATMAP_CHANNEL = COST_NODES;
+const float HEATMAP_MAX_COST = 200.0f;
+// per-frame render resolution and times (gpu, frame and tracer submit) as csv, such as
+// "resolution_log.csv". empty to disable
+const char* RESOLUTION_LOG = "";
+// camera path: CAMERA_RECORD saves the camera of every frame on exit, CAMERA_REPLAY drives the
+// camera from such a file at REPLAY_TIMESTEP per frame, ignores input, prints every frame time
+// and closes the window at the end of the path. empty paths to disable
+const char* CAMERA_RECORD = "";
+const char* CAMERA_REPLAY = "";
+const float REPLAY_TIMESTEP = 1.0f / 60.0f;
+// asset loading: the model and the environment load on worker threads while the first frames
+// trace the scene without the model under a plain sky, they pop in once uploaded.
+// false waits for them before the first frame
+const bool ASYNC_LOADING = true;
+const glm::vec3 PLACEHOLDER_SKY(0.7f, 0.8f, 1.0f);
+// decoded textures and their mips are kept in TEXTURE_STORE_DIR so the next start skips
+// decoding them, empty to disable
+const char* TEXTURE_STORE_DIR = TEXTURE_CACHE_DIR;
+// skinned model: the model is bound to SKIN_BONES bones stacked along its height that sway
+// back and forth. it is skinned on the cpu every frame, its bvh refit and only the triangles
+// that moved are uploaded. false keeps it static
+const bool SKINNED_MODEL = false;
+const int SKIN_BONES = 6;
+// scene description, text or binary, relative to the repository root. empty for DisplayScene
+// with the rock and the skybox
+const char* SCENE_FILE = "resources/scenes/display.rtscene";
 
 const int MAT_LAMBERTIAN = 0;
 const int MAT_METALLIC =  1;
@@ -51,10 +131,13 @@ const int OBJ_MODEL = 5;
 
 //Camera camera(glm::vec3(-5.0f, 4.0f, 4.0f));
 Camera camera(glm::vec3(13.0f, 2.0f, 3.0f));
+float cameraVfov = 20.0f;
 // Camera camera(glm::vec3(278.0f, 278.0f, -800.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+// the camera follows a recorded path, input only closes the window
+bool cameraReplay = false;
 
 // timing
 float deltaTime = 0.0f;
@@ -62,10 +145,18 @@ float lastFrame = 0.0f;
 
 // spheres
 HittableList objects;
+SceneFile sceneFile;
 std::vector<BVHNode> BVHNodes;
 float (*objectsData)[4] = new float[BIG_DATA_SIZE][4];
 float (*BVHNodesData)[4] = new float[BIG_DATA_SIZE][4];
 float (*triangleData)[4] = new float[BIG_DATA_SIZE][4];
+// the model's own bvh, its triangles are stored in its leaf order
+DeformableMesh modelMesh;
+float (*modelBVHData)[4] = new float[BIG_DATA_SIZE][4];
+// bones of the skinned model
+AnimationClip swayClip;
+AnimationState swayState;
+std::vector<glm::mat4> skinBones;
 
 // void 
 int main()
@@ -102,12 +193,88 @@ int main()
         return -1;
     }
 
-    // build and compile shaders
-    Shader shader(FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.vs").c_str(),
-         FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.fs").c_str());
+    Run(window);
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
+    return 0;
+}
+
+// everything that owns GL objects lives in here, so it is gone before glfwTerminate takes
+// the context away
+void Run(GLFWwindow* window)
+{
+    Profiler profiler;
+
+    // assets
+    // ------
+    // started before anything else so the decoding overlaps shader builds and the first frames,
+    // the callbacks run on this thread from loader.ProcessUploads in the render loop
+    SharedTextureCache().directory = TEXTURE_STORE_DIR;
+    // the scene file brings the camera, the model and the sky, the built in scene uses these
+    std::string modelPath = "resources/objects/rock/rock.obj";
+    // std::string modelPath = "resources/objects/bunny/bunny.obj";
+    std::vector<std::string> faces
+    {
+        "resources/textures/skybox/right.jpg",
+        "resources/textures/skybox/left.jpg",
+        "resources/textures/skybox/top.jpg",
+        "resources/textures/skybox/bottom.jpg",
+        "resources/textures/skybox/front.jpg",
+        "resources/textures/skybox/back.jpg"
+    };
+    if(SCENE_FILE[0] != '\0' && sceneFile.Load(FileSystem::getPath(SCENE_FILE)))
+    {
+        const SceneCamera& view = sceneFile.camera;
+        camera = Camera(view.position, glm::vec3(0.0f, 1.0f, 0.0f), view.yaw, view.pitch);
+        cameraVfov = view.vfov;
+        modelPath = sceneFile.instances.empty() ? "" : sceneFile.meshes[sceneFile.instances[0].mesh];
+        faces = sceneFile.environment;
+    }
+    for(std::string& face : faces)
+    {
+        face = FileSystem::getPath(face);
+    }
+
+    AssetLoader loader;
+    std::vector<TriangleMesh> modelMeshes;
+    bool modelArrived = false;
+    if(!modelPath.empty())
+    {
+        loader.LoadMeshes(FileSystem::getPath(modelPath),
+            [&](std::vector<TriangleMesh>& meshes)
+            {
+                modelMeshes = std::move(meshes);
+                modelArrived = true;
+            });
+    }
+    unsigned int cubemapTexture = CreateSolidCubemap(PLACEHOLDER_SKY);
+    bool environmentArrived = false;
+    if(faces.size() == 6)
+    {
+        loader.LoadCubemap(faces, [&](unsigned int texture)
+        {
+            if(texture != 0)
+            {
+                glDeleteTextures(1, &cubemapTexture);
+                cubemapTexture = texture;
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glActiveTexture(GL_TEXTURE0);
+                environmentArrived = true;
+            }
+        });
+    }
+    if(!ASYNC_LOADING)
+    {
+        while(loader.Pending() > 0)
+        {
+            loader.ProcessUploads();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
 
-    Model model(FileSystem::getPath("resources/objects/rock/rock.obj"));
-    // Model model(FileSystem::getPath("resources/objects/bunny/bunny.obj"));
     float vertices[] = 
     {
 			 1.0f,  1.0f, 0.0f,  // top right
@@ -182,16 +349,6 @@ int main()
          1.0f, -1.0f,  1.0f
     };
 
-    std::vector<std::string> faces
-    {
-        FileSystem::getPath("resources/textures/skybox/right.jpg"),
-        FileSystem::getPath("resources/textures/skybox/left.jpg"),
-        FileSystem::getPath("resources/textures/skybox/top.jpg"),
-        FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-        FileSystem::getPath("resources/textures/skybox/front.jpg"),
-        FileSystem::getPath("resources/textures/skybox/back.jpg")
-    };
-
     // skybox VAO
     // ----------
     // skybox VAO
@@ -204,40 +361,192 @@ int main()
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    unsigned int cubemapTexture = loadCubemap(faces);
-
     // create tbo data
     // ---------------
-    AABB aabbModel = AABBofModel(model);
-    // Scene1(objects, aabbModel);
-    DisplayScene(objects, aabbModel);
-    // RandomScene(objects);
-    // CornellBox(objects);
-    SortObjects(objects);
-    WriteObjectsData();
-    WriteBVHNodesData();
-    WriteTrianglesData(model);
-    cout << aabbModel.minimum[0] << " " << aabbModel.minimum[1] << " " << aabbModel.minimum[2] << endl;
-    cout << aabbModel.maximum[0] << " " << aabbModel.maximum[1] << " " << aabbModel.maximum[2] << endl;
+    // the model is an empty box at the origin until its meshes arrive, the scene is rebuilt
+    // then with the same objects, so the specialized shader and the BVH depth stay valid
+    MaterialPool materialPool;
+    int triangleCount;
+    {
+        CpuProfileScope scope(profiler, "scene");
+        triangleCount = BuildScene(modelMeshes, materialPool);
+    }
+    // whatever arrived so far is part of the scene already
+    modelArrived = false;
+    environmentArrived = false;
+
+    // build and compile shaders
+    // -------------------------
+    profiler.BeginCpu("shader build");
+    SceneFeatures features(objects, SAMPLES_PER_PIXEL, MAX_DEPTH, BVHDepth(BVHNodes, BVHNodes.size() - 1));
+    std::string defines = SPECIALIZE_SHADER ? features.Defines() : "";
+    if(TRAVERSAL_HEATMAP)
+    {
+        defines += "#define TRAVERSAL_HEATMAP\n";
+    }
+    if(HYBRID_PRIMARY)
+    {
+        defines += "#define HYBRID_PRIMARY\n";
+    }
+    Shader shader = !defines.empty() ?
+        Shader(FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.vs").c_str(),
+            FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.fs").c_str(),
+            defines, SHADER_CACHE_DIR) :
+        Shader(FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.vs").c_str(),
+            FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.fs").c_str());
+    profiler.EndCpu();
     
     // generate buffer texture
     // -----------------------
-    unsigned int tboSpheresId[3], tboBufferId[3];
-    glGenTextures(3, tboSpheresId);
-    glGenBuffers(3, tboBufferId);
+    profiler.BeginCpu("upload");
+    unsigned int tboSpheresId[4], tboBufferId[4];
+    glGenTextures(4, tboSpheresId);
+    glGenBuffers(4, tboBufferId);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[0]);
     glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, objectsData, GL_STATIC_DRAW);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[1]);
     glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, BVHNodesData, GL_STATIC_DRAW);
     glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[2]);
-    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, triangleData, GL_STATIC_DRAW);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, triangleData, SKINNED_MODEL ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[3]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, modelBVHData, SKINNED_MODEL ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+
+
+    // the buffer textures and the environment stay bound to units 0-3 for the whole run
+    for(int i = 0; i < 3; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[i]);
+    }
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    // the model's bvh on unit 8, the denoiser rebinds 6 for its own passes
+    glActiveTexture(GL_TEXTURE8);
+    glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[3]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[3]);
+    // the deduplicated materials go to unit 7, clear of the G-buffer and denoiser units
+    std::vector<float> materialsData = materialPool.Pack();
+    unsigned int materialsTexture, materialsBuffer;
+    glGenTextures(1, &materialsTexture);
+    glGenBuffers(1, &materialsBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, materialsBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * materialsData.size(), materialsData.data(), GL_STATIC_DRAW);
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_BUFFER, materialsTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialsBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glFinish();
+    profiler.EndCpu();
+    std::cout << "startup" << std::endl;
+    profiler.Report(std::cout);
+
+    // traversal cost
+    // --------------
+    TraversalHeatmap heatmap(FileSystem::getPath("src/ray_tracing_optimize"));
+    heatmap.channel = HEATMAP_CHANNEL;
+    heatmap.maxCost = HEATMAP_MAX_COST;
+    std::vector<glm::vec3> modelPositions = modelMesh.CornerPositions(), modelNormals = modelMesh.CornerNormals();
+    // a quarter of the window per axis is plenty for the statistics
+    auto traceCpuCost = [&]()
+    {
+        CpuProfileScope scope(profiler, "cpu traversal cost");
+        TraversalCostTracer costTracer(objects, BVHNodes, BVHNodes.size() - 1, modelPositions, &modelMesh.BVH());
+        PrintTraversalStats("cpu traversal cost, primary rays",
+            costTracer.Trace(camera.Position, camera.Position + camera.Front, camera.WorldUp, cameraVfov,
+                (float)SCR_WIDTH / SCR_HEIGHT, SCR_WIDTH / 4, SCR_HEIGHT / 4), std::cout);
+    };
+    if(TRAVERSAL_HEATMAP && loader.Pending() == 0)
+    {
+        traceCpuCost();
+    }
 
     shader.use();
-    shader.setInt("objectsData", 0);
+    shader.setInt("spheresData", 0);
     shader.setInt("BVHNodesData", 1);
     shader.setInt("trianglesData", 2);
     shader.setInt("envMap", 3);
+    shader.setInt("materialsData", 7);
+    shader.setInt("modelBVHData", 8);
+    shader.setInt("samplesPerPixel", SAMPLES_PER_PIXEL);
+    shader.bindUniformBlock("SceneParameters", SceneUniforms::BINDING);
+    if(HYBRID_PRIMARY)
+    {
+        shader.setInt("gbufferPositionType", 4);
+        shader.setInt("gbufferNormalIndex", 5);
+    }
+    Uniform<glm::vec2> screenSizeUniform = shader.uniform<glm::vec2>("screenSize");
+    Uniform<int> frameIndexUniform = shader.uniform<int>("frameIndex");
+
+    // camera and world go through a uniform buffer that is only rewritten when they change
+    SceneUniforms sceneUniforms;
+    sceneUniforms.SetWorld(objects.size(), triangleCount, BVHNodes.size() - 1);
+
+    // denoiser
+    // --------
+    Denoiser denoiser(SCR_WIDTH, SCR_HEIGHT, FileSystem::getPath("src/ray_tracing_optimize"));
+    CpuDenoiser cpuDenoiser(SCR_WIDTH, SCR_HEIGHT);
+    std::vector<float> readbackColor, readbackNormalDepth, readbackAlbedo, cpuDenoised;
+    unsigned int cpuOutputFBO = 0, cpuOutputTexture = 0;
+    if(DENOISE_ON_CPU)
+    {
+        readbackColor.resize(SCR_WIDTH * SCR_HEIGHT * 4);
+        readbackNormalDepth.resize(SCR_WIDTH * SCR_HEIGHT * 4);
+        readbackAlbedo.resize(SCR_WIDTH * SCR_HEIGHT * 4);
+        cpuDenoised.resize(SCR_WIDTH * SCR_HEIGHT * 4);
+        glGenFramebuffers(1, &cpuOutputFBO);
+        glGenTextures(1, &cpuOutputTexture);
+        glBindTexture(GL_TEXTURE_2D, cpuOutputTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, cpuOutputFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cpuOutputTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
 
+    // dynamic resolution
+    // ------------------
+    DynamicResolution resolution(SCR_WIDTH, SCR_HEIGHT, TARGET_FRAME_MS);
+    Upscaler upscaler(SCR_WIDTH, SCR_HEIGHT, FileSystem::getPath("src/ray_tracing_optimize"));
+    GpuFrameTimer gpuTimer;
+    // hybrid primary visibility, the G-buffer only changes with the camera or the resolution.
+    // it is only made when the mode is on
+    std::unique_ptr<GBuffer> gbuffer;
+    bool gbufferValid = false;
+    if(HYBRID_PRIMARY)
+    {
+        gbuffer = std::make_unique<GBuffer>(SCR_WIDTH, SCR_HEIGHT, FileSystem::getPath("src/ray_tracing_optimize"));
+        gbuffer->Build(objects, modelPositions, modelNormals);
+    }
+    TileScheduler tiles(SCR_WIDTH, SCR_HEIGHT, TILE_SIZE, TRACE_BUDGET_MS);
+    int renderWidth = SCR_WIDTH, renderHeight = SCR_HEIGHT;
+    std::ofstream resolutionLog;
+    if(RESOLUTION_LOG[0] != '\0')
+    {
+        resolutionLog.open(RESOLUTION_LOG);
+        resolutionLog << "frame,width,height,gpu_ms,cpu_ms,submit_ms" << std::endl;
+    }
+    glm::vec3 lastPosition = camera.Position;
+    glm::vec3 lastFront = camera.Front;
+    int frameIndex = 0;
+    // cpu time spent issuing the tracer draw
+    double submitMs = 0.0;
+    float lastTitleUpdate = 0.0f;
+    // cost images are not denoised, blending them would hide the outliers
+    const bool denoise = DENOISE && !TRAVERSAL_HEATMAP;
+    bool sceneComplete = false;
+
+    // camera path
+    // -----------
+    CameraPath cameraPath;
+    int replayFrame = 0, replayFrameCount = 0;
+    if(CAMERA_REPLAY[0] != '\0' && cameraPath.Load(CAMERA_REPLAY))
+    {
+        cameraReplay = true;
+        replayFrameCount = cameraPath.FrameCount(REPLAY_TIMESTEP);
+        std::cout << "replaying " << CAMERA_REPLAY << ", " << replayFrameCount << " frames" << std::endl;
+    }
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -248,50 +557,269 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        profiler.BeginFrame();
+
+        // assets
+        // ------
+        loader.ProcessUploads();
+        if(modelArrived)
+        {
+            CpuProfileScope scope(profiler, "scene");
+            triangleCount = BuildScene(modelMeshes, materialPool);
+            glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[0]);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 2 * objects.size(), objectsData);
+            glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[1]);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 3 * BVHNodes.size(), BVHNodesData);
+            glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[2]);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 6 * triangleCount, triangleData);
+            glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[3]);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 2 * modelMesh.BVH().NodeCount(), modelBVHData);
+            sceneUniforms.SetWorld(objects.size(), triangleCount, BVHNodes.size() - 1);
+            modelPositions = modelMesh.CornerPositions();
+            modelNormals = modelMesh.CornerNormals();
+            if(HYBRID_PRIMARY)
+            {
+                gbuffer->Build(objects, modelPositions, modelNormals);
+            }
+        }
+        if(modelArrived || environmentArrived)
+        {
+            // nothing traced so far shows the new scene
+            denoiser.ResetHistory();
+            cpuDenoiser.ResetHistory();
+            tiles.Restart();
+            gbufferValid = false;
+            if(TRAVERSAL_HEATMAP && modelArrived)
+            {
+                traceCpuCost();
+            }
+            modelArrived = false;
+            environmentArrived = false;
+        }
+
+        // skinning
+        // --------
+        if(SKINNED_MODEL && modelMesh.TriangleCount() > 0)
+        {
+            CpuProfileScope scope(profiler, "skinning");
+            swayClip.Advance(swayState, deltaTime);
+            swayClip.Evaluate(swayState, skinBones.data(), SKIN_BONES);
+            if(modelMesh.Update(skinBones.data()))
+            {
+                modelMesh.Upload(tboBufferId[2], triangleData, tboBufferId[3], modelBVHData);
+                // the model's top level box follows the refit one
+                const MeshBVH& bvh = modelMesh.BVH();
+                RefitModelNode(AABB(bvh.Minimum(), bvh.Maximum()));
+                glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[1]);
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * 4 * 3 * BVHNodes.size(), BVHNodesData);
+                if(HYBRID_PRIMARY)
+                {
+                    gbuffer->Build(objects, modelMesh.CornerPositions(), modelMesh.CornerNormals());
+                }
+                // the gpu denoiser only reprojects camera motion, moved triangles would ghost
+                // through its history, so both start over like after a model swap
+                denoiser.ResetHistory();
+                cpuDenoiser.ResetHistory();
+                tiles.Restart();
+                gbufferValid = false;
+            }
+        }
+
         // input
         // -----
         processInput(window);
+        if(cameraReplay)
+        {
+            cameraPath.Apply(replayFrame, REPLAY_TIMESTEP, camera);
+        }
+        else if(CAMERA_RECORD[0] != '\0')
+        {
+            cameraPath.Record(currentFrame, camera);
+        }
+
+        // pick the render resolution from the last measured frame, the gpu time when there is one.
+        // a tiled frame is timed as the slice plus everything after it
+        float gpuMs = gpuTimer.LastMs();
+        if(TILED_TRACE && gpuMs > 0.0f && tiles.LastSliceMs() > 0.0f)
+        {
+            gpuMs += tiles.LastSliceMs();
+        }
+        float frameMs = gpuMs > 0.0f ? gpuMs : deltaTime * 1000.0f;
+        if(resolutionLog.is_open())
+        {
+            resolutionLog << frameIndex << "," << renderWidth << "," << renderHeight << ","
+                << gpuMs << "," << deltaTime * 1000.0f << "," << submitMs << "\n";
+        }
+        if(DYNAMIC_RESOLUTION && resolution.Update(frameMs))
+        {
+            renderWidth = resolution.RenderWidth();
+            renderHeight = resolution.RenderHeight();
+            std::cout << "render resolution " << renderWidth << "x" << renderHeight << " at " << frameMs << " ms" << std::endl;
+            upscaler.Resize(renderWidth, renderHeight);
+            denoiser.Resize(renderWidth, renderHeight);
+            tiles.Resize(renderWidth, renderHeight);
+            if(HYBRID_PRIMARY)
+            {
+                gbuffer->Resize(renderWidth, renderHeight);
+            }
+            gbufferValid = false;
+            if(DENOISE_ON_CPU)
+            {
+                cpuDenoiser = CpuDenoiser(renderWidth, renderHeight);
+                glBindTexture(GL_TEXTURE_2D, cpuOutputTexture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, renderWidth, renderHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+            }
+        }
+
+        // the gpu denoiser reprojects its history along the camera motion,
+        // the cpu one only accumulates while the view stays put. a move starts a new tile pass
+        glm::mat4 viewProjection = glm::perspective(glm::radians(cameraVfov), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 10000.0f) *
+            glm::lookAt(camera.Position, camera.Position + camera.Front, camera.WorldUp);
+        denoiser.SetCamera(viewProjection, camera.Position);
+        bool cameraMoved = camera.Position != lastPosition || camera.Front != lastFront;
+        lastPosition = camera.Position;
+        lastFront = camera.Front;
+        if(cameraMoved)
+        {
+            cpuDenoiser.ResetHistory();
+            tiles.Restart();
+            gbufferValid = false;
+        }
 
         // render
         // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if(!TILED_TRACE)
+        {
+            gpuTimer.Begin();
+        }
+        if(HYBRID_PRIMARY && !gbufferValid)
+        {
+            profiler.BeginGpu("gbuffer");
+            gbuffer->Render(camera.Position, camera.Position + camera.Front, camera.WorldUp, cameraVfov, (float)SCR_WIDTH / SCR_HEIGHT);
+            profiler.EndGpu();
+            gbufferValid = true;
+        }
+        if(denoise)
+        {
+            denoiser.BindTraceTarget();
+        }
+        else
+        {
+            upscaler.BindSource();
+        }
+        if(!TILED_TRACE)
+        {
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         /*glBindBuffer(GL_UNIFORM_BUFFER, uboSpheres);
         glBufferData(GL_UNIFORM_BUFFER, sizeof(spheresParamter), &spheresParamter, GL_STATIC_DRAW);
         glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboSpheres, 0, sizeof(spheresParamter));
         glBindBuffer(GL_UNIFORM_BUFFER, 0);*/
         
+        double submitStart = glfwGetTime();
         shader.use();
-
-        shader.setVec2("screenSize", { SCR_WIDTH, SCR_HEIGHT });
-        shader.setVec3("cameraParameter.lookFrom", camera.Position);
-        shader.setVec3("cameraParameter.lookAt", camera.Position + camera.Front);
-        shader.setVec3("cameraParameter.vup", camera.WorldUp);
-        shader.setFloat("cameraParameter.vfov", 20.0);
-        shader.setFloat("cameraParameter.aspectRatio", (float)SCR_WIDTH/SCR_HEIGHT);
-        shader.setInt("world.objectCount", objects.size());
-        shader.setInt("world.nodesHead", BVHNodes.size() - 1);
-        shader.setInt("world.triangleCount", model.meshes[0].indices.size() / 3);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[0]);
-        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[1]);
-        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[1]);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[2]);
-        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[2]);
+        shader.set(screenSizeUniform, glm::vec2(renderWidth, renderHeight));
+        shader.set(frameIndexUniform, frameIndex++);
+        sceneUniforms.SetCamera(camera.Position, camera.Position + camera.Front, camera.WorldUp, cameraVfov, (float)SCR_WIDTH / SCR_HEIGHT);
+        sceneUniforms.Upload();
+        if(HYBRID_PRIMARY)
+        {
+            // the denoiser passes use these units too
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D, gbuffer->PositionTexture());
+            glActiveTexture(GL_TEXTURE5);
+            glBindTexture(GL_TEXTURE_2D, gbuffer->NormalTexture());
+            glActiveTexture(GL_TEXTURE0);
+        }
     
         glBindVertexArray(VAO);
-        
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        profiler.BeginGpu("trace");
+        if(TILED_TRACE)
+        {
+            // the rest of the target keeps what earlier slices traced
+            int tileCount = tiles.BeginSlice();
+            for(int i = 0; i < tileCount; ++i)
+            {
+                tiles.ScissorTile(i);
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            }
+            // camera rays only, the fragment tracer does not count its bounces
+            profiler.AddRays((double)tiles.SlicePixels() * SAMPLES_PER_PIXEL);
+            tiles.EndSlice();
+        }
+        else
+        {
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            profiler.AddRays((double)renderWidth * renderHeight * SAMPLES_PER_PIXEL);
+        }
+        profiler.EndGpu();
         glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        submitMs = (glfwGetTime() - submitStart) * 1000.0;
+        if(TILED_TRACE)
+        {
+            gpuTimer.Begin();
+        }
+
+        // denoise
+        // -------
+        // a tiled trace target holds new samples only in this slice's tiles, the history takes
+        // it once a whole pass is traced. until then the gpu denoiser filters without keeping it
+        // and the cpu one keeps showing what it made of the last pass
+        bool passTraced = !TILED_TRACE || tiles.PassComplete();
+        profiler.BeginGpu("denoise");
+        if(denoise && DENOISE_ON_CPU && passTraced)
+        {
+            glBindTexture(GL_TEXTURE_2D, denoiser.ColorTexture());
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, readbackColor.data());
+            glBindTexture(GL_TEXTURE_2D, denoiser.NormalDepthTexture());
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, readbackNormalDepth.data());
+            glBindTexture(GL_TEXTURE_2D, denoiser.AlbedoTexture());
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, readbackAlbedo.data());
+            cpuDenoiser.Denoise(readbackColor.data(), readbackNormalDepth.data(), readbackAlbedo.data(),
+                DENOISE_TEMPORAL, cpuDenoised.data());
+            glBindTexture(GL_TEXTURE_2D, cpuOutputTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, renderWidth, renderHeight, GL_RGBA, GL_FLOAT, cpuDenoised.data());
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cpuOutputFBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, upscaler.SourceFBO());
+            glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        else if(denoise && !DENOISE_ON_CPU)
+        {
+            denoiser.Denoise(VAO, DENOISE_TEMPORAL, upscaler.SourceFBO(), renderWidth, renderHeight, passTraced);
+        }
+        profiler.EndGpu();
+
+        // upscale
+        // -------
+        profiler.BeginGpu("upscale");
+        if(TRAVERSAL_HEATMAP)
+        {
+            heatmap.Draw(VAO, upscaler.SourceTexture(), framebufferWidth, framebufferHeight);
+        }
+        else
+        {
+            upscaler.Upscale(VAO, framebufferWidth, framebufferHeight);
+        }
+        profiler.EndGpu();
+        gpuTimer.End();
+
+        // profiling overlay
+        // -----------------
+        if(PROFILE_OVERLAY)
+        {
+            profiler.DrawOverlay(framebufferWidth, framebufferHeight);
+            if(currentFrame - lastTitleUpdate > 0.5f)
+            {
+                glfwSetWindowTitle(window, ("OpenGLRayTracing | " + profiler.Summary()).c_str());
+                lastTitleUpdate = currentFrame;
+            }
+        }
         
         /*std::cout << camera.Position[0] << " " << camera.Position[1] << " " << camera.Position[2] << std::endl;
         std::cout << camera.Front[0] << " " << camera.Front[1] << " " << camera.Front[2] << std::endl;*/
@@ -300,6 +828,45 @@ int main()
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+        profiler.EndFrame();
+
+        // startup times count from glfwInit
+        if(frameIndex == 1)
+        {
+            std::cout << "first frame " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+        }
+        if(!sceneComplete && loader.Pending() == 0)
+        {
+            std::cout << "full scene " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            SharedTextureCache().PrintStats(std::cout);
+            sceneComplete = true;
+        }
+
+        if(cameraReplay)
+        {
+            std::cout << "replay frame " << replayFrame << " " << (glfwGetTime() - currentFrame) * 1000.0 << " ms" << std::endl;
+            if(++replayFrame >= replayFrameCount)
+            {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
+    }
+
+    if(!cameraReplay && CAMERA_RECORD[0] != '\0')
+    {
+        cameraPath.Save(CAMERA_RECORD);
+    }
+
+    std::cout << "run" << std::endl;
+    profiler.Report(std::cout);
+    if(PROFILE_TRACE[0] != '\0')
+    {
+        profiler.WriteChromeTrace(PROFILE_TRACE);
+    }
+    if(TRAVERSAL_HEATMAP)
+    {
+        PrintTraversalStats("gpu traversal cost, per sample over all bounces",
+            ReadTraversalCost(upscaler.SourceTexture(), renderWidth, renderHeight), std::cout);
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -307,15 +874,18 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(3, tboBufferId);
+    glDeleteBuffers(4, tboBufferId);
+    glDeleteBuffers(1, &materialsBuffer);
+    glDeleteTextures(1, &materialsTexture);
+    if(DENOISE_ON_CPU)
+    {
+        glDeleteFramebuffers(1, &cpuOutputFBO);
+        glDeleteTextures(1, &cpuOutputTexture);
+    }
     delete[] objectsData;
     delete[] BVHNodesData;
     delete[] triangleData;
-
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    delete[] modelBVHData;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -325,6 +895,9 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+	if (cameraReplay)
+		return;
+
 	float xpos = static_cast<float> (xposIn);
 	float ypos = static_cast<float> (yposIn);
 
@@ -346,6 +919,8 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	if (cameraReplay)
+		return;
 	camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
@@ -353,6 +928,8 @@ void processInput(GLFWwindow* window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+	if (cameraReplay)
+		return;
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -403,35 +980,10 @@ unsigned int loadTexture(const char* path)
     }
     return textureID;
 }
+// faces decoded on an earlier run come from the texture cache's store
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); ++i)
-    {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout<< "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return SharedTextureCache().Cubemap(faces);
 }
 
 void SortObjects(HittableList& objects)
@@ -459,64 +1011,47 @@ void SortObjects(HittableList& objects)
 
 void WriteObjectsData()
 {
+    // two texels per object, the material is an index into the materials buffer:
+    // sphere [center, radius] [material, 0, 0, 0]
+    // rect   [a0, a1, b0, b1] [material, k, 0, 0]
     for(int i = 0; i < objects.size(); ++i)
     {
+        float* bounds = objectsData[i*2];
+        float* extra = objectsData[i*2+1];
+        extra[0] = objects[i]->materialIndex;
+        extra[1] = 0.0f;
+        extra[2] = 0.0f;
+        extra[3] = 0.0f;
         switch(objects[i]->objectType)
         {
             case OBJ_SPHERE:
-                objectsData[i*3][0] = objects[i]->center[0];
-                objectsData[i*3][1] = objects[i]->center[1];
-                objectsData[i*3][2] = objects[i]->center[2];
-                objectsData[i*3][3] = objects[i]->radius;
-                objectsData[i*3+1][0] = objects[i]->matPtr->color[0];
-                objectsData[i*3+1][1] = objects[i]->matPtr->color[1];
-                objectsData[i*3+1][2] = objects[i]->matPtr->color[2];
-                objectsData[i*3+1][3] = objects[i]->matPtr->materialType;
-                objectsData[i*3+2][0] = objects[i]->matPtr->roughness;
-                objectsData[i*3+2][1] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->center[0];
+                bounds[1] = objects[i]->center[1];
+                bounds[2] = objects[i]->center[2];
+                bounds[3] = objects[i]->radius;
             break;
             case OBJ_XYRECT:
-                objectsData[i*3][0] = objects[i]->x0;
-                objectsData[i*3][1] = objects[i]->x1;
-                objectsData[i*3][2] = objects[i]->y0;
-                objectsData[i*3][3] = objects[i]->y1;
-                objectsData[i*3+1][0] = objects[i]->matPtr->color[0];
-                objectsData[i*3+1][1] = objects[i]->matPtr->color[1];
-                objectsData[i*3+1][2] = objects[i]->matPtr->color[2];
-                objectsData[i*3+1][3] = objects[i]->k;
-                objectsData[i*3+2][0] = objects[i]->matPtr->materialType;
-                objectsData[i*3+2][1] = objects[i]->matPtr->roughness;
-                objectsData[i*3+2][2] = objects[i]->matPtr->ior;
-                
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->y0;
+                bounds[3] = objects[i]->y1;
+                extra[1] = objects[i]->k;
             break;
             case OBJ_XZRECT:
-                objectsData[i*3][0] = objects[i]->x0;
-                objectsData[i*3][1] = objects[i]->x1;
-                objectsData[i*3][2] = objects[i]->z0;
-                objectsData[i*3][3] = objects[i]->z1;
-                objectsData[i*3+1][0] = objects[i]->matPtr->color[0];
-                objectsData[i*3+1][1] = objects[i]->matPtr->color[1];
-                objectsData[i*3+1][2] = objects[i]->matPtr->color[2];
-                objectsData[i*3+1][3] = objects[i]->k;
-                objectsData[i*3+2][0] = objects[i]->matPtr->materialType;
-                objectsData[i*3+2][1] = objects[i]->matPtr->roughness;
-                objectsData[i*3+2][2] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
             break;
             case OBJ_YZRECT:
-                objectsData[i*3][0] = objects[i]->y0;
-                objectsData[i*3][1] = objects[i]->y1;
-                objectsData[i*3][2] = objects[i]->z0;
-                objectsData[i*3][3] = objects[i]->z1;
-                objectsData[i*3+1][0] = objects[i]->matPtr->color[0];
-                objectsData[i*3+1][1] = objects[i]->matPtr->color[1];
-                objectsData[i*3+1][2] = objects[i]->matPtr->color[2];
-                objectsData[i*3+1][3] = objects[i]->k;
-                objectsData[i*3+2][0] = objects[i]->matPtr->materialType;
-                objectsData[i*3+2][1] = objects[i]->matPtr->roughness;
-                objectsData[i*3+2][2] = objects[i]->matPtr->ior;
+                bounds[0] = objects[i]->y0;
+                bounds[1] = objects[i]->y1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
             break;
         }
-        
     }
 }
 
@@ -529,13 +1064,13 @@ void WriteBVHNodesData()
         BVHNodesData[3 * i][0] = BVHNodes[i].aabb.minimum[0];
         BVHNodesData[3 * i][1] = BVHNodes[i].aabb.minimum[1];
         BVHNodesData[3 * i][2] = BVHNodes[i].aabb.minimum[2];
-        BVHNodesData[3 * i][3] = BVHNodes[i].objectIndex;
+        BVHNodesData[3 * i][3] = NodeIndexTexel(BVHNodes[i].objectIndex);
         BVHNodesData[3 * i + 1][0] = BVHNodes[i].aabb.maximum[0];
         BVHNodesData[3 * i + 1][1] = BVHNodes[i].aabb.maximum[1];
         BVHNodesData[3 * i + 1][2] = BVHNodes[i].aabb.maximum[2];
-        BVHNodesData[3 * i + 1][3] = BVHNodes[i].objectType;
-        BVHNodesData[3 * i + 2][0] = BVHNodes[i].left;
-        BVHNodesData[3 * i + 2][1] = BVHNodes[i].right;
+        BVHNodesData[3 * i + 1][3] = NodeIndexTexel(BVHNodes[i].objectType);
+        BVHNodesData[3 * i + 2][0] = NodeIndexTexel(BVHNodes[i].left);
+        BVHNodesData[3 * i + 2][1] = NodeIndexTexel(BVHNodes[i].right);
     }
     // for(auto & i:BVHNodes)
     // {
@@ -543,67 +1078,126 @@ void WriteBVHNodesData()
     // }
 }
 
-void WriteTrianglesData(Model& m)
+// the demo scene around the model, packed into the buffers. returns the model's triangle count
+int BuildScene(const std::vector<TriangleMesh>& meshes, MaterialPool& materialPool)
+{
+    AABB aabbModel = AABBofModel(meshes);
+    // a scene file that doesn't fit the buffers is dropped for good, the built in scene stands in
+    if(sceneFile.ObjectCount() * SCENE_OBJECT_TEXELS > BIG_DATA_SIZE || sceneFile.NodeCount() * SCENE_NODE_TEXELS > BIG_DATA_SIZE)
+    {
+        std::cout << "ERROR::SCENE::TOO_BIG " << sceneFile.ObjectCount() << " objects, using the built in scene" << std::endl;
+        sceneFile.Clear();
+    }
+    if(sceneFile.ObjectCount() > 0)
+    {
+        // already ordered and packed, the model's box is refit into the copy
+        std::memcpy(objectsData, sceneFile.ObjectTexels(), sizeof(float) * 4 * SCENE_OBJECT_TEXELS * sceneFile.ObjectCount());
+        std::memcpy(BVHNodesData, sceneFile.NodeTexels(), sizeof(float) * 4 * SCENE_NODE_TEXELS * sceneFile.NodeCount());
+        sceneFile.Objects(objects, BVHNodes);
+        for(const std::shared_ptr<Material>& material : sceneFile.pool.materials)
+        {
+            materialPool.Intern(*material);
+        }
+        RefitModelNode(aabbModel);
+        return WriteTrianglesData(meshes);
+    }
+    objects.clear();
+    // Scene1(objects, aabbModel);
+    DisplayScene(objects, aabbModel);
+    // RandomScene(objects);
+    // CornellBox(objects);
+    SortObjects(objects);
+    WriteBVHNodesData();
+    materialPool.Intern(objects);
+    WriteObjectsData();
+    return WriteTrianglesData(meshes);
+}
+
+// six texels per triangle, [position, u] [normal, v] for each corner, in the leaf order of the
+// model's bvh which goes to modelBVHData. the skinned model is rigged here as well
+int WriteTrianglesData(const std::vector<TriangleMesh>& meshes)
+{
+    SkinnedMesh skinned = StaticSkinnedMesh(meshes);
+    if(SKINNED_MODEL)
+    {
+        RigAlongY(skinned, SKIN_BONES);
+        swayClip = SwayClip(AABBofModel(meshes), SKIN_BONES);
+        swayState = swayClip.CreateState();
+        skinBones.assign(SKIN_BONES, glm::mat4(1.0f));
+    }
+    modelMesh.Build(skinned, SKINNED_MODEL ? SKIN_BONES : 0);
+    modelMesh.WriteTriangles(triangleData);
+    modelMesh.BVH().Pack(modelBVHData);
+    return modelMesh.TriangleCount();
+}
+
+// a chain of boneCount bones up the middle of box, each swaying a little around z with a delay
+// to the one below, so the top of the model moves the most
+AnimationClip SwayClip(const AABB& box, int boneCount)
 {
-    int triangleIndex = 0;
-    for(int i = 0; i < m.meshes.size(); ++i)
+    const int keyCount = 16;
+    const float duration = 60.0f;
+    glm::vec3 base((box.minimum.x + box.maximum.x) * 0.5f, box.minimum.y, (box.minimum.z + box.maximum.z) * 0.5f);
+    float step = (box.maximum.y - box.minimum.y) / std::max(1, boneCount - 1);
+    AnimationClip clip;
+    clip.SetTiming(duration, 30.0f);
+    for(int bone = 0; bone < boneCount; ++bone)
     {
-        for( int j = 0; j < m.meshes[i].vertices.size(); ++j)
+        glm::vec3 offset = bone == 0 ? base : glm::vec3(0.0f, step, 0.0f);
+        glm::mat4 inverseBind = glm::translate(glm::mat4(1.0f), -(base + glm::vec3(0.0f, step * bone, 0.0f)));
+        clip.AddNode(bone - 1, glm::translate(glm::mat4(1.0f), offset), bone, inverseBind);
+        std::vector<float> times;
+        std::vector<glm::quat> rotations;
+        for(int k = 0; k < keyCount; ++k)
         {
-            triangleData[triangleIndex][0] = m.meshes[i].vertices[j].Position[0];
-            triangleData[triangleIndex][1] = m.meshes[i].vertices[j].Position[1];
-            triangleData[triangleIndex][2] = m.meshes[i].vertices[j].Position[2];
-            triangleData[triangleIndex][3] = m.meshes[i].vertices[j].TexCoords[0];
-            triangleData[triangleIndex + 1][0] = m.meshes[i].vertices[j].Normal[0];
-            triangleData[triangleIndex + 1][1] = m.meshes[i].vertices[j].Normal[1];
-            triangleData[triangleIndex + 1][2] = m.meshes[i].vertices[j].Normal[2];
-            triangleData[triangleIndex + 1][3] = m.meshes[i].vertices[j].TexCoords[1];
-            triangleIndex+=2;
+            float phase = 6.2831853f * k / (keyCount - 1) - 0.6f * bone;
+            times.push_back(duration * k / (keyCount - 1));
+            rotations.push_back(glm::angleAxis(bone == 0 ? 0.0f : 0.12f * std::sin(phase), glm::vec3(0.0f, 0.0f, 1.0f)));
         }
+        clip.SetTrack(bone, { 0.0f }, { offset }, times, rotations, { 0.0f }, { glm::vec3(1.0f) });
     }
+    return clip;
 }
 
-AABB AABBofModel(Model& m)
+// new bounds for the model's leaf and every node above it
+void RefitModelNode(const AABB& box)
 {
-    bool first = true;
-    AABB merge, tri;
-    for(int i = 0; i < m.meshes.size(); ++i)
+    for(int i = 0; i < (int)objects.size(); ++i)
     {
-        for(int j = 0; j < m.meshes[i].vertices.size(); j+=3)
+        if(BVHNodes[i].objectType != OBJ_MODEL)
         {
-            if(first)
+            continue;
+        }
+        objects[i]->box = box;
+        BVHNodes[i].aabb = box;
+        for(int node = i; node != -1; node = BVHNodes[node].parent)
+        {
+            if(node != i)
             {
-                merge = AABB(vec3(fmin(m.meshes[i].vertices[j].Position[0], 
-                                fmin(m.meshes[i].vertices[j+1].Position[0], m.meshes[i].vertices[j+2].Position[0])),
-                                fmin(m.meshes[i].vertices[j].Position[1], 
-                                fmin(m.meshes[i].vertices[j+1].Position[1], m.meshes[i].vertices[j+2].Position[1])),
-                                fmin(m.meshes[i].vertices[j].Position[2], 
-                                fmin(m.meshes[i].vertices[j+1].Position[2], m.meshes[i].vertices[j+2].Position[2]))), 
-                            vec3(fmax(m.meshes[i].vertices[j].Position[0], 
-                                fmax(m.meshes[i].vertices[j+1].Position[0], m.meshes[i].vertices[j+2].Position[0])),
-                                fmax(m.meshes[i].vertices[j].Position[1], 
-                                fmax(m.meshes[i].vertices[j+1].Position[1], m.meshes[i].vertices[j+2].Position[1])),
-                                fmax(m.meshes[i].vertices[j].Position[2], 
-                                fmax(m.meshes[i].vertices[j+1].Position[2], m.meshes[i].vertices[j+2].Position[2]))));
-                first = false;
+                BVHNodes[node].aabb = SurroundingBox(BVHNodes[BVHNodes[node].left].aabb, BVHNodes[BVHNodes[node].right].aabb);
             }
-            else
+            for(int a = 0; a < 3; ++a)
             {
-                tri = AABB(vec3(fmin(m.meshes[i].vertices[j].Position[0], 
-                                fmin(m.meshes[i].vertices[j+1].Position[0], m.meshes[i].vertices[j+2].Position[0])),
-                                fmin(m.meshes[i].vertices[j].Position[1], 
-                                fmin(m.meshes[i].vertices[j+1].Position[1], m.meshes[i].vertices[j+2].Position[1])),
-                                fmin(m.meshes[i].vertices[j].Position[2], 
-                                fmin(m.meshes[i].vertices[j+1].Position[2], m.meshes[i].vertices[j+2].Position[2]))), 
-                            vec3(fmax(m.meshes[i].vertices[j].Position[0], 
-                                fmax(m.meshes[i].vertices[j+1].Position[0], m.meshes[i].vertices[j+2].Position[0])),
-                                fmax(m.meshes[i].vertices[j].Position[1], 
-                                fmax(m.meshes[i].vertices[j+1].Position[1], m.meshes[i].vertices[j+2].Position[1])),
-                                fmax(m.meshes[i].vertices[j].Position[2], 
-                                fmax(m.meshes[i].vertices[j+1].Position[2], m.meshes[i].vertices[j+2].Position[2]))));
-                merge = SurroundingBox(merge, tri);
+                BVHNodesData[3 * node][a] = BVHNodes[node].aabb.minimum[a];
+                BVHNodesData[3 * node + 1][a] = BVHNodes[node].aabb.maximum[a];
             }
         }
     }
+}
+
+// an empty box at the origin while there are no meshes
+AABB AABBofModel(const std::vector<TriangleMesh>& meshes)
+{
+    bool first = true;
+    AABB merge(vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 0.0));
+    for(const TriangleMesh& mesh : meshes)
+    {
+        for(const glm::vec3& position : mesh.positions)
+        {
+            AABB point(vec3(position.x, position.y, position.z), vec3(position.x, position.y, position.z));
+            merge = first ? point : SurroundingBox(merge, point);
+            first = false;
+        }
+    }
     return merge;
-}
\ No newline at end of file
+}
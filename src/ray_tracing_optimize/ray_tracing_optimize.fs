@@ -14,6 +14,44 @@ const int OBJ_XYRECT = 2;
 const int OBJ_XZRECT = 3;
 const int OBJ_YZRECT = 4;
 const int OBJ_MODEL = 5;
+// texels per object and per material, see WriteObjectsData and MaterialPool
+const int OBJECT_TEXELS = 2;
+const int MATERIAL_TEXELS = 3;
+
+// scene features
+// --------------
+// the host compiles a variant per scene with SCENE_FEATURES and a HAS_ flag for every object
+// type and material it uses, plus fixed sample, bounce and traversal stack sizes.
+// without them everything is compiled in and the sample count comes from the uniform.
+#ifndef SCENE_FEATURES
+#define HAS_SPHERE
+#define HAS_XYRECT
+#define HAS_XZRECT
+#define HAS_YZRECT
+#define HAS_MODEL
+#define HAS_LAMBERTIAN
+#define HAS_METALLIC
+#define HAS_DIELECTRIC
+#endif
+#ifndef MAX_DEPTH
+#define MAX_DEPTH 7
+#endif
+#ifndef BVH_STACK_SIZE
+#define BVH_STACK_SIZE 30
+#endif
+// the model's own bvh is never deeper than MESH_BVH_MAX_DEPTH in mesh_bvh.h
+#define MODEL_STACK_SIZE 32
+// traversal heatmap
+// -----------------
+// with TRAVERSAL_HEATMAP the color output holds what the pixel's paths cost per sample
+// instead of radiance: nodes visited, boxes the ray entered and primitive tests. every node
+// visited is one box test, so the second channel is what of those tests passed
+#ifdef TRAVERSAL_HEATMAP
+vec3 traversalCost = vec3(0.0);
+#define COUNT_COST(cost) traversalCost += cost
+#else
+#define COUNT_COST(cost)
+#endif
 // in variables
 // ------------
 in vec2 screenCoord;
@@ -25,12 +63,26 @@ uniform vec2 screenSize;
 uniform samplerBuffer spheresData;
 uniform samplerBuffer BVHNodesData;
 uniform samplerBuffer trianglesData;
+uniform samplerBuffer materialsData;
+// two texels per node: [minimum, triangle count] [maximum, first triangle or right child],
+// a count of 0 marks an inner node with its left child right after it
+uniform samplerBuffer modelBVHData;
 
 uniform sampler2D texture_diffuse1;
+// hybrid mode: the camera ray's first hit comes from a rasterized G-buffer,
+// position + object type and normal + object index, only the bounces are traced
+#ifdef HYBRID_PRIMARY
+uniform sampler2D gbufferPositionType;
+uniform sampler2D gbufferNormalIndex;
+#endif
+uniform int samplesPerPixel;
+uniform int frameIndex;
 
 // out variables
 // ------------
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 NormalDepth;
+layout (location = 2) out vec4 Albedo;
 
 // define struct
 // -------------
@@ -162,9 +214,13 @@ float rdSeed[4];
 int rdCnt = 0;
 Camera camera;
 AABB aabbModel;
-uniform CameraParameter cameraParameter;
-uniform World world;
-int stack[30];
+// camera and world live in one uniform buffer the host only rewrites when they change
+layout (std140) uniform SceneParameters
+{
+	CameraParameter cameraParameter;
+	World world;
+};
+int stack[BVH_STACK_SIZE];
 int stackTop = -1;
 
 // functions declaration
@@ -177,12 +233,14 @@ float VecLength(vec3 v);
 Ray RayConstructor(vec3 origin, vec3 direction);
 vec3 RayGetPointAt(Ray ray, float t);
 Camera CameraConstructor(vec3 lookFrom, vec3 lookAt, vec3 vup, float vfov, float aspectRatio);
+Material GetMaterialFromTexture(int materialIndex);
 Sphere GetSphereFromTexture(int sphereIndex);
 XYRect GetXYRectFromTexture(int xyrectIndex);
 XZRect GetXZRectFromTexture(int xzrectIndex);
 YZRect GetYZRectFromTexture(int yzrectIndex);
 BVHNode GetBVHNodeFromTexture(int BVHNodeIndex);
 Triangle GetTriangleFromTexture(int triangleIndex);
+Material ModelMaterial();
 AABB GetAABBofModelFromTexture();
 bool SphereHit(Sphere sphere, Ray ray, float tMin, float tMax, inout HitRecord hitRec);
 vec3 SetFaceNormal(Ray ray, vec3 outwardNormal);
@@ -193,7 +251,8 @@ bool TriangleHit(Triangle tri, Ray ray, float tMin, float tMax, inout HitRecord
 bool ModelHit(World world, Ray ray, float tMin, float tMax, inout HitRecord rec);
 bool SpheresHit(Ray ray, float tMin, float tMax, inout HitRecord rec);
 bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec);
-vec3 WorldTrace(Ray ray, int depth);
+bool GBufferHit(Ray ray, inout HitRecord rec);
+vec3 WorldTrace(Ray ray, int depth, out vec3 hitNormal, out vec3 hitAlbedo, out float hitDistance);
 Ray CameraGetRay(Camera camera, vec2 uv);
 vec3 GetEnvironmentColor(World world, Ray ray);
 Lambertian LambertianConstructor(vec3 albedo);
@@ -290,88 +349,72 @@ Camera CameraConstructor(vec3 lookFrom, vec3 lookAt, vec3 vup, float vfov, float
 	return camera;
 }
 
+Material GetMaterialFromTexture(int materialIndex)
+{
+	Material material;
+	int index = materialIndex * MATERIAL_TEXELS;
+	vec4 pack = texelFetch(materialsData, index);
+	material.color = pack.xyz;
+	material.materialType = int(pack.w);
+	pack = texelFetch(materialsData, index + 1);
+	material.roughness = pack.x;
+	material.ior = pack.y;
+	return material;
+}
+
 Sphere GetSphereFromTexture(int sphereIndex)
 {
-	Material tmpMatrial;
 	Sphere sphere;
-	vec4 pack;
-	int index = sphereIndex*3;
-	pack = texelFetch(spheresData, index);
+	int index = sphereIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(spheresData, index);
 	sphere.center = pack.xyz;
 	sphere.radius = pack.w;
-	pack = texelFetch(spheresData, index + 1);
-	tmpMatrial.color = pack.xyz;
-	tmpMatrial.materialType = int(pack.w);
-	pack = texelFetch(spheresData, index + 2);
-	tmpMatrial.roughness = pack.x;
-	tmpMatrial.ior = pack.y;
-	sphere.material = tmpMatrial;
+	sphere.material = GetMaterialFromTexture(int(texelFetch(spheresData, index + 1).x));
 	return sphere;
 }
 
 XYRect GetXYRectFromTexture(int xyrectIndex)
 {
 	XYRect rect;
-	Material tmpMaterial;
-	vec4 pack;
-	int index = xyrectIndex * 3;
-	pack = texelFetch(spheresData, index);
+	int index = xyrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(spheresData, index);
 	rect.x0 = pack.x;
 	rect.x1 = pack.y;
 	rect.y0 = pack.z;
 	rect.y1 = pack.w;
 	pack = texelFetch(spheresData, index + 1);
-	tmpMaterial.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(spheresData, index + 2);
-	tmpMaterial.materialType = int(pack.x);
-	tmpMaterial.roughness = pack.y;
-	tmpMaterial.ior = pack.z;
-	rect.material = tmpMaterial;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
 XZRect GetXZRectFromTexture(int xzrectIndex)
 {
 	XZRect rect;
-	Material tmpMaterial;
-	vec4 pack;
-	int index = xzrectIndex * 3;
-	pack = texelFetch(spheresData, index);
+	int index = xzrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(spheresData, index);
 	rect.x0 = pack.x;
 	rect.x1 = pack.y;
 	rect.z0 = pack.z;
 	rect.z1 = pack.w;
 	pack = texelFetch(spheresData, index + 1);
-	tmpMaterial.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(spheresData, index + 2);
-	tmpMaterial.materialType = int(pack.x);
-	tmpMaterial.roughness = pack.y;
-	tmpMaterial.ior = pack.z;
-	rect.material = tmpMaterial;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
 YZRect GetYZRectFromTexture(int yzrectIndex)
 {
 	YZRect rect;
-	Material tmpMaterial;
-	vec4 pack;
-	int index = yzrectIndex * 3;
-	pack = texelFetch(spheresData, index);
+	int index = yzrectIndex * OBJECT_TEXELS;
+	vec4 pack = texelFetch(spheresData, index);
 	rect.y0 = pack.x;
 	rect.y1 = pack.y;
 	rect.z0 = pack.z;
 	rect.z1 = pack.w;
 	pack = texelFetch(spheresData, index + 1);
-	tmpMaterial.color = pack.xyz;
-	rect.k = pack.w;
-	pack = texelFetch(spheresData, index + 2);
-	tmpMaterial.materialType = int(pack.x);
-	tmpMaterial.roughness = pack.y;
-	tmpMaterial.ior = pack.z;
-	rect.material = tmpMaterial;
+	rect.material = GetMaterialFromTexture(int(pack.x));
+	rect.k = pack.y;
 	return rect;
 }
 
@@ -382,13 +425,14 @@ BVHNode GetBVHNodeFromTexture(int BVHNodeIndex)
 	int index = BVHNodeIndex * 3;
 	pack = texelFetch(BVHNodesData, index);
 	node.aabb.minimum = pack.xyz;
-	node.objectIndex = int(pack.w);
+	// indices are stored as int bits, see bvh.h
+	node.objectIndex = floatBitsToInt(pack.w);
 	pack = texelFetch(BVHNodesData, index + 1);
 	node.aabb.maximum = pack.xyz;
-	node.objectType = int(pack.w);
+	node.objectType = floatBitsToInt(pack.w);
 	pack = texelFetch(BVHNodesData, index + 2);
-	node.left = int(pack.x);
-	node.right = int(pack.y);
+	node.left = floatBitsToInt(pack.x);
+	node.right = floatBitsToInt(pack.y);
 	return node;
 }
 
@@ -418,12 +462,20 @@ Triangle GetTriangleFromTexture(int triangleIndex)
 	tri.c.normal = pack.xyz;
 	tri.c.texCoords.y = pack.w;
 
-	tri.material.color = vec3(0.75, 0.82, 0.90);
-	tri.material.ior = 7.0;
-	tri.material.materialType = MAT_DIELECTRIC;
+	tri.material = ModelMaterial();
 	return tri;
 }
 
+// every model triangle shares this material
+Material ModelMaterial()
+{
+	Material material;
+	material.color = vec3(0.75, 0.82, 0.90);
+	material.ior = 7.0;
+	material.materialType = MAT_DIELECTRIC;
+	return material;
+}
+
 AABB GetAABBofModelFromTexture()
 {
 	AABB ab;
@@ -576,16 +628,45 @@ bool ModelHit(Ray ray, float tMin, float tMax, inout HitRecord rec)
     HitRecord tmpRec;
     float cloestSoFar = tMax;
     bool hitSomething = false;
+    if(world.triangleCount == 0)
+    {
+        return false;
+    }
 
-    for(int i = 0; i < world.triangleCount; ++i)
+    // the model's triangles sit in the leaf order of its bvh
+    int modelStack[MODEL_STACK_SIZE];
+    int modelStackTop = 0;
+    int node = 0;
+    while(node != -1)
     {
-        if(TriangleHit(GetTriangleFromTexture(i), ray, tMin, cloestSoFar, tmpRec))
+        COUNT_COST(vec3(1.0, 0.0, 0.0));
+        vec4 low = texelFetch(modelBVHData, node * 2);
+        vec4 high = texelFetch(modelBVHData, node * 2 + 1);
+        AABB box;
+        box.minimum = low.xyz;
+        box.maximum = high.xyz;
+        int count = int(low.w);
+        if(AABBHit(ray, box, tMin, cloestSoFar))
         {
-            rec = tmpRec;
-            cloestSoFar = tmpRec.t;
-
-            hitSomething = true;
+            COUNT_COST(vec3(0.0, 1.0, 0.0));
+            if(count == 0)
+            {
+                modelStack[modelStackTop++] = int(high.w);
+                node = node + 1;
+                continue;
+            }
+            for(int i = int(high.w); i < int(high.w) + count; ++i)
+            {
+                COUNT_COST(vec3(0.0, 0.0, 1.0));
+                if(TriangleHit(GetTriangleFromTexture(i), ray, tMin, cloestSoFar, tmpRec))
+                {
+                    rec = tmpRec;
+                    cloestSoFar = tmpRec.t;
+                    hitSomething = true;
+                }
+            }
         }
+        node = modelStackTop > 0 ? modelStack[--modelStackTop] : -1;
     }
     return hitSomething;
 }
@@ -618,13 +699,17 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 	while(curr != -1 || !StackEmpty())
 	{
 		BVHNode currNode = GetBVHNodeFromTexture(curr);
+		COUNT_COST(vec3(1.0, 0.0, 0.0));
 		if(AABBHit(ray, currNode.aabb,tMin, cloestSoFar))
 		{
+			COUNT_COST(vec3(0.0, 1.0, 0.0));
 			if(currNode.objectIndex != -1)
 			{
 				switch(currNode.objectType)
 				{
+#ifdef HAS_SPHERE
 					case OBJ_SPHERE:
+						COUNT_COST(vec3(0.0, 0.0, 1.0));
 						if(SphereHit(GetSphereFromTexture(currNode.objectIndex),ray, tMin, cloestSoFar,tmpRec))
 						{
 							rec = tmpRec;
@@ -632,7 +717,10 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 							hitSomething = true;
 						}
 					break;
+#endif
+#ifdef HAS_XYRECT
 					case OBJ_XYRECT:
+						COUNT_COST(vec3(0.0, 0.0, 1.0));
 						if(XYRectHit(GetXYRectFromTexture(currNode.objectIndex), ray, tMin, cloestSoFar,tmpRec))
 						{
 							rec = tmpRec;
@@ -640,7 +728,10 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 							hitSomething = true;
 						}
 					break;
+#endif
+#ifdef HAS_XZRECT
 					case OBJ_XZRECT:
+						COUNT_COST(vec3(0.0, 0.0, 1.0));
 						if(XZRectHit(GetXZRectFromTexture(currNode.objectIndex), ray, tMin, cloestSoFar,tmpRec))
 						{
 							rec = tmpRec;
@@ -648,7 +739,10 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 							hitSomething = true;
 						}
 					break;
+#endif
+#ifdef HAS_YZRECT
 					case OBJ_YZRECT:
+						COUNT_COST(vec3(0.0, 0.0, 1.0));
 						if(YZRectHit(GetYZRectFromTexture(currNode.objectIndex), ray, tMin, cloestSoFar,tmpRec))
 						{
 							rec = tmpRec;
@@ -656,6 +750,8 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 							hitSomething = true;
 						}
 					break;
+#endif
+#ifdef HAS_MODEL
 					case OBJ_MODEL:
 						if(ModelHit(ray, 0.001, cloestSoFar, tmpRec))
 						{
@@ -664,6 +760,7 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
 							hitSomething = true;
 						}
 					break;
+#endif
 				}
 				
 				if(StackEmpty())
@@ -696,19 +793,75 @@ bool WorldHitBVH(Ray ray, float tMin, float tMax, inout HitRecord rec)
     return hitSomething;
 }
 
-vec3 WorldTrace(Ray ray, int depth)
+#ifdef HYBRID_PRIMARY
+bool GBufferHit(Ray ray, inout HitRecord rec)
+{
+	vec4 positionType = texelFetch(gbufferPositionType, ivec2(gl_FragCoord.xy), 0);
+	int objectType = int(positionType.w + 0.5);
+	if(objectType == 0)
+	{
+		return false;
+	}
+	vec4 normalIndex = texelFetch(gbufferNormalIndex, ivec2(gl_FragCoord.xy), 0);
+	int objectIndex = int(normalIndex.w + 0.5);
+	rec.position = positionType.xyz;
+	rec.normal = normalIndex.xyz;
+	rec.t = length(rec.position - ray.origin) / length(ray.direction);
+	rec.u = 0.0;
+	rec.v = 0.0;
+	switch(objectType)
+	{
+		case OBJ_SPHERE:
+			rec.material = GetSphereFromTexture(objectIndex).material;
+		break;
+		case OBJ_XYRECT:
+			rec.material = GetXYRectFromTexture(objectIndex).material;
+		break;
+		case OBJ_XZRECT:
+			rec.material = GetXZRectFromTexture(objectIndex).material;
+		break;
+		case OBJ_YZRECT:
+			rec.material = GetYZRectFromTexture(objectIndex).material;
+		break;
+		default:
+			rec.material = ModelMaterial();
+		break;
+	}
+	return true;
+}
+#endif
+
+vec3 WorldTrace(Ray ray, int depth, out vec3 hitNormal, out vec3 hitAlbedo, out float hitDistance)
 {
     HitRecord hitRecord;
 
 	vec3 frac = vec3(1.0, 1.0, 1.0);
 	vec3 bgColor = vec3(0.0, 0.0, 0.0);
+	bool primary = true;
+
+	// a miss leaves the auxiliary outputs describing the environment
+	hitNormal = vec3(0.0, 0.0, 0.0);
+	hitAlbedo = vec3(1.0, 1.0, 1.0);
+	hitDistance = RAYCAST_MAX;
 	while(depth>0)
 	{
 		depth--;
 		// if(SpheresHit(ray, 0.001, RAYCAST_MAX, hitRecord))
 		// if(ModelHit(ray, 0.001, RAYCAST_MAX, hitRecord))
-		if(WorldHitBVH(ray, 0.001, RAYCAST_MAX, hitRecord))//||ModelHit(ray, 0.001, RAYCAST_MAX, hitRecord))
+#ifdef HYBRID_PRIMARY
+		bool hit = primary ? GBufferHit(ray, hitRecord) : WorldHitBVH(ray, 0.001, RAYCAST_MAX, hitRecord);
+#else
+		bool hit = WorldHitBVH(ray, 0.001, RAYCAST_MAX, hitRecord);//||ModelHit(ray, 0.001, RAYCAST_MAX, hitRecord))
+#endif
+		if(hit)
 		{
+			if(primary)
+			{
+				hitNormal = normalize(hitRecord.normal);
+				hitAlbedo = hitRecord.material.color;
+				hitDistance = hitRecord.t * length(ray.direction);
+				primary = false;
+			}
 			Ray scatterRay;
 			vec3 attenuation;
 			if(!MaterialScatter(ray, hitRecord, scatterRay, attenuation))
@@ -916,16 +1069,21 @@ bool refract(vec3 v, vec3 n, float ni_over_nt, out vec3 refracted)
 
 bool MaterialScatter(in Ray incident, in HitRecord hitRecord, out Ray scatter, out vec3 attenuation)
 {
+#ifdef HAS_LAMBERTIAN
     if(hitRecord.material.materialType==MAT_LAMBERTIAN)
 		return LambertianScatter(incident, hitRecord, scatter, attenuation);
-	else if(hitRecord.material.materialType==MAT_METALLIC)
+#endif
+#ifdef HAS_METALLIC
+	if(hitRecord.material.materialType==MAT_METALLIC)
 		return MetallicScatter(incident, hitRecord, scatter, attenuation);
-	else if(hitRecord.material.materialType==MAT_DIELECTRIC)
+#endif
+#ifdef HAS_DIELECTRIC
+	if(hitRecord.material.materialType==MAT_DIELECTRIC)
 		return DielectricScatter(incident, hitRecord, scatter, attenuation);
+#endif
 	// else if(hitRecord.material.materialType==MAT_TEXTURE)
 	// 	return TextureScatter(incident, hitRecord, scatter, attenuation);
-	else
-		return false;
+	return false;
 }
 
 bool AABBHit(Ray ray, AABB aabb, float tMin, float tMax)
@@ -976,17 +1134,49 @@ int StackPop()
 // -------------
 void main()
 {
-	camera = CameraConstructor(cameraParameter.lookFrom, cameraParameter.lookAt, cameraParameter.vup, 20.0, cameraParameter.aspectRatio);
+	camera = CameraConstructor(cameraParameter.lookFrom, cameraParameter.lookAt, cameraParameter.vup, cameraParameter.vfov, cameraParameter.aspectRatio);
+#ifdef HAS_MODEL
 	aabbModel = GetAABBofModelFromTexture();
+#endif
+	for(int i = 0; i < 4; ++i)
+	{
+		rdSeed[i] = RandXY(float(frameIndex), float(i) + 0.5);
+	}
 	vec3 col = vec3(0.0, 0.0, 0.0);
-	int ns = 30;
+	vec3 normal = vec3(0.0, 0.0, 0.0);
+	vec3 albedo = vec3(0.0, 0.0, 0.0);
+	// the nearest hit, not the mean: a mean over hits and misses at a silhouette is a point
+	// that isn't there, far enough to pass for background yet still reprojected as a surface
+	float depth = RAYCAST_MAX;
+#ifdef SAMPLES_PER_PIXEL
+	const int ns = SAMPLES_PER_PIXEL;
+#else
+	int ns = samplesPerPixel;
+#endif
 	for(int i=0; i<ns; i++)
 	{
+		vec3 hitNormal, hitAlbedo;
+		float hitDistance;
+#ifdef HYBRID_PRIMARY
+		// through the pixel center, where the G-buffer was rasterized
+		Ray ray = CameraGetRay(camera, screenCoord);
+#else
 		Ray ray = CameraGetRay(camera, screenCoord + RandInSquare() / screenSize);
-		col += WorldTrace(ray, 7);
+#endif
+		col += WorldTrace(ray, MAX_DEPTH, hitNormal, hitAlbedo, hitDistance);
+		normal += hitNormal;
+		albedo += hitAlbedo;
+		depth = min(depth, hitDistance);
 	}
 	col /= ns;
 
+#ifdef TRAVERSAL_HEATMAP
+	FragColor = vec4(traversalCost / float(ns), 1.0);
+#else
 	FragColor.xyz = col;
 	FragColor.w = 1.0;
+#endif
+	// first-hit auxiliary buffers consumed by the denoiser
+	NormalDepth = vec4(length(normal) > 0.0 ? normalize(normal) : normal, depth);
+	Albedo = vec4(albedo / ns, 1.0);
 }
\ No newline at end of file
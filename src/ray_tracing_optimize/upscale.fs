@@ -0,0 +1,85 @@
+#version 330 core
+
+// in variables
+// ------------
+in vec2 screenCoord;
+
+// textures
+// --------
+uniform sampler2D sourceTexture;
+
+// out variables
+// ------------
+out vec4 FragColor;
+
+ivec2 sourceSize;
+
+// luminance squashed into [0, 1) so bright highlights do not dominate the edge detection
+float Luma(vec3 c)
+{
+	float l = dot(c, vec3(0.2126, 0.7152, 0.0722));
+	return l / (1.0 + l);
+}
+
+vec3 Fetch(ivec2 p)
+{
+	return texelFetch(sourceTexture, clamp(p, ivec2(0), sourceSize - 1), 0).xyz;
+}
+
+// lanczos 2 window approximated as a polynomial of the squared distance, zero from 4 on
+float Lanczos2(float d2)
+{
+	if(d2 >= 4.0)
+		return 0.0;
+	float a = 0.4 * d2 - 1.0;
+	float b = 0.25 * d2 - 1.0;
+	return (1.5625 * a * a - 0.5625) * b * b;
+}
+
+void main()
+{
+	sourceSize = textureSize(sourceTexture, 0);
+	vec2 position = screenCoord * vec2(sourceSize) - 0.5;
+	ivec2 base = ivec2(floor(position));
+	vec2 f = position - vec2(base);
+
+	// local edge direction from the 2x2 quad around the sample
+	vec3 c00 = Fetch(base);
+	vec3 c10 = Fetch(base + ivec2(1, 0));
+	vec3 c01 = Fetch(base + ivec2(0, 1));
+	vec3 c11 = Fetch(base + ivec2(1, 1));
+	float l00 = Luma(c00), l10 = Luma(c10), l01 = Luma(c01), l11 = Luma(c11);
+	vec2 gradient = 0.5 * vec2(l10 + l11 - l00 - l01, l01 + l11 - l00 - l10);
+	float lumaMin = min(min(l00, l10), min(l01, l11));
+	float lumaMax = max(max(l00, l10), max(l01, l11));
+	float gradientLength = length(gradient);
+	// 1 for a clean straight edge, 0 for flat areas and isolated texels
+	float edge = gradientLength / (lumaMax - lumaMin + 1e-4);
+	edge *= smoothstep(0.02, 0.1, lumaMax - lumaMin);
+	vec2 across = gradientLength > 1e-5 ? gradient / gradientLength : vec2(1.0, 0.0);
+	vec2 along = vec2(-across.y, across.x);
+
+	// kernel narrowed across the edge and widened along it
+	float acrossScale = 1.0 + 2.0 * edge;
+	float alongScale = 1.0 - 0.5 * edge;
+	vec3 sum = vec3(0.0);
+	float sumWeight = 0.0;
+	for(int y = -1; y <= 2; ++y)
+	{
+		for(int x = -1; x <= 2; ++x)
+		{
+			vec2 d = vec2(x, y) - f;
+			float da = dot(d, across);
+			float dl = dot(d, along);
+			float w = Lanczos2(da * da * acrossScale + dl * dl * alongScale);
+			sum += w * Fetch(base + ivec2(x, y));
+			sumWeight += w;
+		}
+	}
+	vec3 color = sum / max(sumWeight, 1e-4);
+
+	// negative lobes may overshoot, stay inside what the nearest texels allow
+	vec3 colorMin = min(min(c00, c10), min(c01, c11));
+	vec3 colorMax = max(max(c00, c10), max(c01, c11));
+	FragColor = vec4(clamp(color, colorMin, colorMax), 1.0);
+}
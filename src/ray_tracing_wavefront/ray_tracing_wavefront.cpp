@@ -0,0 +1,585 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/shader_c.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/filesystem.h>
+#include <raytracing/sphere.h>
+#include <raytracing/bvh.h>
+#include <raytracing/scene.h>
+#include <raytracing/hittable_list.h>
+#include <raytracing/material_pool.h>
+#include <raytracing/render_target.h>
+#include <raytracing/scene_uniforms.h>
+#include <raytracing/wavefront.h>
+#include <raytracing/profiler.h>
+#include <raytracing/camera_path.h>
+#include <raytracing/texture_cache.h>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+void Run(GLFWwindow* window);
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+unsigned int loadCubemap(std::vector<std::string> faces);
+void SortObjects(HittableList& objects);
+void WriteObjectsData();
+void WriteBVHNodesData();
+void DrawMegakernel(Shader& shader, SceneUniforms& sceneUniforms, unsigned int quadVAO, int frameIndex);
+void RunBenchmark(Shader& megakernel, SceneUniforms& sceneUniforms, WavefrontTracer& wavefront, unsigned int quadVAO, RenderTarget& megakernelTarget);
+
+// settings
+const unsigned int SCR_WIDTH = 1080;
+const unsigned int SCR_HEIGHT = 720;
+const unsigned int BIG_DATA_SIZE = 100000;
+const int SAMPLES_PER_PIXEL = 2;
+const int MAX_DEPTH = 7;
+const float VFOV = 20.0f;
+
+// traces with the compute stages, otherwise with the fragment shader megakernel
+const bool USE_WAVEFRONT = true;
+// times both tracers on the same frames before the render loop starts
+const bool BENCHMARK = true;
+const int BENCHMARK_FRAMES = 32;
+// profiling: gpu stage bars in the top left corner and timings in the window title,
+// a chrome trace of every phase is written on exit, empty path to skip it
+const bool PROFILE_OVERLAY = true;
+const char* PROFILE_TRACE = "wavefront_trace.json";
+// camera path: CAMERA_RECORD saves the camera of every frame on exit, CAMERA_REPLAY drives the
+// camera from such a file at REPLAY_TIMESTEP per frame, ignores input, prints every frame time
+// and closes the window at the end of the path. empty paths to disable
+const char* CAMERA_RECORD = "";
+const char* CAMERA_REPLAY = "";
+const float REPLAY_TIMESTEP = 1.0f / 60.0f;
+
+const int MAT_LAMBERTIAN = 0;
+const int MAT_METALLIC =  1;
+const int MAT_DIELECTRIC = 2;
+const int MAT_PBR =  3;
+const int OBJ_SPHERE = 1;
+const int OBJ_XYRECT = 2;
+const int OBJ_XZRECT = 3;
+const int OBJ_YZRECT = 4;
+const int OBJ_MODEL = 5;
+
+Camera camera(glm::vec3(13.0f, 2.0f, 3.0f));
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+// the camera follows a recorded path, input only closes the window
+bool cameraReplay = false;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// spheres
+HittableList objects;
+std::vector<BVHNode> BVHNodes;
+float (*objectsData)[4] = new float[BIG_DATA_SIZE][4];
+float (*BVHNodesData)[4] = new float[BIG_DATA_SIZE][4];
+
+int main()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // window create
+    // -------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGLRayTracing", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    Run(window);
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
+    return 0;
+}
+
+// everything that owns GL objects lives in here, so it is gone before glfwTerminate takes
+// the context away
+void Run(GLFWwindow* window)
+{
+    Profiler profiler;
+
+    // build and compile shaders
+    // -------------------------
+    profiler.BeginCpu("shader build");
+    Shader megakernel(FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.vs").c_str(),
+         FileSystem::getPath("src/ray_tracing_optimize/ray_tracing_optimize.fs").c_str());
+    WavefrontTracer wavefront(SCR_WIDTH, SCR_HEIGHT, SAMPLES_PER_PIXEL, FileSystem::getPath("src/ray_tracing_wavefront"));
+    profiler.EndCpu();
+
+    float vertices[] =
+    {
+			 1.0f,  1.0f, 0.0f,  // top right
+			 1.0f, -1.0f, 0.0f,  // bottom right
+			-1.0f, -1.0f, 0.0f,  // bottom left
+			-1.0f,  1.0f, 0.0f   // top left
+    };
+
+    unsigned int indices[] = {  // note that we start from 0!
+        0, 1, 3,   // first triangle
+        1, 2, 3    // second triangle
+    };
+
+    unsigned int VBO, VAO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    std::vector<std::string> faces
+    {
+        FileSystem::getPath("resources/textures/skybox/right.jpg"),
+        FileSystem::getPath("resources/textures/skybox/left.jpg"),
+        FileSystem::getPath("resources/textures/skybox/top.jpg"),
+        FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
+        FileSystem::getPath("resources/textures/skybox/front.jpg"),
+        FileSystem::getPath("resources/textures/skybox/back.jpg")
+    };
+    unsigned int cubemapTexture = loadCubemap(faces);
+
+    // create tbo data
+    // ---------------
+    // mixed lambertian, metallic and dielectric spheres keep the material stages busy
+    {
+        CpuProfileScope scope(profiler, "scene");
+        RandomScene(objects);
+    }
+    {
+        CpuProfileScope scope(profiler, "bvh build");
+        SortObjects(objects);
+        WriteBVHNodesData();
+    }
+    MaterialPool materialPool;
+    {
+        CpuProfileScope scope(profiler, "packing");
+        materialPool.Intern(objects);
+        WriteObjectsData();
+    }
+
+    // generate buffer texture
+    // -----------------------
+    // no model in this scene, the triangle buffer only has to exist
+    profiler.BeginCpu("upload");
+    unsigned int tboSpheresId[3], tboBufferId[3];
+    glGenTextures(3, tboSpheresId);
+    glGenBuffers(3, tboBufferId);
+    glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[0]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, objectsData, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[1]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * BIG_DATA_SIZE * 4, BVHNodesData, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, tboBufferId[2]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * 4 * 4, NULL, GL_STATIC_DRAW);
+    for(int i = 0; i < 3; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, tboSpheresId[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tboBufferId[i]);
+    }
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    // the deduplicated materials go to unit 7 like in the optimize demo
+    std::vector<float> materialsData = materialPool.Pack();
+    unsigned int materialsTexture, materialsBuffer;
+    glGenTextures(1, &materialsTexture);
+    glGenBuffers(1, &materialsBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, materialsBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * materialsData.size(), materialsData.data(), GL_STATIC_DRAW);
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_BUFFER, materialsTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialsBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glFinish();
+    profiler.EndCpu();
+    std::cout << "startup" << std::endl;
+    profiler.Report(std::cout);
+
+    megakernel.use();
+    megakernel.setInt("spheresData", 0);
+    megakernel.setInt("BVHNodesData", 1);
+    megakernel.setInt("trianglesData", 2);
+    megakernel.setInt("envMap", 3);
+    megakernel.setInt("materialsData", 7);
+    megakernel.setInt("samplesPerPixel", SAMPLES_PER_PIXEL);
+    megakernel.bindUniformBlock("SceneParameters", SceneUniforms::BINDING);
+    SceneUniforms sceneUniforms;
+    // the megakernel writes color, normal + depth and albedo
+    RenderTarget megakernelTarget;
+    megakernelTarget.Create(SCR_WIDTH, SCR_HEIGHT, 3);
+
+    if(BENCHMARK)
+    {
+        RunBenchmark(megakernel, sceneUniforms, wavefront, VAO, megakernelTarget);
+    }
+
+    int frameIndex = 0;
+    float lastTitleUpdate = 0.0f;
+    // stage timings only in the render loop, the benchmark above times whole frames
+    wavefront.SetProfiler(&profiler);
+
+    // camera path
+    // -----------
+    CameraPath cameraPath;
+    int replayFrame = 0, replayFrameCount = 0;
+    if(CAMERA_REPLAY[0] != '\0' && cameraPath.Load(CAMERA_REPLAY))
+    {
+        cameraReplay = true;
+        replayFrameCount = cameraPath.FrameCount(REPLAY_TIMESTEP);
+        std::cout << "replaying " << CAMERA_REPLAY << ", " << replayFrameCount << " frames" << std::endl;
+    }
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        profiler.BeginFrame();
+
+        // input
+        // -----
+        processInput(window);
+        if(cameraReplay)
+        {
+            cameraPath.Apply(replayFrame, REPLAY_TIMESTEP, camera);
+        }
+        else if(CAMERA_RECORD[0] != '\0')
+        {
+            cameraPath.Record(currentFrame, camera);
+        }
+
+        // render
+        // ------
+        unsigned int outputFBO;
+        if(USE_WAVEFRONT)
+        {
+            wavefront.Trace(camera.Position, camera.Position + camera.Front, camera.WorldUp, VFOV,
+                objects.size(), BVHNodes.size() - 1, 0, frameIndex++, MAX_DEPTH);
+            // counted a few frames late, reading this frame's count would wait for the gpu
+            profiler.AddRays(wavefront.DelayedRayCount());
+            outputFBO = wavefront.OutputFBO();
+        }
+        else
+        {
+            megakernelTarget.Bind();
+            profiler.BeginGpu("megakernel");
+            DrawMegakernel(megakernel, sceneUniforms, VAO, frameIndex++);
+            profiler.EndGpu();
+            // camera rays only, the fragment tracer does not count its bounces
+            profiler.AddRays((double)SCR_WIDTH * SCR_HEIGHT * SAMPLES_PER_PIXEL);
+            outputFBO = megakernelTarget.FBO;
+        }
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, framebufferWidth, framebufferHeight,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if(PROFILE_OVERLAY)
+        {
+            profiler.DrawOverlay(framebufferWidth, framebufferHeight);
+            if(currentFrame - lastTitleUpdate > 0.5f)
+            {
+                glfwSetWindowTitle(window, profiler.Summary().c_str());
+                lastTitleUpdate = currentFrame;
+            }
+        }
+
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        profiler.EndFrame();
+
+        if(cameraReplay)
+        {
+            std::cout << "replay frame " << replayFrame << " " << (glfwGetTime() - currentFrame) * 1000.0 << " ms" << std::endl;
+            if(++replayFrame >= replayFrameCount)
+            {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
+    }
+
+    if(!cameraReplay && CAMERA_RECORD[0] != '\0')
+    {
+        cameraPath.Save(CAMERA_RECORD);
+    }
+
+    std::cout << "run" << std::endl;
+    profiler.Report(std::cout);
+    if(PROFILE_TRACE[0] != '\0')
+    {
+        profiler.WriteChromeTrace(PROFILE_TRACE);
+    }
+
+    // optional: de-allocate all resources once they've outlived their purpose:
+    // ------------------------------------------------------------------------
+    megakernelTarget.Release();
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(3, tboBufferId);
+    glDeleteTextures(3, tboSpheresId);
+    glDeleteBuffers(1, &materialsBuffer);
+    glDeleteTextures(1, &materialsTexture);
+    delete[] objectsData;
+    delete[] BVHNodesData;
+}
+
+void DrawMegakernel(Shader& shader, SceneUniforms& sceneUniforms, unsigned int quadVAO, int frameIndex)
+{
+    shader.use();
+    shader.setVec2("screenSize", { SCR_WIDTH, SCR_HEIGHT });
+    sceneUniforms.SetCamera(camera.Position, camera.Position + camera.Front, camera.WorldUp, VFOV, (float)SCR_WIDTH / SCR_HEIGHT);
+    sceneUniforms.SetWorld(objects.size(), 0, BVHNodes.size() - 1);
+    sceneUniforms.Upload();
+    shader.setInt("frameIndex", frameIndex);
+    glBindVertexArray(quadVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+// renders the same frames with both tracers and reports time, paths and rays per second.
+// every frame is fenced with glFinish and timed on the cpu: timer queries miss the work a
+// deferred rasterizer such as llvmpipe only does at the flush, so they would flatter the megakernel.
+// the megakernel cannot count its rays, it follows the same paths as the wavefront tracer
+// so the ray count measured there is used for both.
+void RunBenchmark(Shader& megakernel, SceneUniforms& sceneUniforms, WavefrontTracer& wavefront, unsigned int quadVAO, RenderTarget& megakernelTarget)
+{
+    double megakernelMs = 0.0, wavefrontMs = 0.0;
+    double rays = 0.0;
+
+    // one warm-up frame each so shader compilation and first use are not measured
+    megakernelTarget.Bind();
+    DrawMegakernel(megakernel, sceneUniforms, quadVAO, 0);
+    wavefront.Trace(camera.Position, camera.Position + camera.Front, camera.WorldUp, VFOV,
+        objects.size(), BVHNodes.size() - 1, 0, 0, MAX_DEPTH);
+    glFinish();
+
+    for(int i = 0; i < BENCHMARK_FRAMES; ++i)
+    {
+        double start = glfwGetTime();
+        megakernelTarget.Bind();
+        DrawMegakernel(megakernel, sceneUniforms, quadVAO, i + 1);
+        glFinish();
+        megakernelMs += (glfwGetTime() - start) * 1e3;
+
+        start = glfwGetTime();
+        wavefront.Trace(camera.Position, camera.Position + camera.Front, camera.WorldUp, VFOV,
+            objects.size(), BVHNodes.size() - 1, 0, i + 1, MAX_DEPTH);
+        glFinish();
+        wavefrontMs += (glfwGetTime() - start) * 1e3;
+        rays += wavefront.RayCount();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    double paths = (double)wavefront.PathCount() * BENCHMARK_FRAMES;
+    std::cout << "benchmark: " << objects.size() << " objects, " << SCR_WIDTH << "x" << SCR_HEIGHT << ", "
+        << SAMPLES_PER_PIXEL << " spp, depth " << MAX_DEPTH << ", " << BENCHMARK_FRAMES << " frames, "
+        << rays / BENCHMARK_FRAMES << " rays/frame" << std::endl;
+    std::cout << "megakernel: " << megakernelMs / BENCHMARK_FRAMES << " ms/frame, "
+        << paths / (megakernelMs * 1e3) << " Mpaths/s, " << rays / (megakernelMs * 1e3) << " Mrays/s" << std::endl;
+    std::cout << "wavefront:  " << wavefrontMs / BENCHMARK_FRAMES << " ms/frame, "
+        << paths / (wavefrontMs * 1e3) << " Mpaths/s, " << rays / (wavefrontMs * 1e3) << " Mrays/s" << std::endl;
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	glViewport(0, 0, width, height);
+}
+
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+	if (cameraReplay)
+		return;
+
+	float xpos = static_cast<float> (xposIn);
+	float ypos = static_cast<float> (yposIn);
+
+	if (firstMouse)
+	{
+		lastX = xpos;
+		lastY = ypos;
+		firstMouse = false;
+	}
+
+	float xoffset = xpos - lastX;
+	float yoffset = lastY - ypos;
+
+	lastX = xpos;
+	lastY = ypos;
+
+	camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	if (cameraReplay)
+		return;
+	camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
+
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+	if (cameraReplay)
+		return;
+
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		camera.ProcessKeyboard(LEFT, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+// faces decoded on an earlier run come from the texture cache's store
+unsigned int loadCubemap(std::vector<std::string> faces)
+{
+    return SharedTextureCache().Cubemap(faces);
+}
+
+void SortObjects(HittableList& objects)
+{
+    static std::default_random_engine e;
+    static std::uniform_int_distribution<unsigned> u(0, 2);
+
+    unsigned span = objects.size();
+    unsigned start = 0;
+    unsigned axis = 0;
+    while(span >= 2)
+    {
+        while (start < objects.size() - 1)
+        {
+            axis = u(e);
+            std::sort(objects.begin() + start, objects.begin() + span, [axis](std::shared_ptr<Hittable> a,std::shared_ptr<Hittable>b){
+                return a->box.min()[axis] < b->box.min()[axis];
+            });
+            start += span;
+        }
+        span /= 2;
+    }
+}
+
+void WriteObjectsData()
+{
+    // two texels per object, the material is an index into the materials buffer:
+    // sphere [center, radius] [material, 0, 0, 0]
+    // rect   [a0, a1, b0, b1] [material, k, 0, 0]
+    for(size_t i = 0; i < objects.size(); ++i)
+    {
+        float* bounds = objectsData[i*2];
+        float* extra = objectsData[i*2+1];
+        extra[0] = objects[i]->materialIndex;
+        extra[1] = 0.0f;
+        extra[2] = 0.0f;
+        extra[3] = 0.0f;
+        switch(objects[i]->objectType)
+        {
+            case OBJ_SPHERE:
+                bounds[0] = objects[i]->center[0];
+                bounds[1] = objects[i]->center[1];
+                bounds[2] = objects[i]->center[2];
+                bounds[3] = objects[i]->radius;
+            break;
+            case OBJ_XYRECT:
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->y0;
+                bounds[3] = objects[i]->y1;
+                extra[1] = objects[i]->k;
+            break;
+            case OBJ_XZRECT:
+                bounds[0] = objects[i]->x0;
+                bounds[1] = objects[i]->x1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
+            break;
+            case OBJ_YZRECT:
+                bounds[0] = objects[i]->y0;
+                bounds[1] = objects[i]->y1;
+                bounds[2] = objects[i]->z0;
+                bounds[3] = objects[i]->z1;
+                extra[1] = objects[i]->k;
+            break;
+        }
+    }
+}
+
+void WriteBVHNodesData()
+{
+    BVHNodes.resize(objects.size() * 2 - 1);
+    BuildBVHNodes(BVHNodes, objects);
+    for (size_t i = 0; i < BVHNodes.size(); ++i)
+    {
+        BVHNodesData[3 * i][0] = BVHNodes[i].aabb.minimum[0];
+        BVHNodesData[3 * i][1] = BVHNodes[i].aabb.minimum[1];
+        BVHNodesData[3 * i][2] = BVHNodes[i].aabb.minimum[2];
+        BVHNodesData[3 * i][3] = NodeIndexTexel(BVHNodes[i].objectIndex);
+        BVHNodesData[3 * i + 1][0] = BVHNodes[i].aabb.maximum[0];
+        BVHNodesData[3 * i + 1][1] = BVHNodes[i].aabb.maximum[1];
+        BVHNodesData[3 * i + 1][2] = BVHNodes[i].aabb.maximum[2];
+        BVHNodesData[3 * i + 1][3] = NodeIndexTexel(BVHNodes[i].objectType);
+        BVHNodesData[3 * i + 2][0] = NodeIndexTexel(BVHNodes[i].left);
+        BVHNodesData[3 * i + 2][1] = NodeIndexTexel(BVHNodes[i].right);
+    }
+}
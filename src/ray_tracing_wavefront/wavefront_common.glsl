@@ -0,0 +1,122 @@
+#version 430 core
+
+// declarations shared by every stage of the wavefront path tracer.
+// the host concatenates this file in front of each stage source.
+
+#define PI 3.14159265
+#define LOCAL_SIZE 64
+const float RAYCAST_MAX = 100000.0;
+const float EPSILON = 9.999999747e-06F;
+const int MAT_LAMBERTIAN = 0;
+const int MAT_METALLIC =  1;
+const int MAT_DIELECTRIC = 2;
+
+const int OBJ_SPHERE = 1;
+const int OBJ_XYRECT = 2;
+const int OBJ_XZRECT = 3;
+const int OBJ_YZRECT = 4;
+const int OBJ_MODEL = 5;
+
+// ray queues, the two extend queues take turns between bounces
+const int QUEUE_EXTEND0 = 0;
+const int QUEUE_EXTEND1 = 1;
+const int QUEUE_LAMBERTIAN = 2;
+const int QUEUE_METALLIC = 3;
+const int QUEUE_DIELECTRIC = 4;
+const int QUEUE_MISS = 5;
+const int QUEUE_COUNT = 6;
+
+// define struct
+// -------------
+struct PathState
+{
+	vec3 origin;
+	uint rng;
+	vec3 direction;
+	uint pixel;
+	vec3 throughput;
+	float pad0;
+	vec3 radiance;
+	float pad1;
+};
+
+struct HitState
+{
+	vec3 position;
+	float t;
+	vec3 normal;
+	int materialType;
+	vec3 color;
+	float roughness;
+	float ior;
+	float pad0, pad1, pad2;
+};
+
+// buffers
+// -------
+layout(std430, binding = 0) buffer Counters
+{
+	uint queueCount[QUEUE_COUNT];
+	uint rayCount;
+	uint counterPad;
+	// indirect dispatch arguments per queue, w unused
+	uvec4 dispatchArgs[QUEUE_COUNT];
+};
+
+layout(std430, binding = 1) buffer Paths
+{
+	PathState paths[];
+};
+
+layout(std430, binding = 2) buffer Hits
+{
+	HitState hits[];
+};
+
+// QUEUE_COUNT queues of pathCount path indices each
+layout(std430, binding = 3) buffer Queues
+{
+	uint queues[];
+};
+
+uniform uint pathCount;
+
+// functions definition
+// --------------------
+void QueuePush(int queue, uint path)
+{
+	uint slot = atomicAdd(queueCount[queue], 1u);
+	queues[uint(queue) * pathCount + slot] = path;
+}
+
+uint QueueGet(int queue, uint index)
+{
+	return queues[uint(queue) * pathCount + index];
+}
+
+// pcg hash, every path carries its own state so stages can run in any order
+uint Hash(uint v)
+{
+	uint state = v * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float Rand(inout uint state)
+{
+	state = Hash(state);
+	return float(state >> 8u) * (1.0 / 16777216.0);
+}
+
+vec3 RandInSphere(inout uint state)
+{
+	vec3 p;
+
+	float theta = Rand(state) * 2.0 * PI;
+	float phi   = Rand(state) * PI;
+	p.y = cos(phi);
+	p.x = sin(phi) * cos(theta);
+	p.z = sin(phi) * sin(theta);
+
+	return p;
+}
@@ -0,0 +1,151 @@
+#include <glm/glm.hpp>
+
+#include <raytracing/scene_file.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+
+// writes a scene of random spheres as text and as binary, then times loading each against
+// plainly reading the binary file, which is all the binary load should cost:
+//   scene_file_benchmark [sphere count]
+// or compiles a scene, text to binary or binary to text by the output's extension:
+//   scene_file_benchmark input.rtscene output.rtsb
+
+// settings
+const int SPHERE_COUNT = 1000000;
+const int PALETTE_SIZE = 64;
+const char* TEXT_PATH = "scene_file_benchmark.rtscene";
+const char* BINARY_PATH = "scene_file_benchmark.rtsb";
+
+const int MAT_LAMBERTIAN = 0;
+const int MAT_METALLIC =  1;
+const int MAT_DIELECTRIC = 2;
+const int MAT_PBR =  3;
+const int OBJ_SPHERE = 1;
+const int OBJ_XYRECT = 2;
+const int OBJ_XZRECT = 3;
+const int OBJ_YZRECT = 4;
+const int OBJ_MODEL = 5;
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// what the demos do with the buffers: one pass over every texel
+float Touch(const float (*texels)[4], size_t count)
+{
+    float sum = 0.0f;
+    for(size_t i = 0; i < count; ++i)
+    {
+        sum += texels[i][0];
+    }
+    return sum;
+}
+
+int Compile(const std::string& input, const std::string& output)
+{
+    SceneFile scene;
+    if(!scene.Load(input))
+    {
+        std::cout << "cannot load " << input << std::endl;
+        return 1;
+    }
+    bool binary = output.size() >= 5 && output.compare(output.size() - 5, 5, ".rtsb") == 0;
+    if(!(binary ? scene.SaveBinary(output) : scene.SaveText(output)))
+    {
+        return 1;
+    }
+    std::cout << input << " -> " << output << ": " << scene.ObjectCount() << " objects, " << scene.pool.Size()
+        << " materials, " << scene.instances.size() << " instances" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 2)
+    {
+        return Compile(argv[1], argv[2]);
+    }
+    int sphereCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : SPHERE_COUNT;
+
+    // the scene
+    // ---------
+    auto start = std::chrono::steady_clock::now();
+    SceneFile scene;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<uint16_t> palette;
+    for(int i = 0; i < PALETTE_SIZE; ++i)
+    {
+        vec3 albedo(uniform(generator), uniform(generator), uniform(generator));
+        palette.push_back(scene.AddMaterial(i % 4 == 0 ? Material(albedo, MAT_METALLIC, 0.5f * uniform(generator)) : Material(albedo, MAT_LAMBERTIAN)));
+    }
+    float extent = std::sqrt((float)sphereCount);
+    scene.ReserveObjects(sphereCount);
+    for(int i = 0; i < sphereCount; ++i)
+    {
+        scene.AddSphere(glm::vec3(extent * uniform(generator), 0.2f, extent * uniform(generator)), 0.2f, palette[generator() % PALETTE_SIZE]);
+    }
+    scene.Finish();
+    double buildMs = Milliseconds(start);
+    start = std::chrono::steady_clock::now();
+    scene.SaveText(TEXT_PATH);
+    double saveTextMs = Milliseconds(start);
+    start = std::chrono::steady_clock::now();
+    scene.SaveBinary(BINARY_PATH);
+    double saveBinaryMs = Milliseconds(start);
+    std::cout << sphereCount << " spheres: build " << std::fixed << std::setprecision(1) << buildMs << " ms, save text "
+        << saveTextMs << " ms, save binary " << saveBinaryMs << " ms" << std::endl;
+
+    // loads
+    // -----
+    // the file is read once before so every load finds it in the page cache
+    std::vector<char> raw;
+    double readMs = 0.0;
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        start = std::chrono::steady_clock::now();
+        std::ifstream in(BINARY_PATH, std::ios::binary | std::ios::ate);
+        raw.resize((size_t)in.tellg());
+        in.seekg(0);
+        in.read(raw.data(), raw.size());
+        readMs = Milliseconds(start);
+    }
+    double megabytes = raw.size() / (1024.0 * 1024.0);
+
+    SceneFile loaded;
+    start = std::chrono::steady_clock::now();
+    loaded.LoadBinary(BINARY_PATH);
+    float sum = Touch(loaded.ObjectTexels(), (size_t)loaded.ObjectCount() * SCENE_OBJECT_TEXELS) +
+        Touch(loaded.NodeTexels(), (size_t)loaded.NodeCount() * SCENE_NODE_TEXELS);
+    double binaryMs = Milliseconds(start);
+    bool same = loaded.ObjectCount() == scene.ObjectCount() && loaded.NodeCount() == scene.NodeCount() &&
+        std::memcmp(loaded.ObjectTexels(), scene.ObjectTexels(), sizeof(float) * 4 * SCENE_OBJECT_TEXELS * scene.ObjectCount()) == 0 &&
+        std::memcmp(loaded.NodeTexels(), scene.NodeTexels(), sizeof(float) * 4 * SCENE_NODE_TEXELS * scene.NodeCount()) == 0;
+
+    SceneFile parsed;
+    start = std::chrono::steady_clock::now();
+    parsed.LoadText(TEXT_PATH);
+    sum += Touch(parsed.ObjectTexels(), (size_t)parsed.ObjectCount() * SCENE_OBJECT_TEXELS);
+    double textMs = Milliseconds(start);
+    bool sameText = parsed.ObjectCount() == scene.ObjectCount() &&
+        std::memcmp(parsed.NodeTexels(), scene.NodeTexels(), sizeof(float) * 4 * SCENE_NODE_TEXELS * scene.NodeCount()) == 0;
+
+    std::cout << "  " << std::left << std::setw(8) << "read" << std::right << std::setw(10) << readMs << " ms, "
+        << std::setw(8) << megabytes / readMs * 1000.0 << " MB/s" << std::endl;
+    std::cout << "  " << std::left << std::setw(8) << "binary" << std::right << std::setw(10) << binaryMs << " ms, "
+        << std::setw(8) << megabytes / binaryMs * 1000.0 << " MB/s, " << (same ? "same" : "DIFFERENT") << " buffers" << std::endl;
+    std::cout << "  " << std::left << std::setw(8) << "text" << std::right << std::setw(10) << textMs << " ms, "
+        << std::setprecision(1) << textMs / binaryMs << "x binary, " << (sameText ? "same" : "DIFFERENT") << " buffers" << std::endl;
+    // keeps the touches
+    volatile float sink = sum;
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <glm/glm.hpp>
+
+#include <raytracing/scene_generator.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+// generates the scale test scenes on one thread and on several, checks both come out the same
+// and that every bvh link is right, and times generating and ordering and packing them
+// (SceneFile::Finish). with an output path
+// the scene is written as a scene file the demos and scene_file_benchmark load:
+//   scene_generator [object count [output.rtsb|output.rtscene]]
+
+// settings
+const size_t SCENE_COUNTS[] = { 10000, 100000, 10000000 };
+// the mix of the scale tests: mostly spheres, some rects
+const float SPHERE_SHARE = 0.9f;
+const float RECT_SHARE = 0.1f;
+const uint64_t SEED = 2024;
+
+const int MAT_LAMBERTIAN = 0;
+const int MAT_METALLIC =  1;
+const int MAT_DIELECTRIC = 2;
+const int MAT_PBR =  3;
+const int OBJ_SPHERE = 1;
+const int OBJ_XYRECT = 2;
+const int OBJ_XZRECT = 3;
+const int OBJ_YZRECT = 4;
+const int OBJ_MODEL = 5;
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// FNV-1a over the packed buffers, 64 bits at a time
+uint64_t Checksum(const SceneFile& scene)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const float (*texels)[4], size_t count)
+    {
+        const uint64_t* words = (const uint64_t*)texels;
+        for(size_t i = 0; i < count * 2; ++i)
+        {
+            hash = (hash ^ words[i]) * 0x100000001B3ull;
+        }
+    };
+    add(scene.ObjectTexels(), (size_t)scene.ObjectCount() * SCENE_OBJECT_TEXELS);
+    add(scene.NodeTexels(), (size_t)scene.NodeCount() * SCENE_NODE_TEXELS);
+    return hash;
+}
+
+// every leaf holds its own object, every other node two children that no other node holds and
+// whose boxes it contains, and the root is the one node nobody holds. returns the bad nodes
+size_t CheckLinks(const SceneFile& scene)
+{
+    size_t objectCount = scene.ObjectCount(), nodeCount = scene.NodeCount();
+    const float (*texels)[4] = scene.NodeTexels();
+    std::vector<unsigned char> held(nodeCount, 0);
+    size_t bad = 0;
+    auto contains = [texels](size_t parent, size_t child)
+    {
+        const float* parentMin = texels[parent * SCENE_NODE_TEXELS];
+        const float* parentMax = texels[parent * SCENE_NODE_TEXELS + 1];
+        const float* childMin = texels[child * SCENE_NODE_TEXELS];
+        const float* childMax = texels[child * SCENE_NODE_TEXELS + 1];
+        return parentMin[0] <= childMin[0] && parentMin[1] <= childMin[1] && parentMin[2] <= childMin[2] &&
+            parentMax[0] >= childMax[0] && parentMax[1] >= childMax[1] && parentMax[2] >= childMax[2];
+    };
+    for(size_t node = 0; node < nodeCount; ++node)
+    {
+        int objectIndex = NodeTexelIndex(texels[node * SCENE_NODE_TEXELS][3]);
+        int left = NodeTexelIndex(texels[node * SCENE_NODE_TEXELS + 2][0]);
+        int right = NodeTexelIndex(texels[node * SCENE_NODE_TEXELS + 2][1]);
+        if(node < objectCount)
+        {
+            bad += objectIndex != (int)node || left != -1 || right != -1;
+            continue;
+        }
+        if(objectIndex != -1 || left < 0 || right < 0 || left == right || (size_t)left >= node || (size_t)right >= node ||
+            held[left]++ || held[right]++ || !contains(node, left) || !contains(node, right))
+        {
+            ++bad;
+        }
+    }
+    for(size_t node = 0; node + 1 < nodeCount; ++node)
+    {
+        bad += held[node] != 1;
+    }
+    bad += nodeCount > 0 && held[nodeCount - 1] != 0;
+    return bad;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> counts(std::begin(SCENE_COUNTS), std::end(SCENE_COUNTS));
+    if(argc > 1)
+    {
+        counts.assign(1, (size_t)std::max(1LL, std::atoll(argv[1])));
+    }
+    // more threads than cores still splits the work differently, which is what is checked
+    unsigned int threadCounts[2] = { 1, std::max(4u, std::thread::hardware_concurrency()) };
+
+    bool failed = false;
+    for(size_t count : counts)
+    {
+        SceneGeneratorSettings settings;
+        settings.count = count;
+        settings.sphereShare = SPHERE_SHARE;
+        settings.rectShare = RECT_SHARE;
+        settings.seed = SEED;
+        uint64_t checksums[2];
+        size_t badNodes[2];
+        double generateMs[2], finishMs = 0.0;
+        for(int run = 0; run < 2; ++run)
+        {
+            SceneFile scene;
+            auto start = std::chrono::steady_clock::now();
+            GenerateScene(settings, scene, threadCounts[run]);
+            generateMs[run] = Milliseconds(start);
+            start = std::chrono::steady_clock::now();
+            scene.Finish();
+            finishMs = Milliseconds(start);
+            checksums[run] = Checksum(scene);
+            badNodes[run] = CheckLinks(scene);
+            if(run == 1 && argc > 2)
+            {
+                std::string output = argv[2];
+                bool binary = output.size() >= 5 && output.compare(output.size() - 5, 5, ".rtsb") == 0;
+                if(binary ? scene.SaveBinary(output) : scene.SaveText(output))
+                {
+                    std::cout << "wrote " << output << std::endl;
+                }
+            }
+        }
+        std::cout << std::setw(9) << count << " objects: generate " << std::fixed << std::setprecision(1) << generateMs[0]
+            << " ms on 1 thread, " << generateMs[1] << " ms on " << threadCounts[1] << ", finish " << finishMs << " ms, "
+            << (checksums[0] == checksums[1] ? "same" : "DIFFERENT") << " scene " << std::hex << checksums[0] << std::dec
+            << ", " << badNodes[0] + badNodes[1] << " bad bvh nodes" << std::endl;
+        failed = failed || checksums[0] != checksums[1] || badNodes[0] + badNodes[1] > 0;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,258 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/scene_graph.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <list>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+// updates and culls a solar system of SUN_COUNT suns, PLANETS_PER_SUN planets each and
+// MOONS_PER_PLANET moons per planet the way Entity does (a tree of std::list children,
+// forceUpdateSelfAndChild recursing per node, a virtual isOnFrustum per node) and with
+// SceneGraph on one and on all threads, and checks they agree:
+//   scene_graph_benchmark [moons per planet]
+
+// settings
+const int SUN_COUNT = 100;
+const int PLANETS_PER_SUN = 10;
+const int MOONS_PER_PLANET = 100;
+const int FRAME_COUNT = 30;
+const float SCR_ASPECT = 800.0f / 600.0f;
+
+// the parts of Entity and Transform the frame touches
+struct LegacyTransform
+{
+    glm::vec3 pos = glm::vec3(0.0f);
+    glm::vec3 eulerRot = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+    glm::mat4 getLocalModelMatrix() const
+    {
+        const glm::mat4 transformX = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        const glm::mat4 transformY = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 transformZ = glm::rotate(glm::mat4(1.0f), glm::radians(eulerRot.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        return glm::translate(glm::mat4(1.0f), pos) * transformY * transformX * transformZ * glm::scale(glm::mat4(1.0f), scale);
+    }
+};
+
+struct LegacyVolume
+{
+    virtual ~LegacyVolume() = default;
+    virtual bool isOnFrustum(const Frustum& camFrustum, const LegacyTransform& transform) const = 0;
+};
+
+struct LegacyAABB : public LegacyVolume
+{
+    glm::vec3 center{ 0.f, 0.f, 0.f };
+    glm::vec3 extents{ 0.f, 0.f, 0.f };
+
+    LegacyAABB(const glm::vec3& inCenter, const glm::vec3& inExtents) : center{ inCenter }, extents{ inExtents } {}
+
+    bool isOnOrForwardPlan(const Plan& plan) const
+    {
+        const float r = extents.x * std::abs(plan.normal.x) + extents.y * std::abs(plan.normal.y) +
+            extents.z * std::abs(plan.normal.z);
+        return -r <= plan.getSignedDistanceToPlan(center);
+    }
+
+    bool isOnFrustum(const Frustum& camFrustum, const LegacyTransform& transform) const override
+    {
+        const glm::vec3 globalCenter{ transform.modelMatrix * glm::vec4(center, 1.f) };
+        const glm::vec3 right = glm::vec3(transform.modelMatrix[0]) * extents.x;
+        const glm::vec3 up = glm::vec3(transform.modelMatrix[1]) * extents.y;
+        const glm::vec3 forward = -glm::vec3(transform.modelMatrix[2]) * extents.z;
+        const LegacyAABB globalAABB(globalCenter, glm::abs(right) + glm::abs(up) + glm::abs(forward));
+        return (globalAABB.isOnOrForwardPlan(camFrustum.leftFace) &&
+            globalAABB.isOnOrForwardPlan(camFrustum.rightFace) &&
+            globalAABB.isOnOrForwardPlan(camFrustum.topFace) &&
+            globalAABB.isOnOrForwardPlan(camFrustum.bottomFace) &&
+            globalAABB.isOnOrForwardPlan(camFrustum.nearFace) &&
+            globalAABB.isOnOrForwardPlan(camFrustum.farFace));
+    }
+};
+
+struct LegacyEntity
+{
+    std::list<std::unique_ptr<LegacyEntity>> children;
+    LegacyEntity* parent = nullptr;
+    LegacyTransform transform;
+    std::unique_ptr<LegacyVolume> boundingVolume;
+    // the SceneGraph node built alongside, to compare
+    int node = 0;
+
+    void forceUpdateSelfAndChild()
+    {
+        if (parent)
+            transform.modelMatrix = parent->transform.modelMatrix * transform.getLocalModelMatrix();
+        else
+            transform.modelMatrix = transform.getLocalModelMatrix();
+
+        for (auto&& child : children)
+        {
+            child->forceUpdateSelfAndChild();
+        }
+    }
+
+    void cullSelfAndChild(const Frustum& frustum, std::vector<int>& visible)
+    {
+        if (boundingVolume->isOnFrustum(frustum, transform))
+        {
+            visible.push_back(node);
+        }
+        for (auto&& child : children)
+        {
+            child->cullSelfAndChild(frustum, visible);
+        }
+    }
+};
+
+LegacyEntity* AddEntity(std::vector<std::unique_ptr<LegacyEntity>>& roots, LegacyEntity* parent, SceneGraph& graph,
+    const glm::vec3& position, float scale)
+{
+    std::unique_ptr<LegacyEntity> entity = std::make_unique<LegacyEntity>();
+    entity->parent = parent;
+    entity->transform.pos = position;
+    entity->transform.scale = glm::vec3(scale);
+    entity->boundingVolume = std::make_unique<LegacyAABB>(glm::vec3(0.0f), glm::vec3(1.0f));
+    entity->node = graph.addNode(parent ? parent->node : -1);
+    graph.setLocalPosition(entity->node, position);
+    graph.setLocalScale(entity->node, glm::vec3(scale));
+    LegacyEntity* added = entity.get();
+    if(parent)
+    {
+        parent->children.push_back(std::move(entity));
+    }
+    else
+    {
+        roots.push_back(std::move(entity));
+    }
+    return added;
+}
+
+// suns on a grid, planets around them, moons around the planets
+void BuildSystem(std::vector<std::unique_ptr<LegacyEntity>>& roots, SceneGraph& graph, int moonsPerPlanet)
+{
+    std::vector<LegacyEntity*> suns, planets;
+    for(int s = 0; s < SUN_COUNT; ++s)
+    {
+        glm::vec3 position(40.0f * (s % 10) - 180.0f, 0.0f, -40.0f * (s / 10));
+        suns.push_back(AddEntity(roots, nullptr, graph, position, 2.0f));
+    }
+    for(LegacyEntity* sun : suns)
+    {
+        for(int p = 0; p < PLANETS_PER_SUN; ++p)
+        {
+            float angle = 6.2831853f * p / PLANETS_PER_SUN;
+            float radius = 3.0f + p;
+            planets.push_back(AddEntity(roots, sun, graph, glm::vec3(radius * std::cos(angle), 0.0f, radius * std::sin(angle)), 0.25f));
+        }
+    }
+    for(LegacyEntity* planet : planets)
+    {
+        for(int m = 0; m < moonsPerPlanet; ++m)
+        {
+            float angle = 6.2831853f * m / moonsPerPlanet;
+            AddEntity(roots, planet, graph, glm::vec3(3.0f * std::cos(angle), 0.3f * (m % 5), 3.0f * std::sin(angle)), 0.1f);
+        }
+    }
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    int moonsPerPlanet = argc > 1 ? std::max(0, std::atoi(argv[1])) : MOONS_PER_PLANET;
+    std::vector<std::unique_ptr<LegacyEntity>> roots;
+    SceneGraph graph;
+    BuildSystem(roots, graph, moonsPerPlanet);
+    std::cout << graph.size() << " entities, " << FRAME_COUNT << " frames" << std::endl;
+
+    Camera camera(glm::vec3(0.0f, 30.0f, 60.0f));
+    camera.ProcessMouseMovement(0.0f, -150.0f);
+    Frustum frustum = createFrustumFromCamera(camera, SCR_ASPECT, glm::radians(camera.Zoom), 0.1f, 300.0f);
+
+    // every sun turns each frame, so every entity moves
+    std::vector<int> legacyVisible;
+    auto start = std::chrono::steady_clock::now();
+    for(int frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        legacyVisible.clear();
+        for(auto&& root : roots)
+        {
+            root->transform.eulerRot.y = 3.0f * frame;
+            root->forceUpdateSelfAndChild();
+            root->cullSelfAndChild(frustum, legacyVisible);
+        }
+    }
+    double legacyMs = Milliseconds(start) / FRAME_COUNT;
+    std::sort(legacyVisible.begin(), legacyVisible.end());
+    std::cout << "  " << std::left << std::setw(10) << "tree" << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << legacyMs << " ms per frame, " << legacyVisible.size() << " visible" << std::endl;
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int threadCounts[2] = { 1, threads };
+    std::vector<int> visible;
+    for(int i = 0; i < (threads > 1 ? 2 : 1); ++i)
+    {
+        double updateMs = 0.0, cullMs = 0.0;
+        for(int frame = 1; frame <= FRAME_COUNT; ++frame)
+        {
+            start = std::chrono::steady_clock::now();
+            for(int sun = 0; sun < SUN_COUNT; ++sun)
+            {
+                graph.setLocalRotation(sun, glm::vec3(0.0f, 3.0f * frame, 0.0f));
+            }
+            graph.update(threadCounts[i]);
+            updateMs += Milliseconds(start);
+            start = std::chrono::steady_clock::now();
+            graph.cull(frustum, visible, threadCounts[i]);
+            cullMs += Milliseconds(start);
+        }
+        updateMs /= FRAME_COUNT;
+        cullMs /= FRAME_COUNT;
+        std::string name = "graph x" + std::to_string(threadCounts[i]);
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(10) << updateMs + cullMs
+            << " ms per frame (update " << updateMs << ", cull " << cullMs << "), " << std::setprecision(1)
+            << legacyMs / (updateMs + cullMs) << "x, " << visible.size() << " visible" << std::setprecision(3) << std::endl;
+    }
+
+    // same matrices, and the same boxes culled apart from ones that touch a plane to rounding
+    float maxError = 0.0f;
+    std::vector<LegacyEntity*> stack;
+    for(auto&& root : roots)
+    {
+        stack.push_back(root.get());
+    }
+    while(!stack.empty())
+    {
+        LegacyEntity* entity = stack.back();
+        stack.pop_back();
+        for(int column = 0; column < 4; ++column)
+        {
+            glm::vec4 d = glm::abs(graph.getModelMatrix(entity->node)[column] - entity->transform.modelMatrix[column]);
+            maxError = std::max(maxError, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+        }
+        for(auto&& child : entity->children)
+        {
+            stack.push_back(child.get());
+        }
+    }
+    std::vector<int> different;
+    std::set_symmetric_difference(legacyVisible.begin(), legacyVisible.end(), visible.begin(), visible.end(),
+        std::back_inserter(different));
+    std::cout << "max matrix difference " << std::scientific << maxError << ", " << different.size()
+        << " entities culled differently" << std::endl;
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <glm/glm.hpp>
+
+#include <raytracing/sphere.h>
+#include <raytracing/hittable_list.h>
+#include <raytracing/material_pool.h>
+#include <raytracing/primitive_storage.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// builds and packs the same sphere scene twice, once as the HittableList of shared_ptrs the
+// demos use and once as SceneStorage pools, and prints time and heap use of each step.
+// heap bytes are counted by the replaced operator new below, so they include the control
+// blocks and allocator headers a shared_ptr per object brings along.
+
+// settings
+const size_t SPHERE_COUNT = 1000000;
+// distinct materials the spheres pick from
+const int PALETTE_SIZE = 64;
+
+const int MAT_LAMBERTIAN = 0;
+const int MAT_METALLIC =  1;
+const int MAT_DIELECTRIC = 2;
+const int MAT_PBR =  3;
+const int OBJ_SPHERE = 1;
+const int OBJ_XYRECT = 2;
+const int OBJ_XZRECT = 3;
+const int OBJ_YZRECT = 4;
+
+// heap accounting
+// ---------------
+static size_t heapBytes = 0;
+static size_t heapAllocations = 0;
+
+void* operator new(size_t size)
+{
+    heapBytes += size;
+    ++heapAllocations;
+    if(void* p = std::malloc(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+struct Step
+{
+    const char* name;
+    double ms;
+    size_t bytes;
+    size_t allocations;
+};
+
+template <typename F>
+Step Measure(const char* name, F f)
+{
+    size_t bytes = heapBytes;
+    size_t allocations = heapAllocations;
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return { name, std::chrono::duration<double, std::milli>(end - start).count(),
+        heapBytes - bytes, heapAllocations - allocations };
+}
+
+int main()
+{
+    // scene description, generated once so both containers get the same spheres
+    // --------------------------------------------------------------------------
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<Material> palette;
+    for(int i = 0; i < PALETTE_SIZE; ++i)
+    {
+        vec3 albedo(uniform(generator), uniform(generator), uniform(generator));
+        palette.push_back(i % 4 == 0 ? Material(albedo, MAT_METALLIC, 0.5f * uniform(generator)) : Material(albedo, MAT_LAMBERTIAN));
+    }
+    std::vector<glm::vec4> spheres(SPHERE_COUNT);
+    std::vector<int> sphereMaterials(SPHERE_COUNT);
+    float extent = std::sqrt((float)SPHERE_COUNT);
+    for(size_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        spheres[i] = glm::vec4(extent * uniform(generator), 0.2f, extent * uniform(generator), 0.2f);
+        sphereMaterials[i] = (int)(generator() % PALETTE_SIZE);
+    }
+    std::vector<float> listTexels(SPHERE_COUNT * 2 * 4), storageTexels(SPHERE_COUNT * 2 * 4);
+    std::vector<Step> steps;
+    AABB listBounds, storageBounds;
+
+    // HittableList, the way scene.h builds scenes: a Sphere and a Material per object
+    // ---------------------------------------------------------------------------------
+    {
+        HittableList objects;
+        MaterialPool materials;
+        steps.push_back(Measure("list build", [&]()
+        {
+            for(size_t i = 0; i < SPHERE_COUNT; ++i)
+            {
+                objects.add(std::make_shared<Sphere>(Sphere(vec3(spheres[i]), spheres[i].w,
+                    std::make_shared<Material>(palette[sphereMaterials[i]]))));
+            }
+            // interned while building, as the storage side does
+            materials.Intern(objects);
+        }));
+        steps.push_back(Measure("list pack", [&]()
+        {
+            // the WriteObjectsData loop
+            float (*texels)[4] = reinterpret_cast<float (*)[4]>(listTexels.data());
+            for(size_t i = 0; i < objects.size(); ++i)
+            {
+                texels[i * 2][0] = objects[i]->center[0];
+                texels[i * 2][1] = objects[i]->center[1];
+                texels[i * 2][2] = objects[i]->center[2];
+                texels[i * 2][3] = objects[i]->radius;
+                texels[i * 2 + 1][0] = objects[i]->materialIndex;
+                texels[i * 2 + 1][1] = 0.0f;
+                texels[i * 2 + 1][2] = 0.0f;
+                texels[i * 2 + 1][3] = 0.0f;
+            }
+        }));
+        steps.push_back(Measure("list bounds", [&]() { objects.BoundingBox(listBounds); }));
+        steps.push_back(Measure("list release", [&]() { objects.clear(); }));
+    }
+
+    // SceneStorage
+    // ------------
+    {
+        SceneStorage storage(16 << 20);
+        MaterialPool materials;
+        std::vector<PrimitiveHandle> handles;
+        steps.push_back(Measure("storage build", [&]()
+        {
+            storage.ReserveSpheres(SPHERE_COUNT);
+            handles.reserve(SPHERE_COUNT);
+            for(size_t i = 0; i < SPHERE_COUNT; ++i)
+            {
+                handles.push_back(storage.AddSphere(glm::vec3(spheres[i]), spheres[i].w,
+                    materials.Intern(palette[sphereMaterials[i]])));
+            }
+        }));
+        steps.push_back(Measure("storage pack", [&]()
+        {
+            storage.Pack(handles, reinterpret_cast<float (*)[4]>(storageTexels.data()));
+        }));
+        steps.push_back(Measure("storage bounds", [&]() { storageBounds = storage.Bounds(); }));
+        std::cout << "storage arena " << storage.arena.BytesUsed() / (1024.0 * 1024.0) << " MiB used, "
+            << storage.arena.BytesReserved() / (1024.0 * 1024.0) << " MiB reserved" << std::endl;
+    }
+
+    // report
+    // ------
+    std::cout << SPHERE_COUNT << " spheres, " << PALETTE_SIZE << " materials" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for(const Step& step : steps)
+    {
+        std::cout << "  " << std::left << std::setw(16) << step.name << std::right
+            << std::setw(10) << step.ms << " ms " << std::setw(10) << step.bytes / (1024.0 * 1024.0) << " MiB "
+            << std::setw(9) << step.allocations << " allocations" << std::endl;
+    }
+    bool same = std::memcmp(listTexels.data(), storageTexels.data(), listTexels.size() * sizeof(float)) == 0;
+    std::cout << "packed buffers " << (same ? "match" : "DIFFER") << std::endl;
+    std::cout << "bounds " << storageBounds.min()[0] << " " << storageBounds.min()[2] << " - "
+        << storageBounds.max()[0] << " " << storageBounds.max()[2]
+        << (listBounds.min() == storageBounds.min() && listBounds.max() == storageBounds.max() ? " match" : " DIFFER") << std::endl;
+    return same ? 0 : 1;
+}
@@ -8,6 +8,8 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/scene_graph.h>
+#include <learnopengl/sphere_instances.h>
 #include <iostream>
 #include <vector>
 #include <map>
@@ -28,6 +30,11 @@ const unsigned int SCR_HEIGHT = 600;
 const GLfloat PI = 3.14159265358979323846f;
 const int Y_SEGMENTS = 50;
 const int X_SEGMENTS = 50;
+// every group is a ball with BALLS_PER_GROUP smaller ones circling it
+const int BALL_GROUPS = 10;
+const int BALLS_PER_GROUP = 100;
+// every visible ball in one glDrawElementsInstanced, false draws them one by one
+const bool INSTANCED = true;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
@@ -80,7 +87,7 @@ int main()
     // build and compile shaders
     Shader skyboxShader(FileSystem::getPath("src/skybox/skybox.vs").c_str(),
         FileSystem::getPath("src/skybox/skybox.fs").c_str());
-    Shader shader(FileSystem::getPath("src/skybox/balls_earth.vs").c_str(),
+    Shader shader(FileSystem::getPath("src/skybox/balls_instanced.vs").c_str(),
          FileSystem::getPath("src/skybox/balls_earth.fs").c_str());
 
     float skyboxVertices[] = {
@@ -163,97 +170,34 @@ int main()
     shader.use();
     shader.setInt("texture1", 0);
 
-    // produce sphere position
-    // -----------------------
-    std::vector<float> spherePoints;
-    std::vector<float> sphereTexCoords;
-    std::vector<float> sphereNormals;
-    std::vector<float> sphereVertices;
-    std::vector<int> sphereIndices;
-    for(int y = 0; y <= Y_SEGMENTS; ++y)
+    // indexed sphere with an instance buffer
+    // ------------------------------------
+    SphereInstances sphere(X_SEGMENTS, Y_SEGMENTS);
+
+    // balls
+    // -----
+    SceneGraph balls;
+    std::vector<int> groups;
+    std::vector<glm::vec4> materials;
+    for(int g = 0; g < BALL_GROUPS; ++g)
     {
-        for(int x = 0; x <= X_SEGMENTS; ++x)
+        int center = balls.addNode(-1);
+        balls.setLocalPosition(center, glm::vec3(6.0f * (g % 5) - 12.0f, 0.0f, -6.0f * (g / 5) - 2.0f));
+        groups.push_back(center);
+        materials.push_back(glm::vec4(1.0f));
+        // the small ones take the tint of their group
+        glm::vec4 tint(0.6f + 0.4f * std::cos((float)g), 0.6f + 0.4f * std::cos(g + 2.0f), 0.6f + 0.4f * std::cos(g + 4.0f), 0.0f);
+        for(int b = 0; b < BALLS_PER_GROUP; ++b)
         {
-            float xSegment = (float)x / (float)X_SEGMENTS;
-            float ySegment = (float)y / (float)Y_SEGMENTS;
-            float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-            float yPos = std::cos(ySegment * PI);
-            float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-            spherePoints.push_back(xPos);
-            spherePoints.push_back(yPos);
-            spherePoints.push_back(zPos);
-            sphereTexCoords.push_back(xSegment);
-            sphereTexCoords.push_back(ySegment);
+            float angle = 2.0f * PI * b / BALLS_PER_GROUP;
+            int ball = balls.addNode(center);
+            balls.setLocalPosition(ball, glm::vec3(2.0f * std::cos(angle), 0.2f * std::sin(7.0f * angle), 2.0f * std::sin(angle)));
+            balls.setLocalScale(ball, glm::vec3(0.08f));
+            materials.push_back(tint);
         }
     }
-
-    for (int i=0;i<Y_SEGMENTS;i++)
-	{
-		for (int j=0;j<X_SEGMENTS;j++)
-		{
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j) + 1]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j) + 1]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j) + 1]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(sphereTexCoords[2*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1) + 2]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(sphereTexCoords[2*(i * (X_SEGMENTS + 1) + j + 1) + 1]);
-		}
-	}
-
-    unsigned sphereVAO, sphereVBO;
-    glGenVertexArrays(1, &sphereVAO);
-    glGenBuffers(1, &sphereVBO);
-    
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), &sphereVertices[0], GL_STATIC_DRAW);
-    
-
-    // unsigned int sphereEBO;
-    // glGenBuffers(1, &sphereEBO);
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(int), &sphereIndices[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3*sizeof(float)));
-    glBindVertexArray(0);
+    std::vector<int> visible;
+    std::vector<SphereInstance> instances;
 
     // render loop
     // -----------
@@ -277,25 +221,41 @@ int main()
         shader.use();
         /*glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);*/
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
         shader.setMat4("projection", projection);
         shader.setMat4("view", view);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glBindVertexArray(sphereVAO);
+        shader.setBool("instanced", INSTANCED);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, sphereTexture);
-        
-        glDrawArrays(GL_TRIANGLES, 0, X_SEGMENTS* Y_SEGMENTS * 6);
-        // glDrawElements(GL_TRIANGLES, X_SEGMENTS * Y_SEGMENTS * 6, GL_UNSIGNED_INT, 0);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        // glDrawElements(GL_TRIANGLES, X_SEGMENTS * Y_SEGMENTS * 6, GL_UNSIGNED_INT, 0);
-        glDrawArrays(GL_TRIANGLES, 0, X_SEGMENTS * Y_SEGMENTS * 6);
+        // spin the groups, then draw the balls the camera can see
+        for(int center : groups)
+        {
+            balls.setLocalRotation(center, glm::vec3(0.0f, 20.0f * currentFrame, 0.0f));
+        }
+        balls.update();
+        Frustum frustum = createFrustumFromCamera(camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, glm::radians(camera.Zoom), 0.1f, 100.0f);
+        balls.cull(frustum, visible);
+        if(INSTANCED)
+        {
+            instances.clear();
+            for(int ball : visible)
+            {
+                instances.push_back({ balls.getModelMatrix(ball), materials[ball] });
+            }
+            sphere.upload(instances.data(), (int)instances.size());
+            sphere.draw();
+        }
+        else
+        {
+            for(int ball : visible)
+            {
+                shader.setMat4("model", balls.getModelMatrix(ball));
+                shader.setVec4("material", materials[ball]);
+                sphere.drawSingle();
+            }
+        }
 
         // draw skybox as last
         glDepthFunc(GL_LEQUAL);
@@ -321,6 +281,7 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
+    sphere.release();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
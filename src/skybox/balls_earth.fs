@@ -2,10 +2,11 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+flat in vec4 Material;
 
 uniform sampler2D texture1;
 
 void main(){
-    FragColor = texture(texture1, TexCoords);
+    FragColor = texture(texture1, TexCoords) * vec4(Material.rgb, 1.0);
     // FragColor = vec4(0.94, 0.06, 0.21, 1);
 }
\ No newline at end of file
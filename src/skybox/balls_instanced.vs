@@ -0,0 +1,30 @@
+#version 330
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance, see SphereInstance
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in vec4 aMaterial;
+
+out vec3 Position;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out vec4 Material;
+
+// false draws one ball with model and material
+uniform bool instanced;
+uniform mat4 model;
+uniform vec4 material;
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    mat4 world = instanced ? aModel : model;
+    Material = instanced ? aMaterial : material;
+    // balls are only scaled uniformly, so the model matrix can turn the normals
+    Normal = mat3(world) * aNormal;
+    Position = vec3(world * vec4(aPos, 1.0));
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
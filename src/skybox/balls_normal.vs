@@ -1,17 +0,0 @@
-#version 330
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-
-out vec3 Position;
-out vec3 Normal;
-
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
-
-void main()
-{
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    Position = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/scene_graph.h>
+#include <learnopengl/sphere_instances.h>
 #include <iostream>
 #include <vector>
 #include <map>
@@ -26,8 +28,13 @@ unsigned int loadCubemap(std::vector<std::string> faces);
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 const GLfloat PI = 3.14159265358979323846f;
-const int Y_SEGMENTS = 50;
-const int X_SEGMENTS = 50;
+// a stress test of BALLS_PER_SIDE^3 balls, so they are coarser than in balls_earth
+const int Y_SEGMENTS = 20;
+const int X_SEGMENTS = 20;
+const int BALLS_PER_SIDE = 47;
+const float BALL_SPACING = 1.5f;
+// every visible ball in one glDrawElementsInstanced, false draws them one by one
+const bool INSTANCED = true;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
@@ -80,8 +87,8 @@ int main()
     // build and compile shaders
     Shader skyboxShader(FileSystem::getPath("src/skybox/skybox.vs").c_str(),
         FileSystem::getPath("src/skybox/skybox.fs").c_str());
-    Shader shader(FileSystem::getPath("src/skybox/balls_normal.vs").c_str(),
-         FileSystem::getPath("src/skybox/balls_refraction.fs").c_str());
+    Shader shader(FileSystem::getPath("src/skybox/balls_instanced.vs").c_str(),
+         FileSystem::getPath("src/skybox/balls_reflection.fs").c_str());
 
     float skyboxVertices[] = {
         // positions          
@@ -160,79 +167,40 @@ int main()
     skyboxShader.setInt("skybox", 0);
 
     shader.use();
-    shader.setInt("texture1", 0);
-
-    // produce sphere position
-    // -----------------------
-    std::vector<float> spherePoints;
-    std::vector<float> sphereTexCoords;
-    std::vector<float> sphereNormals;
-    std::vector<float> sphereVertices;
-    std::vector<int> sphereIndices;
-    for(int y = 0; y <= Y_SEGMENTS; ++y)
+    shader.setInt("skybox", 0);
+
+    // indexed sphere with an instance buffer
+    // ------------------------------------
+    SphereInstances sphere(X_SEGMENTS, Y_SEGMENTS);
+
+    // balls
+    // -----
+    // a cube of balls in front of the camera turning around its center, every other ball
+    // refracts, the rest reflect
+    SceneGraph balls;
+    std::vector<glm::vec4> materials;
+    int field = balls.addNode(-1);
+    float halfSide = 0.5f * BALL_SPACING * (BALLS_PER_SIDE - 1);
+    balls.setLocalPosition(field, glm::vec3(0.0f, 0.0f, -halfSide - 4.0f));
+    materials.push_back(glm::vec4(0.0f));
+    for(int x = 0; x < BALLS_PER_SIDE; ++x)
     {
-        for(int x = 0; x <= X_SEGMENTS; ++x)
+        for(int y = 0; y < BALLS_PER_SIDE; ++y)
         {
-            float xSegment = (float)x / (float)X_SEGMENTS;
-            float ySegment = (float)y / (float)Y_SEGMENTS;
-            float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-            float yPos = std::cos(ySegment * PI);
-            float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-            spherePoints.push_back(xPos);
-            spherePoints.push_back(yPos);
-            spherePoints.push_back(zPos);
+            for(int z = 0; z < BALLS_PER_SIDE; ++z)
+            {
+                int ball = balls.addNode(field);
+                balls.setLocalPosition(ball, BALL_SPACING * glm::vec3(x, y, z) - halfSide);
+                balls.setLocalScale(ball, glm::vec3(0.4f));
+                glm::vec3 tint = glm::vec3(0.7f) + 0.3f * glm::vec3(x, y, z) / (float)BALLS_PER_SIDE;
+                materials.push_back(glm::vec4(tint, (x + y + z) % 2 ? 1.00f / 1.52f : 0.0f));
+            }
         }
     }
-
-    for (int i=0;i<Y_SEGMENTS;i++)
-	{
-		for (int j=0;j<X_SEGMENTS;j++)
-		{
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 2]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j) + 2]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 2]);
-
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j) + 2]);
-
-			sphereIndices.push_back((i + 1) * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*((i + 1) * (X_SEGMENTS + 1) + j + 1) + 2]);
-
-			sphereIndices.push_back(i * (X_SEGMENTS + 1) + j + 1);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1)]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1) + 1]);
-            sphereVertices.push_back(spherePoints[3*(i * (X_SEGMENTS + 1) + j + 1) + 2]);
-		}
-	}
-
-    unsigned sphereVAO, sphereVBO;
-    glGenVertexArrays(1, &sphereVAO);
-    glGenBuffers(1, &sphereVBO);
-    
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), &sphereVertices[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
+    std::vector<int> visible;
+    std::vector<SphereInstance> instances;
+    float reportTime = 0.0f;
+    int reportFrames = 0;
 
     // render loop
     // -----------
@@ -256,23 +224,44 @@ int main()
         shader.use();
         /*glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);*/
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
         shader.setMat4("projection", projection);
         shader.setMat4("view", view);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glBindVertexArray(sphereVAO);
-        
-        glDrawArrays(GL_TRIANGLES, 0, X_SEGMENTS* Y_SEGMENTS * 6);
-        // glDrawElements(GL_TRIANGLES, X_SEGMENTS * Y_SEGMENTS * 6, GL_UNSIGNED_INT, 0);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        // glDrawElements(GL_TRIANGLES, X_SEGMENTS * Y_SEGMENTS * 6, GL_UNSIGNED_INT, 0);
-        glDrawArrays(GL_TRIANGLES, 0, X_SEGMENTS * Y_SEGMENTS * 6);
+        shader.setVec3("cameraPos", camera.Position);
+        shader.setBool("instanced", INSTANCED);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+
+        // turning the field moves every ball, then only the visible ones are drawn
+        balls.setLocalRotation(field, glm::vec3(0.0f, 5.0f * currentFrame, 0.0f));
+        balls.update();
+        Frustum frustum = createFrustumFromCamera(camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, glm::radians(camera.Zoom), 0.1f, 100.0f);
+        balls.cull(frustum, visible);
+        // the field itself is no ball
+        if(!visible.empty() && visible[0] == field)
+        {
+            visible.erase(visible.begin());
+        }
+        if(INSTANCED)
+        {
+            instances.clear();
+            for(int ball : visible)
+            {
+                instances.push_back({ balls.getModelMatrix(ball), materials[ball] });
+            }
+            sphere.upload(instances.data(), (int)instances.size());
+            sphere.draw();
+        }
+        else
+        {
+            for(int ball : visible)
+            {
+                shader.setMat4("model", balls.getModelMatrix(ball));
+                shader.setVec4("material", materials[ball]);
+                sphere.drawSingle();
+            }
+        }
 
         // draw skybox as last
         glDepthFunc(GL_LEQUAL);
@@ -292,12 +281,22 @@ int main()
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        reportFrames++;
+        if(currentFrame - reportTime >= 1.0f)
+        {
+            std::cout << visible.size() << " of " << balls.size() - 1 << " balls visible, "
+                << 1000.0f * (currentFrame - reportTime) / reportFrames << " ms per frame" << std::endl;
+            reportTime = currentFrame;
+            reportFrames = 0;
+        }
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
+    sphere.release();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
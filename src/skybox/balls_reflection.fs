@@ -3,12 +3,14 @@ out vec4 FragColor;
 
 in vec3 Normal;
 in vec3 Position;
+flat in vec4 Material;
 
 uniform vec3 cameraPos;
 uniform samplerCube skybox;
 
 void main(){
     vec3 I = normalize(Position - cameraPos);
-    vec3 R = reflect(I, normalize(Normal));
-    FragColor = vec4(texture(skybox, R).rgb, 1.0);
+    // Material.a is the refraction ratio, 0 reflects
+    vec3 R = Material.a > 0.0 ? refract(I, normalize(Normal), Material.a) : reflect(I, normalize(Normal));
+    FragColor = vec4(texture(skybox, R).rgb * Material.rgb, 1.0);
 }
\ No newline at end of file